@@ -0,0 +1,34 @@
+# FindSQLite3.cmake - Find the SQLite3 library.
+#
+# Copyright 2026 Institute of Nuclear Medicine, University College London.
+#
+# (CMake >= 3.14 has its own; this covers older versions.)
+#
+# This module defines the following variables:
+#
+# SQLite3_FOUND: TRUE iff SQLite3 is found.
+# SQLite3_INCLUDE_DIRS: Include directories for SQLite3.
+# SQLite3_LIBRARIES: Libraries required to link SQLite3.
+#
+# and the imported target SQLite::SQLite3.
+
+find_path(SQLite3_INCLUDE_DIR NAMES sqlite3.h)
+find_library(SQLite3_LIBRARY NAMES sqlite3 sqlite)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(SQLite3 DEFAULT_MSG
+  SQLite3_INCLUDE_DIR SQLite3_LIBRARY)
+
+if (SQLite3_FOUND)
+  set(SQLite3_INCLUDE_DIRS ${SQLite3_INCLUDE_DIR})
+  set(SQLite3_LIBRARIES ${SQLite3_LIBRARY})
+
+  if (NOT TARGET SQLite::SQLite3)
+    add_library(SQLite::SQLite3 INTERFACE IMPORTED)
+    set_target_properties(SQLite::SQLite3 PROPERTIES
+      INTERFACE_INCLUDE_DIRECTORIES "${SQLite3_INCLUDE_DIRS}"
+      INTERFACE_LINK_LIBRARIES "${SQLite3_LIBRARIES}")
+  endif()
+endif()
+
+mark_as_advanced(SQLite3_INCLUDE_DIR SQLite3_LIBRARY)
@@ -20,3 +20,8 @@ include(${ITK_USE_FILE})
 #endif()
 
 find_package(glog REQUIRED)
+
+find_package(ZLIB REQUIRED)
+
+# Optional: nm_catalogue is only built with SQLite.
+find_package(SQLite3)
@@ -34,6 +34,7 @@ let pkgs = import <nixpkgs> {}; in
 , boost
 , itk
 , glog
+, zlib
 , ...
 }:
 
@@ -50,7 +51,7 @@ stdenv.mkDerivation rec {
 
   enableParallelBuilding = true;
 
-  buildInputs = [ cmake boost itk glog ];
+  buildInputs = [ cmake boost itk glog zlib ];
   cmakeBuildType = "Debug";
 
   meta = with stdenv.lib; {
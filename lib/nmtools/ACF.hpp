@@ -0,0 +1,521 @@
+/*
+   ACF.hpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Attenuation correction factor (ACF) sinograms from mu-maps.
+ */
+
+#ifndef ACF_HPP
+#define ACF_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <glog/logging.h>
+
+#include <itkImage.h>
+
+#include "Interfile.hpp"
+#include "Parallel.hpp"
+
+namespace nmtools {
+
+//Cylindrical PET scanner and the layout of its (non-arc-corrected)
+//sinograms. Lengths in mm.
+struct ScannerGeometry {
+  std::string name;
+  unsigned int numRings = 0;
+  unsigned int numDetectorsPerRing = 0;
+  unsigned int numViews = 0;
+  unsigned int numBins = 0;
+  double innerRadius = 0.0;
+  double averageDOI = 0.0;
+  double ringSpacing = 0.0;
+  double binSize = 0.0;
+  double viewOffset = 0.0;  //radians
+  unsigned int span = 1;
+  unsigned int maxRingDifference = 0;
+};
+
+//Geometry by name: "mMR" (Siemens Biograph mMR) or "Signa" (GE SIGNA
+//PET/MR), as in STIR's scanner table, with the vendors' default span.
+bool GetScannerGeometry(const std::string &name, ScannerGeometry &scanner){
+
+  if (name == "mMR") {
+    scanner.name = "Siemens mMR";
+    scanner.numRings = 64;
+    scanner.numDetectorsPerRing = 504;
+    scanner.numBins = 344;
+    scanner.innerRadius = 328.0;
+    scanner.averageDOI = 7.0;
+    scanner.ringSpacing = 4.0625;
+    scanner.binSize = 2.08626;
+    scanner.span = 11;
+    scanner.maxRingDifference = 60;
+  }
+  else if (name == "Signa") {
+    scanner.name = "GE Signa PET/MR";
+    scanner.numRings = 45;
+    scanner.numDetectorsPerRing = 448;
+    scanner.numBins = 357;
+    scanner.innerRadius = 311.8;
+    scanner.averageDOI = 8.5;
+    scanner.ringSpacing = 5.56;
+    scanner.binSize = 2.01565;
+    scanner.span = 1;
+    scanner.maxRingDifference = 44;
+  }
+  else {
+    LOG(ERROR) << "Unknown scanner: " << name << " (expected mMR or Signa)";
+    return false;
+  }
+
+  scanner.numViews = scanner.numDetectorsPerRing / 2;
+  scanner.viewOffset = 0.0;
+
+  return true;
+}
+
+//One segment of a span-compressed sinogram: ring pairs with ring
+//difference in [minRingDifference, maxRingDifference], grouped by the sum
+//of their ring numbers (the axial position).
+struct SinogramSegment {
+  int minRingDifference = 0;
+  int maxRingDifference = 0;
+
+  //Per axial position: centre (mm from the middle of the axial FOV) and
+  //mean ring difference of the ring pairs combined into it.
+  std::vector<double> z;
+  std::vector<double> ringDifference;
+};
+
+//Segments in storage order (most negative ring difference first).
+std::vector<SinogramSegment> ComputeSinogramSegments(const ScannerGeometry &scanner){
+
+  const int numRings = static_cast<int>(scanner.numRings);
+  const int span = static_cast<int>(std::max(1u, scanner.span));
+  const int maxDiff = static_cast<int>(std::min(scanner.maxRingDifference, scanner.numRings - 1));
+  const int numSegments = (maxDiff - (span - 1) / 2 + span - 1) / span;
+
+  std::vector<SinogramSegment> segments;
+
+  for (int k = -numSegments; k <= numSegments; k++) {
+    SinogramSegment segment;
+    segment.minRingDifference = std::max(-maxDiff, k * span - (span - 1) / 2);
+    segment.maxRingDifference = std::min(maxDiff, k * span + (span - 1) / 2);
+
+    for (int sum = 0; sum <= 2 * numRings - 2; sum++) {
+      double total = 0.0;
+      unsigned int count = 0;
+      for (int d = segment.minRingDifference; d <= segment.maxRingDifference; d++) {
+        //Rings r1 = (sum + d)/2 and r2 = (sum - d)/2 must both exist.
+        if ((sum + d) % 2 == 0 && sum + d >= 0 && sum - d >= 0 &&
+            sum + d <= 2 * numRings - 2 && sum - d <= 2 * numRings - 2) {
+          total += d;
+          count++;
+        }
+      }
+
+      if (count > 0) {
+        segment.z.push_back((0.5 * sum - 0.5 * (numRings - 1)) * scanner.ringSpacing);
+        segment.ringDifference.push_back(total / count);
+      }
+    }
+
+    segments.push_back(segment);
+  }
+
+  return segments;
+}
+
+//Computes ACFs, exp(integral of mu along each line of response), for a
+//scanner from a mu-map in cm-1. The scanner axis is taken to be the
+//physical line x = y = 0 and the axial FOV to be centred on the mu-map,
+//whose slices must be transaxial (e.g. RAS or RAI orientation).
+//
+//Lines of response sharing a view and tangential position differ only
+//in their axial position and tilt, so each one's path through the x-y
+//grid is traced once (Siddon) and reused for every sinogram, sampling
+//the mu-map linearly in z along it (Joseph). Views run in parallel. The
+//scanner's ray geometry is built once, so a projector can be reused for
+//many mu-maps.
+class ACFProjector {
+
+public:
+
+  explicit ACFProjector(const ScannerGeometry &scanner);
+
+  bool Update(const itk::Image<float, 3> *muMap);
+
+  //ACFs in storage order: segment, axial position, view, tangential bin.
+  const std::vector<float>& GetOutput() const { return _acf; };
+
+  const std::vector<SinogramSegment>& GetSegments() const { return _segments; };
+
+  //STIR-style Interfile sinogram header.
+  InterfileHeaderBuilder GetInterfileHeader() const;
+
+  //Write <dst>.hs and <dst>.s.
+  bool Write(const boost::filesystem::path &dst) const;
+
+protected:
+
+  //Part of one ray's path through the x-y grid.
+  struct PathStep {
+    uint32_t offset;  //voxel within the slice
+    float t;          //position along the ray (mm) of the middle of the step
+    float length;     //mm
+  };
+
+  //Trace the ray for view v and bin b through an nx by ny grid with
+  //origin/axes (ox,oy)/(ax,ay) (mm, signed), appending to path.
+  void TracePath(unsigned int v, unsigned int b, std::size_t nx, std::size_t ny,
+                 double ox, double oy, double ax, double ay, std::vector<PathStep> &path) const;
+
+  ScannerGeometry _scanner;
+  std::vector<SinogramSegment> _segments;
+
+  //Ray geometry: view directions, tangential positions and half-lengths.
+  std::vector<double> _cosView;
+  std::vector<double> _sinView;
+  std::vector<double> _tangential;
+  std::vector<double> _halfLength;
+
+  std::vector<float> _acf;
+
+};
+
+ACFProjector::ACFProjector(const ScannerGeometry &scanner) : _scanner(scanner){
+
+  _segments = ComputeSinogramSegments(_scanner);
+
+  for (unsigned int v = 0; v < _scanner.numViews; v++) {
+    const double phi = v * M_PI / _scanner.numViews + _scanner.viewOffset;
+    _cosView.push_back(std::cos(phi));
+    _sinView.push_back(std::sin(phi));
+  }
+
+  //Non-arc-corrected bins are equally spaced in angle.
+  const double radius = _scanner.innerRadius + _scanner.averageDOI;
+  for (unsigned int b = 0; b < _scanner.numBins; b++) {
+    const double position = static_cast<double>(b) - static_cast<double>(_scanner.numBins / 2);
+    const double s = radius * std::sin(position * _scanner.binSize / radius);
+    _tangential.push_back(s);
+    _halfLength.push_back(std::sqrt(std::max(0.0, radius * radius - s * s)));
+  }
+}
+
+//The ray is at (s cos phi - t sin phi, s sin phi + t cos phi) for t in
+//[-halfLength, halfLength]. Voxel (i, j) covers continuous indices
+//[i - 0.5, i + 0.5) x [j - 0.5, j + 0.5).
+void ACFProjector::TracePath(unsigned int v, unsigned int b, std::size_t nx, std::size_t ny,
+                             double ox, double oy, double ax, double ay,
+                             std::vector<PathStep> &path) const {
+
+  const double s = _tangential[b];
+
+  //Continuous index along each axis: u(t) = u0 + t du.
+  const double u0 = (s * _cosView[v] - ox) / ax;
+  const double du = -_sinView[v] / ax;
+  const double v0 = (s * _sinView[v] - oy) / ay;
+  const double dv = _cosView[v] / ay;
+
+  double tStart = -_halfLength[b];
+  double tEnd = _halfLength[b];
+
+  //Clip to the grid.
+  const double bounds[2][2] = { { -0.5, nx - 0.5 }, { -0.5, ny - 0.5 } };
+  const double origins[2] = { u0, v0 };
+  const double steps[2] = { du, dv };
+
+  for (unsigned int k = 0; k < 2; k++) {
+    if (std::fabs(steps[k]) < 1e-12) {
+      if (origins[k] < bounds[k][0] || origins[k] >= bounds[k][1])
+        return;
+      continue;
+    }
+    double t0 = (bounds[k][0] - origins[k]) / steps[k];
+    double t1 = (bounds[k][1] - origins[k]) / steps[k];
+    if (t0 > t1)
+      std::swap(t0, t1);
+    tStart = std::max(tStart, t0);
+    tEnd = std::min(tEnd, t1);
+  }
+
+  if (tEnd <= tStart)
+    return;
+
+  //March through voxel boundaries (Amanatides & Woo).
+  long cell[2];
+  long cellStep[2];
+  double tNext[2];
+  double tDelta[2];
+  const long limits[2] = { static_cast<long>(nx), static_cast<long>(ny) };
+
+  for (unsigned int k = 0; k < 2; k++) {
+    //Cell containing the start (judged just inside, to avoid edge ties).
+    const double c = origins[k] + (tStart + 1e-9 * (tEnd - tStart)) * steps[k];
+    cell[k] = std::max(0L, std::min(limits[k] - 1, static_cast<long>(std::floor(c + 0.5))));
+
+    if (std::fabs(steps[k]) < 1e-12) {
+      cellStep[k] = 0;
+      tNext[k] = tEnd;
+      tDelta[k] = 0.0;
+    }
+    else {
+      cellStep[k] = steps[k] > 0.0 ? 1 : -1;
+      const double boundary = cell[k] + 0.5 * cellStep[k];
+      tNext[k] = (boundary - origins[k]) / steps[k];
+      tDelta[k] = 1.0 / std::fabs(steps[k]);
+    }
+  }
+
+  double t = tStart;
+
+  while (t < tEnd) {
+    const unsigned int k = tNext[0] < tNext[1] ? 0 : 1;
+    const double tExit = std::min(tNext[k], tEnd);
+
+    if (tExit > t) {
+      PathStep step;
+      step.offset = static_cast<uint32_t>(cell[1] * nx + cell[0]);
+      step.t = static_cast<float>(0.5 * (t + tExit));
+      step.length = static_cast<float>(tExit - t);
+      path.push_back(step);
+    }
+
+    t = tExit;
+    cell[k] += cellStep[k];
+    tNext[k] += tDelta[k];
+
+    if (cell[k] < 0 || cell[k] >= limits[k])
+      break;
+  }
+}
+
+bool ACFProjector::Update(const itk::Image<float, 3> *muMap){
+
+  typedef itk::Image<float, 3> ImageType;
+
+  const ImageType::SizeType &size = muMap->GetBufferedRegion().GetSize();
+  const ImageType::SpacingType &spacing = muMap->GetSpacing();
+  const ImageType::PointType &origin = muMap->GetOrigin();
+  const ImageType::DirectionType &direction = muMap->GetDirection();
+
+  //Signed axis lengths; the image axes must be the physical axes.
+  double axis[3];
+  for (unsigned int k = 0; k < 3; k++) {
+    if (std::fabs(std::fabs(direction[k][k]) - 1.0) > 1e-3) {
+      LOG(ERROR) << "ACFs need a mu-map with transaxial slices (e.g. RAS or RAI orientation)!";
+      return false;
+    }
+    axis[k] = spacing[k] * (direction[k][k] > 0.0 ? 1.0 : -1.0);
+  }
+
+  const std::size_t nx = size[0];
+  const std::size_t ny = size[1];
+  const std::size_t nz = size[2];
+  const std::size_t sliceSize = nx * ny;
+  const float *mu = muMap->GetBufferPointer();
+
+  const std::size_t numViews = _scanner.numViews;
+  const std::size_t numBins = _scanner.numBins;
+
+  std::vector<std::size_t> segmentStart;
+  std::size_t total = 0;
+  for (const SinogramSegment &segment : _segments) {
+    segmentStart.push_back(total);
+    total += segment.z.size() * numViews * numBins;
+  }
+
+  _acf.assign(total, 1.0f);
+
+  //Each ray stays within a few columns (x-y voxels) for many samples and
+  //every sinogram at a (view, bin) visits the same columns, so the mu-map
+  //is stored column by column. A zero is added at each end of a column,
+  //so samples beyond the volume need no bounds checks.
+  const std::size_t columnSize = nz + 2;
+  std::vector<float> columns(sliceSize * columnSize, 0.0f);
+
+  ParallelFor(0, ny, [&](std::size_t yFirst, std::size_t yLast, unsigned int){
+    for (std::size_t i = yFirst * nx; i < yLast * nx; i++)
+      for (std::size_t z = 0; z < nz; z++)
+        columns[i * columnSize + z + 1] = mu[z * sliceSize + i];
+  });
+
+  const std::size_t centreSegment = _segments.size() / 2;
+  const float lastPosition = static_cast<float>(nz);
+
+  ParallelFor(0, numViews, [&](std::size_t vFirst, std::size_t vLast, unsigned int){
+
+    std::vector<PathStep> path;
+    std::vector<float> position;
+    std::vector<float> slope;
+    std::vector<float> sums[2];
+
+    for (std::size_t v = vFirst; v < vLast; v++) {
+      for (std::size_t b = 0; b < numBins; b++) {
+
+        //The x-y path of this (view, bin), shared by every sinogram.
+        path.clear();
+        TracePath(v, b, nx, ny, origin[0], origin[1], axis[0], axis[1], path);
+
+        if (path.empty())
+          continue;
+
+        //Segments +k and -k (opposite ring differences at the same axial
+        //positions) have mirrored tilts, so are summed together.
+        for (std::size_t g = centreSegment; g < _segments.size(); g++) {
+          const SinogramSegment &segment = _segments[g];
+          const std::size_t mirror = _segments.size() - 1 - g;
+          const unsigned int numTilts = mirror == g ? 1 : 2;
+          const std::size_t numAxial = segment.z.size();
+
+          //Position in the padded column along each ray:
+          //position +/- t * slope.
+          position.resize(numAxial);
+          slope.resize(numAxial);
+          for (std::size_t a = 0; a < numAxial; a++) {
+            const double tilt = segment.ringDifference[a] * _scanner.ringSpacing / (2.0 * _halfLength[b]);
+            position[a] = static_cast<float>(0.5 * (nz - 1) + 1.0 + segment.z[a] / axis[2]);
+            slope[a] = static_cast<float>(tilt / axis[2]);
+          }
+
+          for (unsigned int m = 0; m < numTilts; m++) {
+            sums[m].assign(numAxial, 0.0f);
+            const float sign = m == 0 ? 1.0f : -1.0f;
+
+            for (const PathStep &step : path) {
+              const float *column = &columns[step.offset * columnSize];
+              const float t = sign * step.t;
+              float *sum = sums[m].data();
+
+              for (std::size_t a = 0; a < numAxial; a++) {
+                const float w = std::min(std::max(position[a] + t * slope[a], 0.0f), lastPosition);
+                const std::size_t z0 = static_cast<std::size_t>(w);
+                const float f = w - z0;
+                sum[a] += step.length * (column[z0] + f * (column[z0 + 1] - column[z0]));
+              }
+            }
+          }
+
+          for (std::size_t a = 0; a < numAxial; a++) {
+            const double tilt = segment.ringDifference[a] * _scanner.ringSpacing / (2.0 * _halfLength[b]);
+            const double secant = std::sqrt(1.0 + tilt * tilt);
+            const std::size_t offset = (a * numViews + v) * numBins + b;
+
+            //mu in cm-1, lengths in mm.
+            _acf[segmentStart[g] + offset] = static_cast<float>(std::exp(0.1 * secant * sums[0][a]));
+            if (numTilts == 2)
+              _acf[segmentStart[mirror] + offset] = static_cast<float>(std::exp(0.1 * secant * sums[1][a]));
+          }
+        }
+      }
+    }
+  });
+
+  return true;
+}
+
+InterfileHeaderBuilder ACFProjector::GetInterfileHeader() const {
+
+  InterfileHeaderBuilder header;
+  header.SetSeparator(" := ");
+
+  header.AddSection("!INTERFILE ");
+  header.Set("!imaging modality", "PT");
+  header.Set("name of data file", "");
+  header.Set("originating system", _scanner.name);
+  header.Set("!version of keys", "STIR3.0");
+  header.AddSection("!GENERAL DATA");
+  header.AddSection("!GENERAL IMAGE DATA");
+  header.Set("!type of data", "PET");
+  header.Set("imagedata byte order", "LITTLEENDIAN");
+  header.AddSection("!PET STUDY (General)");
+  header.Set("!PET data type", "Emission");
+  header.Set("applied corrections", "{None}");
+  header.Set("!number format", "float");
+  header.Set("!number of bytes per pixel", 4);
+  header.Set("number of dimensions", 4);
+  header.Set("matrix axis label [4]", "segment");
+  header.Set("!matrix size [4]", _segments.size());
+  header.Set("matrix axis label [3]", "axial coordinate");
+
+  std::stringstream sizes, minDiffs, maxDiffs;
+  for (std::size_t g = 0; g < _segments.size(); g++) {
+    const char *sep = g == 0 ? "" : ",";
+    sizes << sep << _segments[g].z.size();
+    minDiffs << sep << _segments[g].minRingDifference;
+    maxDiffs << sep << _segments[g].maxRingDifference;
+  }
+
+  header.Set("!matrix size [3]", "{ " + sizes.str() + "}");
+  header.Set("matrix axis label [2]", "view");
+  header.Set("!matrix size [2]", _scanner.numViews);
+  header.Set("matrix axis label [1]", "tangential coordinate");
+  header.Set("!matrix size [1]", _scanner.numBins);
+  header.Set("minimum ring difference per segment", "{ " + minDiffs.str() + "}");
+  header.Set("maximum ring difference per segment", "{ " + maxDiffs.str() + "}");
+
+  //Scanner values to the stream's default precision (6 significant digits).
+  const auto text = [](double value){
+    std::ostringstream ss;
+    ss << value;
+    return ss.str();
+  };
+
+  header.AddLine("Scanner parameters:= ");
+  header.Set("Scanner type", _scanner.name);
+  header.Set("Number of rings", _scanner.numRings);
+  header.Set("Number of detectors per ring", _scanner.numDetectorsPerRing);
+  header.Set("Inner ring diameter (cm)", text(0.2 * _scanner.innerRadius));
+  header.Set("Average depth of interaction (cm)", text(0.1 * _scanner.averageDOI));
+  header.Set("Distance between rings (cm)", text(0.1 * _scanner.ringSpacing));
+  header.Set("Default bin size (cm)", text(0.1 * _scanner.binSize));
+  header.Set("View offset (degrees)", text(_scanner.viewOffset * 180.0 / M_PI));
+  header.Set("Maximum number of non-arc-corrected bins", _scanner.numBins);
+  header.Set("Default number of arc-corrected bins", _scanner.numBins);
+  header.AddLine("end scanner parameters:=");
+
+  header.Set("effective central bin size (cm)", text(0.1 * _scanner.binSize));
+  header.Set("number of time frames", 1);
+  header.AddSection("!END OF INTERFILE");
+
+  return header;
+}
+
+bool ACFProjector::Write(const boost::filesystem::path &dst) const {
+
+  if (_acf.empty()) {
+    LOG(ERROR) << "No ACFs to write!";
+    return false;
+  }
+
+  InterfileImageWriter writer;
+  writer.SetExtensions(".hs", ".s");
+  writer.SetHeader(GetInterfileHeader());
+  writer.AddFrame(_acf.data(), _acf.size());
+
+  return writer.Write(dst);
+}
+
+} //namespace nmtools
+
+#endif
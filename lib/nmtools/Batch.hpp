@@ -0,0 +1,400 @@
+/*
+   Batch.hpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Converting many MRAC directories/series to mu-maps in one process.
+ */
+
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <glog/logging.h>
+
+#include "MRAC.hpp"
+#include "DicomScanner.hpp"
+#include "Parallel.hpp"
+
+namespace nmtools {
+
+//One conversion: input directory to output file.
+struct BatchJob {
+  boost::filesystem::path input;
+  boost::filesystem::path output;
+
+  //Series to convert. If empty, the first series in input is used.
+  std::vector<DicomSliceInfo> slices;
+};
+
+//Settings shared by every job in a batch.
+struct BatchOptions {
+  std::string orientationCode = "RAI";
+  boost::filesystem::path cacheDir;
+  bool isHead = false;
+  int compressionLevel = Z_DEFAULT_COMPRESSION;
+  Interpolation interpolation = Interpolation::Linear;
+  nlohmann::json params = resliceDefaultParams;
+  double smoothingFWHM = 0.0;
+
+  //Hardware mu-maps (mMR only) and the table position they are placed at.
+  std::vector<boost::filesystem::path> hardwareMuMaps;
+  double bedPosition = 0.0;
+
+  //Series description of the beds when stitching. Empty = pick the
+  //mu-map series.
+  std::string bedDescription;
+
+  //Jobs run at once. 0 = one per core (up to the number of jobs).
+  unsigned int numConcurrent = 0;
+};
+
+//Outcome of one job, for the summary.
+struct BatchResult {
+  bool success = false;
+  double seconds = 0.0;
+};
+
+//Read a list of jobs: one '<input dir> <output file>' pair per line.
+//Blank lines and lines starting with '#' are skipped.
+bool ReadBatchList(const boost::filesystem::path &listFile, std::vector<BatchJob> &jobs){
+
+  std::ifstream in(listFile.string());
+
+  if (!in) {
+    LOG(ERROR) << "Unable to open batch list " << listFile;
+    return false;
+  }
+
+  std::string line;
+  unsigned int lineNo = 0;
+
+  while (std::getline(in, line)) {
+    lineNo++;
+
+    //Tolerate lists written on Windows.
+    if (!line.empty() && line[line.size() - 1] == '\r')
+      line.erase(line.size() - 1);
+
+    std::stringstream ss(line);
+    BatchJob job;
+    std::string input, output;
+
+    if (!(ss >> input) || input[0] == '#')
+      continue;
+
+    if (!(ss >> output)) {
+      LOG(ERROR) << listFile << ":" << lineNo << ": no output file for " << input;
+      return false;
+    }
+
+    job.input = input;
+    job.output = output;
+    jobs.push_back(job);
+  }
+
+  return true;
+}
+
+//Match name against a pattern with '*' (any run) and '?' (any one char).
+bool WildcardMatch(const std::string &pattern, const std::string &name){
+
+  std::size_t p = 0, n = 0;
+  std::size_t star = std::string::npos, mark = 0;
+
+  while (n < name.size()) {
+    if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+      p++;
+      n++;
+    }
+    else if (p < pattern.size() && pattern[p] == '*') {
+      star = p++;
+      mark = n;
+    }
+    else if (star != std::string::npos) {
+      p = star + 1;
+      n = ++mark;
+    }
+    else {
+      return false;
+    }
+  }
+
+  while (p < pattern.size() && pattern[p] == '*')
+    p++;
+
+  return p == pattern.size();
+}
+
+//Jobs for every directory matching pattern (wildcards in the last path
+//component only, e.g. /data/sub-*/mrac). Each output is outputTemplate
+//with '{}' replaced by the name of the matching directory.
+bool GlobBatchJobs(const boost::filesystem::path &pattern, const std::string &outputTemplate,
+                   std::vector<BatchJob> &jobs){
+
+  namespace fs = boost::filesystem;
+
+  if (outputTemplate.find("{}") == std::string::npos) {
+    LOG(ERROR) << "Output template " << outputTemplate << " has no '{}' placeholder!";
+    return false;
+  }
+
+  fs::path parent = pattern.parent_path();
+  if (parent.empty())
+    parent = ".";
+
+  const std::string namePattern = pattern.filename().string();
+
+  if (!fs::is_directory(parent)) {
+    LOG(ERROR) << parent << " is not a directory!";
+    return false;
+  }
+
+  std::vector<fs::path> matches;
+  for (fs::directory_iterator it(parent), end; it != end; ++it) {
+    if (fs::is_directory(it->status()) &&
+        WildcardMatch(namePattern, it->path().filename().string()))
+      matches.push_back(it->path());
+  }
+
+  std::sort(matches.begin(), matches.end());
+
+  for (const fs::path &m : matches) {
+    std::string output = outputTemplate;
+    output.replace(output.find("{}"), 2, m.filename().string());
+
+    BatchJob job;
+    job.input = m;
+    job.output = output;
+    jobs.push_back(job);
+  }
+
+  if (jobs.empty()) {
+    LOG(ERROR) << "No directories match " << pattern;
+    return false;
+  }
+
+  return true;
+}
+
+//Output path for one of several series: <stem>_s<number>[_<description>]<ext>.
+//Compound extensions such as .nii.gz are kept.
+boost::filesystem::path GetSeriesOutputPath(const boost::filesystem::path &dst,
+                                            const DicomSliceInfo &slice){
+
+  boost::filesystem::path stem = dst.stem();
+  std::string ext = dst.extension().string();
+
+  if (ext == ".gz") {
+    ext = stem.extension().string() + ext;
+    stem = stem.stem();
+  }
+
+  std::string description = slice.seriesDescription;
+  for (char &c : description) {
+    if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-')
+      c = '_';
+  }
+
+  std::stringstream ss;
+  ss << stem.string() << "_s" << slice.seriesNumber;
+  if (!description.empty())
+    ss << "_" << description;
+  ss << ext;
+
+  return dst.parent_path() / ss.str();
+}
+
+//Log one line per job and a total.
+void LogBatchSummary(const std::vector<BatchJob> &jobs, const std::vector<BatchResult> &results){
+
+  std::size_t numFailed = 0;
+  double totalSeconds = 0.0;
+
+  LOG(INFO) << "Batch summary:";
+
+  for (std::size_t i = 0; i < jobs.size(); i++) {
+    std::stringstream ss;
+    ss << (results[i].success ? "  OK     " : "  FAILED ")
+       << std::fixed << std::setprecision(1) << std::setw(7) << results[i].seconds << "s  "
+       << jobs[i].input.string() << " -> " << jobs[i].output.string();
+
+    if (results[i].success)
+      LOG(INFO) << ss.str();
+    else
+      LOG(ERROR) << ss.str();
+
+    if (!results[i].success)
+      numFailed++;
+    totalSeconds += results[i].seconds;
+  }
+
+  LOG(INFO) << jobs.size() - numFailed << " of " << jobs.size() << " succeeded ("
+            << std::fixed << std::setprecision(1) << totalSeconds << "s of conversion time)";
+}
+
+//Run jobs with TConverter (an MRAC2MU), a bounded number at a time.
+//Converters share one pool for scanning and slice decoding, and the
+//cores are split between concurrent jobs for their own kernels. A
+//failing job does not stop the others. Returns false if any failed.
+template <class TConverter>
+bool RunBatch(const std::vector<BatchJob> &jobs, const BatchOptions &options){
+
+  if (jobs.empty()) {
+    LOG(ERROR) << "Nothing to convert!";
+    return false;
+  }
+
+  const unsigned int numThreads = GetDefaultNumberOfThreads();
+
+  unsigned int numConcurrent = options.numConcurrent > 0 ? options.numConcurrent : numThreads;
+  numConcurrent = static_cast<unsigned int>(std::min<std::size_t>(numConcurrent, jobs.size()));
+
+  LOG(INFO) << "Converting " << jobs.size() << " job(s), " << numConcurrent << " at a time";
+
+  std::vector<BatchResult> results(jobs.size());
+
+  {
+    //Decoding tasks go to their own pool: jobs block on them, so they
+    //cannot share the job pool.
+    ThreadPool ioPool(numThreads);
+
+    const unsigned int threadsPerJob = std::max(1u, numThreads / numConcurrent);
+
+    ThreadPool jobPool(numConcurrent);
+    std::vector< std::future<void> > done;
+
+    for (std::size_t i = 0; i < jobs.size(); i++) {
+      done.push_back(jobPool.Submit([&, i](){
+
+        const BatchJob &job = jobs[i];
+        ScopedNumberOfThreads threads(threadsPerJob);
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        std::unique_ptr<TConverter> mrac;
+        bool bStatus = false;
+
+        try {
+          mrac.reset(new TConverter(job.input, options.orientationCode));
+
+          mrac->SetCacheDirectory(options.cacheDir);
+          mrac->SetThreadPool(&ioPool);
+          mrac->SetIsHead(options.isHead);
+          mrac->SetCompressionLevel(options.compressionLevel);
+          mrac->SetInterpolation(options.interpolation);
+          mrac->SetSmoothing(options.smoothingFWHM);
+          for (const boost::filesystem::path &templatePath : options.hardwareMuMaps)
+            mrac->AddHardwareMuMap(templatePath);
+          mrac->SetBedPosition(options.bedPosition);
+          mrac->SetBedDescription(options.bedDescription);
+          if (!job.slices.empty())
+            mrac->SetSeries(job.slices);
+
+          if (!mrac->SetParams(options.params))
+            LOG(ERROR) << "Invalid reslicing params for " << job.input;
+          else if (!mrac->Update())
+            LOG(ERROR) << "Failed to scale image from " << job.input;
+          else if (!mrac->Write(job.output))
+            LOG(ERROR) << "Failed to write " << job.output;
+          else
+            bStatus = true;
+        } catch (bool) {
+          LOG(ERROR) << "Failed to create MRAC converter for " << job.input;
+        } catch (std::exception &e) {
+          LOG(ERROR) << "Conversion of " << job.input << " failed: " << e.what();
+        }
+
+        results[i].success = bStatus;
+        results[i].seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (bStatus)
+          LOG(INFO) << "Wrote " << job.output;
+      }));
+    }
+
+    for (auto &d : done)
+      d.get();
+  }
+
+  LogBatchSummary(jobs, results);
+
+  for (const BatchResult &r : results) {
+    if (!r.success)
+      return false;
+  }
+
+  return true;
+}
+
+//Convert every series found in src (one directory scan). Outputs are
+//named with GetSeriesOutputPath(dst, ...).
+template <class TConverter>
+bool ConvertAllSeries(const boost::filesystem::path &src, const boost::filesystem::path &dst,
+                      const BatchOptions &options){
+
+  DicomSeriesScanner scanner;
+  scanner.SetDirectory(src);
+  scanner.SetCacheDirectory(options.cacheDir);
+
+  if (!scanner.Update()) {
+    LOG(ERROR) << "Cannot read DICOM directory!";
+    return false;
+  }
+
+  const std::vector<std::string> seriesIds = scanner.GetSeriesIdentifiers();
+
+  if (seriesIds.empty()) {
+    LOG(ERROR) << "No valid DICOM series found";
+    return false;
+  }
+
+  LOG(INFO) << "Found " << seriesIds.size() << " series";
+
+  //Unique output name for each series.
+  std::vector<BatchJob> jobs;
+  std::set<std::string> used;
+
+  for (const std::string &id : seriesIds) {
+    BatchJob job;
+    job.input = src;
+    job.slices = scanner.GetSlices(id);
+    job.output = GetSeriesOutputPath(dst, job.slices[0]);
+
+    for (unsigned int n = 2; used.count(job.output.string()) > 0; n++) {
+      DicomSliceInfo renamed = job.slices[0];
+      renamed.seriesDescription += "_" + std::to_string(n);
+      job.output = GetSeriesOutputPath(dst, renamed);
+    }
+
+    used.insert(job.output.string());
+    jobs.push_back(job);
+  }
+
+  return RunBatch<TConverter>(jobs, options);
+}
+
+} //namespace nmtools
+
+#endif
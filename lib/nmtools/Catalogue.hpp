@@ -0,0 +1,615 @@
+/*
+   Catalogue.hpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   SQLite catalogue of raw data files, built from header-only scans.
+ */
+
+#ifndef CATALOGUE_HPP
+#define CATALOGUE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <future>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <sqlite3.h>
+
+#include <gdcmReader.h>
+#include <boost/filesystem.hpp>
+#include <glog/logging.h>
+
+#include "Common.hpp"
+#include "GEPET.hpp"
+#include "MMR.hpp"
+#include "Parallel.hpp"
+#include "json/json.hpp"
+
+namespace nmtools {
+
+//What the catalogue holds for one file. type is a SiemensPETFactory or
+//GEPETFactory file type name (e.g. MMR_LIST), SIDECAR for nm_extract
+//metadata sidecars, or UNKNOWN / NOT_DICOM.
+struct CatalogueEntry {
+  std::string path;
+  uintmax_t size = 0;
+  std::time_t modified = 0;
+  std::string type;
+  nlohmann::json metadata = nlohmann::json::object();
+};
+
+//One result of CatalogueQuery.
+struct CatalogueRow {
+  std::string path;
+  std::string type;
+  std::string scanner;
+  std::string studyDate;
+  std::string studyTime;
+  std::string headerFile;  //From a sidecar, if one was indexed.
+  std::string dataFile;
+};
+
+//Filters for RawDataCatalogue::Find(); empty fields match everything.
+struct CatalogueQuery {
+  std::string type;
+  std::string scanner;  //Serial number, station or model name.
+  std::string from;     //Study dates, YYYY-MM-DD, inclusive.
+  std::string to;
+  //Only files with no file of this type from the same scanner on the
+  //same study date (e.g. list mode without a norm). Files with no
+  //scanner or study date are left out.
+  std::string without;
+};
+
+//True if path starts with the 'DICM' preamble. Checked before handing a
+//file to GDCM, so extracted raw data etc. are skipped cheaply.
+bool HasDicomPreamble(const std::string &path){
+
+  char magic[132];
+  std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+
+  if (!in.read(magic, sizeof(magic)))
+    return false;
+
+  return magic[128] == 'D' && magic[129] == 'I' && magic[130] == 'C' && magic[131] == 'M';
+}
+
+//Classify path and collect its metadata from the DICOM and (Siemens)
+//Interfile headers, without reading the raw data. Sidecars written by
+//nm_extract are recognised by their SourceFile key.
+bool ReadCatalogueEntry(CatalogueEntry &entry){
+
+  namespace fs = boost::filesystem;
+
+  if (fs::path(entry.path).extension() == ".json") {
+    try {
+      std::ifstream in(entry.path.c_str());
+      nlohmann::json sidecar;
+      in >> sidecar;
+
+      if (sidecar.is_object() && sidecar.count("SourceFile")) {
+        const fs::path dir = fs::path(entry.path).parent_path();
+        for (const char *key : { "HeaderFile", "DataFile" }) {
+          if (sidecar.count(key) && sidecar[key].is_string())
+            sidecar[key] = (dir / sidecar[key].get<std::string>()).string();
+        }
+        entry.type = "SIDECAR";
+        entry.metadata = sidecar;
+        return true;
+      }
+    } catch (std::exception &e) {
+      DLOG(INFO) << "Not a sidecar: " << entry.path;
+    }
+    entry.type = "NOT_DICOM";
+    return true;
+  }
+
+  if (!HasDicomPreamble(entry.path)) {
+    entry.type = "NOT_DICOM";
+    return true;
+  }
+
+  gdcm::Reader reader;
+  if (!IRawDataFactory::ReadHeaderOnly(reader, entry.path)) {
+    entry.type = "NOT_DICOM";
+    return true;
+  }
+
+  const gdcm::File &file = reader.GetFile();
+
+  SiemensPETFactory siemens;
+  const SiemensPETFactory::FileType siemensType = siemens.GetFileType(file);
+
+  if (siemensType == SiemensPETFactory::FileType::EMMRLIST ||
+      siemensType == SiemensPETFactory::FileType::EMMRSINO ||
+      siemensType == SiemensPETFactory::FileType::EMMRNORM) {
+
+    entry.type = SiemensPETFactory::GetFileTypeName(siemensType);
+
+    std::string headerString;
+    if (GetSiemensInterfileHeader(file, headerString))
+      GetSiemensInterfileMetadata(InterfileParser(headerString), entry.metadata);
+  }
+  else {
+    GEPETFactory ge;
+    const GEPETFactory::FileType geType = ge.GetFileType(file);
+    entry.type = GEPETFactory::GetFileTypeName(geType);
+
+    if (geType != GEPETFactory::FileType::EUNKNOWN && geType != GEPETFactory::FileType::EERROR)
+      GetGEPETMetadata(file, entry.metadata);
+  }
+
+  GetDicomMetadata(file, entry.metadata);
+
+  return true;
+}
+
+//Catalogue of raw data files in an SQLite database. Index() walks a
+//directory tree, reads the headers of new or modified files (by size and
+//modification time) in parallel and records their type and metadata;
+//files that have gone are dropped. Queries then run on the database
+//alone.
+class RawDataCatalogue {
+
+public:
+
+  RawDataCatalogue(){};
+  ~RawDataCatalogue();
+
+  RawDataCatalogue(const RawDataCatalogue&) = delete;
+  RawDataCatalogue& operator=(const RawDataCatalogue&) = delete;
+
+  //Open (creating if need be) the database. Read-only databases can
+  //only be queried.
+  bool Open(const boost::filesystem::path &dbPath, bool readOnly = false);
+
+  //Use an existing pool rather than creating one per scan.
+  void SetThreadPool(ThreadPool *pool){ _pool = pool; };
+
+  bool Index(const boost::filesystem::path &root);
+
+  //Counts from the last Index().
+  std::size_t GetNumberOfFilesRead() const { return _numFilesRead; };
+  std::size_t GetNumberOfFilesRemoved() const { return _numFilesRemoved; };
+
+  bool Find(const CatalogueQuery &query, std::vector<CatalogueRow> &rows);
+
+  //Run sql and write the result to out, tab-separated with a header row.
+  bool Execute(const std::string &sql, std::ostream &out);
+
+protected:
+
+  typedef std::unique_ptr<sqlite3_stmt, int(*)(sqlite3_stmt*)> Statement;
+
+  Statement Prepare(const std::string &sql);
+  bool Exec(const std::string &sql);
+
+  bool Insert(sqlite3_stmt *stmt, const CatalogueEntry &entry);
+
+  sqlite3 *_db = nullptr;
+  ThreadPool *_pool = nullptr;
+
+  std::size_t _numFilesRead = 0;
+  std::size_t _numFilesRemoved = 0;
+
+};
+
+RawDataCatalogue::~RawDataCatalogue(){
+  if (_db != nullptr)
+    sqlite3_close(_db);
+}
+
+bool RawDataCatalogue::Exec(const std::string &sql){
+
+  char *error = nullptr;
+
+  if (sqlite3_exec(_db, sql.c_str(), nullptr, nullptr, &error) != SQLITE_OK) {
+    LOG(ERROR) << "SQLite: " << (error ? error : "unknown error");
+    sqlite3_free(error);
+    return false;
+  }
+
+  return true;
+}
+
+RawDataCatalogue::Statement RawDataCatalogue::Prepare(const std::string &sql){
+
+  sqlite3_stmt *stmt = nullptr;
+
+  if (sqlite3_prepare_v2(_db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    LOG(ERROR) << "SQLite: " << sqlite3_errmsg(_db);
+    stmt = nullptr;
+  }
+
+  return Statement(stmt, sqlite3_finalize);
+}
+
+bool RawDataCatalogue::Open(const boost::filesystem::path &dbPath, bool readOnly){
+
+  const int flags = readOnly ? SQLITE_OPEN_READONLY
+                             : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+
+  if (sqlite3_open_v2(dbPath.string().c_str(), &_db, flags, nullptr) != SQLITE_OK) {
+    LOG(ERROR) << "Unable to open catalogue " << dbPath << ": " << sqlite3_errmsg(_db);
+    return false;
+  }
+
+  if (readOnly)
+    return true;
+
+  //One row per file. scanner is the serial number, else the station or
+  //model name, so files from one scanner can be matched.
+  return Exec("PRAGMA journal_mode=WAL;"
+              "PRAGMA synchronous=NORMAL;"
+              "CREATE TABLE IF NOT EXISTS files ("
+              "  path TEXT PRIMARY KEY,"
+              "  size INTEGER, modified INTEGER, type TEXT,"
+              "  manufacturer TEXT, model TEXT, station TEXT, serial TEXT, scanner TEXT,"
+              "  study_date TEXT, study_time TEXT,"
+              "  study_uid TEXT, series_uid TEXT, sop_uid TEXT,"
+              "  isotope TEXT, duration REAL, bed_position REAL, word_count INTEGER,"
+              "  header_file TEXT, data_file TEXT,"
+              "  metadata TEXT);"
+              "CREATE INDEX IF NOT EXISTS files_type ON files(type, scanner, study_date);"
+              "CREATE INDEX IF NOT EXISTS files_sop ON files(sop_uid);");
+}
+
+//Bind the columns of entry (in table order) and step.
+bool RawDataCatalogue::Insert(sqlite3_stmt *stmt, const CatalogueEntry &entry){
+
+  const nlohmann::json &m = entry.metadata;
+  int column = 1;
+
+  auto bindText = [&](const char *key){
+    if (m.count(key) && m[key].is_string()) {
+      const std::string value = m[key].get<std::string>();
+      sqlite3_bind_text(stmt, column++, value.c_str(), -1, SQLITE_TRANSIENT);
+    }
+    else {
+      sqlite3_bind_null(stmt, column++);
+    }
+  };
+
+  auto bindNumber = [&](const nlohmann::json &value){
+    if (value.is_number())
+      sqlite3_bind_double(stmt, column++, value.get<double>());
+    else
+      sqlite3_bind_null(stmt, column++);
+  };
+
+  sqlite3_bind_text(stmt, column++, entry.path.c_str(), -1, SQLITE_TRANSIENT);
+  sqlite3_bind_int64(stmt, column++, static_cast<sqlite3_int64>(entry.size));
+  sqlite3_bind_int64(stmt, column++, static_cast<sqlite3_int64>(entry.modified));
+  sqlite3_bind_text(stmt, column++, entry.type.c_str(), -1, SQLITE_TRANSIENT);
+
+  bindText("Manufacturer");
+  bindText("ManufacturersModelName");
+  bindText("StationName");
+  bindText("DeviceSerialNumber");
+
+  if (m.count("DeviceSerialNumber"))
+    bindText("DeviceSerialNumber");
+  else if (m.count("StationName"))
+    bindText("StationName");
+  else
+    bindText("ManufacturersModelName");
+
+  bindText("StudyDate");
+  bindText("StudyTime");
+  bindText("StudyInstanceUID");
+  bindText("SeriesInstanceUID");
+  bindText("SOPInstanceUID");
+  bindText("TracerRadionuclide");
+
+  const nlohmann::json none;
+  bindNumber(m.count("FrameDuration") && m["FrameDuration"].is_array() && !m["FrameDuration"].empty()
+             ? m["FrameDuration"][0] : none);
+  bindNumber(m.count("InterfileHorizontalBedPosition") ? m["InterfileHorizontalBedPosition"]
+             : m.count("TablePosition") ? m["TablePosition"] : none);
+
+  if (m.count("InterfileListmodeWordCount") && m["InterfileListmodeWordCount"].is_number_unsigned())
+    sqlite3_bind_int64(stmt, column++, static_cast<sqlite3_int64>(m["InterfileListmodeWordCount"].get<uint64_t>()));
+  else
+    sqlite3_bind_null(stmt, column++);
+
+  bindText("HeaderFile");
+  bindText("DataFile");
+
+  const std::string metadata = m.dump();
+  sqlite3_bind_text(stmt, column++, metadata.c_str(), -1, SQLITE_TRANSIENT);
+
+  const bool bStatus = sqlite3_step(stmt) == SQLITE_DONE;
+  if (!bStatus)
+    LOG(ERROR) << "Unable to record " << entry.path << ": " << sqlite3_errmsg(_db);
+
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+
+  return bStatus;
+}
+
+bool RawDataCatalogue::Index(const boost::filesystem::path &root){
+
+  namespace fs = boost::filesystem;
+
+  _numFilesRead = 0;
+  _numFilesRemoved = 0;
+
+  if (_db == nullptr) {
+    LOG(ERROR) << "Catalogue not open!";
+    return false;
+  }
+
+  if (!fs::is_directory(root)) {
+    LOG(ERROR) << root << " is not a directory!";
+    return false;
+  }
+
+  const std::string rootPath = fs::canonical(root).string();
+
+  //Directory prefix of everything under root (so /data does not take in
+  ///data2).
+  std::string prefix = rootPath;
+  if (prefix.empty() || prefix.back() != fs::path::preferred_separator)
+    prefix += fs::path::preferred_separator;
+
+  //What is already known under root: path -> (size, modified).
+  std::map< std::string, std::pair<uintmax_t, std::time_t> > known;
+  {
+    Statement select = Prepare("SELECT path, size, modified FROM files "
+                               "WHERE substr(path, 1, ?1) = ?2;");
+    if (!select)
+      return false;
+
+    sqlite3_bind_int(select.get(), 1, static_cast<int>(prefix.size()));
+    sqlite3_bind_text(select.get(), 2, prefix.c_str(), -1, SQLITE_TRANSIENT);
+
+    while (sqlite3_step(select.get()) == SQLITE_ROW) {
+      const std::string path = reinterpret_cast<const char*>(sqlite3_column_text(select.get(), 0));
+      known[path] = std::make_pair(static_cast<uintmax_t>(sqlite3_column_int64(select.get(), 1)),
+                                   static_cast<std::time_t>(sqlite3_column_int64(select.get(), 2)));
+    }
+  }
+
+  //Walk the tree, keeping unchanged files as they are.
+  std::vector<CatalogueEntry> toRead;
+
+  try {
+    for (fs::recursive_directory_iterator it(rootPath), end; it != end; ++it) {
+      if (!fs::is_regular_file(it->status()))
+        continue;
+
+      CatalogueEntry entry;
+      entry.path = it->path().string();
+      entry.size = fs::file_size(it->path());
+      entry.modified = fs::last_write_time(it->path());
+
+      auto k = known.find(entry.path);
+      if (k != known.end()) {
+        const bool unchanged = k->second.first == entry.size && k->second.second == entry.modified;
+        known.erase(k);
+        if (unchanged)
+          continue;
+      }
+
+      toRead.push_back(entry);
+    }
+  } catch (fs::filesystem_error &e) {
+    LOG(ERROR) << "Unable to list " << root << ": " << e.what();
+    return false;
+  }
+
+  std::unique_ptr<ThreadPool> localPool;
+  ThreadPool *pool = _pool;
+  if (pool == nullptr) {
+    localPool.reset(new ThreadPool);
+    pool = localPool.get();
+  }
+
+  Statement insert = Prepare("INSERT OR REPLACE INTO files VALUES "
+                             "(?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?);");
+  Statement remove = Prepare("DELETE FROM files WHERE path = ?;");
+  if (!insert || !remove)
+    return false;
+
+  //Headers are read in parallel a batch at a time; each batch is
+  //recorded in one transaction.
+  const std::size_t batchSize = 1024;
+
+  for (std::size_t first = 0; first < toRead.size(); first += batchSize) {
+
+    const std::size_t last = std::min(toRead.size(), first + batchSize);
+
+    std::vector< std::future<bool> > results;
+    for (std::size_t i = first; i < last; i++) {
+      CatalogueEntry *entry = &toRead[i];
+      results.push_back(pool->Submit([entry](){ return ReadCatalogueEntry(*entry); }));
+    }
+
+    //The reads write into toRead, so none may be left running on return.
+    auto waitForReads = [&](){
+      for (std::future<bool> &result : results)
+        if (result.valid())
+          result.wait();
+    };
+
+    if (!Exec("BEGIN;")) {
+      waitForReads();
+      return false;
+    }
+
+    for (std::size_t i = first; i < last; i++) {
+      bool bStatus = false;
+      try {
+        bStatus = results[i - first].get();
+      } catch (std::exception &e) {
+        LOG(WARNING) << "Unable to read " << toRead[i].path << ": " << e.what();
+      }
+
+      if (!bStatus)
+        toRead[i].type = "UNKNOWN";
+
+      if (!Insert(insert.get(), toRead[i])) {
+        waitForReads();
+        Exec("ROLLBACK;");
+        return false;
+      }
+
+      //Raw data headers are large; keep only what was recorded.
+      toRead[i].metadata = nlohmann::json();
+    }
+
+    if (!Exec("COMMIT;"))
+      return false;
+
+    _numFilesRead += last - first;
+    LOG(INFO) << "Indexed " << _numFilesRead << " of " << toRead.size() << " new or modified files";
+  }
+
+  //Files no longer there.
+  if (!known.empty()) {
+    if (!Exec("BEGIN;"))
+      return false;
+
+    std::size_t numRemoved = 0;
+
+    for (const auto &k : known) {
+      sqlite3_bind_text(remove.get(), 1, k.first.c_str(), -1, SQLITE_TRANSIENT);
+      const bool bStatus = sqlite3_step(remove.get()) == SQLITE_DONE;
+      sqlite3_reset(remove.get());
+
+      if (!bStatus) {
+        LOG(ERROR) << "Unable to drop " << k.first << ": " << sqlite3_errmsg(_db);
+        Exec("ROLLBACK;");
+        return false;
+      }
+
+      numRemoved += sqlite3_changes(_db);
+    }
+
+    if (!Exec("COMMIT;"))
+      return false;
+
+    _numFilesRemoved = numRemoved;
+  }
+
+  return true;
+}
+
+bool RawDataCatalogue::Find(const CatalogueQuery &query, std::vector<CatalogueRow> &rows){
+
+  rows.clear();
+
+  if (_db == nullptr) {
+    LOG(ERROR) << "Catalogue not open!";
+    return false;
+  }
+
+  //Empty parameters match everything. Outputs come from the sidecar of
+  //the same DICOM instance, if indexed. Files with no scanner or study
+  //date cannot be matched, so 'without' leaves them out.
+  Statement select = Prepare(
+    "SELECT f.path, f.type, f.scanner, f.study_date, f.study_time,"
+    "       s.header_file, s.data_file"
+    "  FROM files f"
+    "  LEFT JOIN files s ON s.type = 'SIDECAR' AND s.sop_uid = f.sop_uid"
+    " WHERE f.type NOT IN ('SIDECAR', 'NOT_DICOM')"
+    "   AND (?1 = '' OR f.type = ?1)"
+    "   AND (?2 = '' OR f.serial = ?2 OR f.station = ?2 OR f.model = ?2)"
+    "   AND (?3 = '' OR f.study_date >= ?3)"
+    "   AND (?4 = '' OR f.study_date <= ?4)"
+    "   AND (?5 = '' OR (f.scanner IS NOT NULL AND f.study_date IS NOT NULL"
+    "                    AND NOT EXISTS (SELECT 1 FROM files n"
+    "                                     WHERE n.type = ?5 AND n.scanner = f.scanner"
+    "                                       AND n.study_date = f.study_date)))"
+    " ORDER BY f.study_date, f.study_time, f.path;");
+
+  if (!select)
+    return false;
+
+  const std::string *params[] = { &query.type, &query.scanner, &query.from, &query.to, &query.without };
+  for (int i = 0; i < 5; i++)
+    sqlite3_bind_text(select.get(), i + 1, params[i]->c_str(), -1, SQLITE_TRANSIENT);
+
+  auto text = [&](int column){
+    const unsigned char *value = sqlite3_column_text(select.get(), column);
+    return value ? std::string(reinterpret_cast<const char*>(value)) : std::string();
+  };
+
+  int rc;
+  while ((rc = sqlite3_step(select.get())) == SQLITE_ROW) {
+    CatalogueRow row;
+    row.path = text(0);
+    row.type = text(1);
+    row.scanner = text(2);
+    row.studyDate = text(3);
+    row.studyTime = text(4);
+    row.headerFile = text(5);
+    row.dataFile = text(6);
+    rows.push_back(row);
+  }
+
+  if (rc != SQLITE_DONE) {
+    LOG(ERROR) << "SQLite: " << sqlite3_errmsg(_db);
+    return false;
+  }
+
+  return true;
+}
+
+bool RawDataCatalogue::Execute(const std::string &sql, std::ostream &out){
+
+  if (_db == nullptr) {
+    LOG(ERROR) << "Catalogue not open!";
+    return false;
+  }
+
+  Statement stmt = Prepare(sql);
+  if (!stmt)
+    return false;
+
+  const int numColumns = sqlite3_column_count(stmt.get());
+
+  for (int c = 0; c < numColumns; c++)
+    out << (c ? "\t" : "") << sqlite3_column_name(stmt.get(), c);
+  if (numColumns > 0)
+    out << std::endl;
+
+  int rc;
+  while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+    for (int c = 0; c < numColumns; c++) {
+      const unsigned char *value = sqlite3_column_text(stmt.get(), c);
+      out << (c ? "\t" : "") << (value ? reinterpret_cast<const char*>(value) : "");
+    }
+    out << std::endl;
+  }
+
+  if (rc != SQLITE_DONE) {
+    LOG(ERROR) << "SQLite: " << sqlite3_errmsg(_db);
+    return false;
+  }
+
+  return true;
+}
+
+} //namespace nmtools
+
+#endif
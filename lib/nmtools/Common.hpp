@@ -26,9 +26,13 @@
 
 #include <itkImage.h>
 #include <gdcmStringFilter.h>
+#include <cctype>
 #include <exception>
+#include <set>
 #include <sstream>
 
+#include "json/json.hpp"
+
 namespace nmtools {
 
 #ifdef __APPLE__
@@ -93,6 +97,126 @@ bool GetTagInfo(const gdcm::File &file, const gdcm::Tag tag, std::string &dst){
   return true;
 }
 
+//Like GetTagInfo() but quiet: false if the tag is absent or empty.
+//DICOM padding (trailing spaces and NULs) is removed.
+bool GetOptionalTagInfo(const gdcm::File &file, const gdcm::Tag tag, std::string &dst){
+
+  dst.clear();
+
+  const gdcm::DataSet &ds = file.GetDataSet();
+  if (!ds.FindDataElement(tag) || ds.GetDataElement(tag).GetByteValue() == NULL)
+    return false;
+
+  gdcm::StringFilter sf;
+  sf.SetFile(file);
+  dst = sf.ToString(tag);
+
+  const std::string::size_type end = dst.find_last_not_of(std::string(" \0", 2));
+  dst.erase(end == std::string::npos ? 0 : end + 1);
+
+  return !dst.empty();
+}
+
+//DICOM 'YYYYMMDD' as 'YYYY-MM-DD'; anything else is returned unchanged.
+std::string FormatDicomDate(const std::string &date){
+
+  if (date.size() != 8 || date.find_first_not_of("0123456789") != std::string::npos)
+    return date;
+
+  return date.substr(0, 4) + "-" + date.substr(4, 2) + "-" + date.substr(6, 2);
+}
+
+//DICOM 'HHMMSS[.FFFFFF]' as 'HH:MM:SS'; anything else is returned unchanged.
+std::string FormatDicomTime(const std::string &time){
+
+  if (time.size() < 6 || time.find_first_not_of("0123456789") < 6)
+    return time;
+
+  return time.substr(0, 2) + ":" + time.substr(2, 2) + ":" + time.substr(4, 2);
+}
+
+//Radionuclide as BIDS-PET writes it, element then mass number: 'F-18',
+//'f18' and '18F' are all 'F18', 'Ga-68' is 'Ga68'. Names that are not
+//of this form are returned unchanged.
+std::string FormatRadionuclide(const std::string &name){
+
+  std::string compact;
+  for (char c : name) {
+    const unsigned char u = static_cast<unsigned char>(c);
+    if (c == '-' || c == '_' || std::isspace(u))
+      continue;
+    if (!std::isalnum(u))
+      return name;
+    compact += c;
+  }
+
+  //Mass number first ('18F'): move it after the element.
+  std::size_t digits = 0;
+  while (digits < compact.size() && std::isdigit(static_cast<unsigned char>(compact[digits])))
+    digits++;
+  compact = compact.substr(digits) + compact.substr(0, digits);
+
+  //One or two letters, the mass number and perhaps 'm' (metastable).
+  std::size_t letters = 0;
+  while (letters < compact.size() && std::isalpha(static_cast<unsigned char>(compact[letters])))
+    letters++;
+  std::size_t end = letters;
+  while (end < compact.size() && std::isdigit(static_cast<unsigned char>(compact[end])))
+    end++;
+
+  const std::string suffix = compact.substr(end);
+  if (letters == 0 || letters > 2 || end == letters || !(suffix.empty() || suffix == "m" || suffix == "M"))
+    return name;
+
+  std::string formatted(1, static_cast<char>(std::toupper(static_cast<unsigned char>(compact[0]))));
+  if (letters == 2)
+    formatted += static_cast<char>(std::tolower(static_cast<unsigned char>(compact[1])));
+
+  return formatted + compact.substr(letters, end - letters) + (suffix.empty() ? "" : "m");
+}
+
+//Scanner, study and series fields common to all raw data, named as in
+//BIDS-PET where BIDS has a name for them and by their DICOM keyword
+//otherwise.
+void GetDicomMetadata( const gdcm::File &file, nlohmann::json &metadata ){
+
+  struct Field {
+    uint16_t group;
+    uint16_t element;
+    const char *name;
+  };
+
+  const Field fields[] = {
+    { 0x0008, 0x0060, "Modality" },
+    { 0x0008, 0x0070, "Manufacturer" },
+    { 0x0008, 0x1090, "ManufacturersModelName" },
+    { 0x0018, 0x1000, "DeviceSerialNumber" },
+    { 0x0008, 0x1010, "StationName" },
+    { 0x0018, 0x1020, "SoftwareVersions" },
+    { 0x0008, 0x0080, "InstitutionName" },
+    { 0x0008, 0x103E, "SeriesDescription" },
+    { 0x0020, 0x000D, "StudyInstanceUID" },
+    { 0x0020, 0x000E, "SeriesInstanceUID" },
+    { 0x0008, 0x0018, "SOPInstanceUID" },
+  };
+
+  std::string value;
+
+  for (const Field &f : fields) {
+    if (GetOptionalTagInfo(file, gdcm::Tag(f.group, f.element), value))
+      metadata[f.name] = value;
+  }
+
+  if (GetOptionalTagInfo(file, gdcm::Tag(0x0008, 0x0020), value))
+    metadata["StudyDate"] = FormatDicomDate(value);
+  if (GetOptionalTagInfo(file, gdcm::Tag(0x0008, 0x0030), value))
+    metadata["StudyTime"] = FormatDicomTime(value);
+  if (GetOptionalTagInfo(file, gdcm::Tag(0x0008, 0x0022), value))
+    metadata["AcquisitionDate"] = FormatDicomDate(value);
+  if (GetOptionalTagInfo(file, gdcm::Tag(0x0008, 0x0032), value))
+    metadata["AcquisitionTime"] = FormatDicomTime(value);
+}
+
 class IDicomExtractor {
 
 //Base class for extracting headers etc from a (probably DICOM) file
@@ -109,8 +233,15 @@ public:
   virtual bool ExtractHeader( const boost::filesystem::path dst ) = 0;
   virtual bool ExtractData( const boost::filesystem::path dst ) = 0;
   virtual boost::filesystem::path GetStdFileName( boost::filesystem::path srcFile, ContentType ctype) = 0;
+  //Data file for ExtractHeader() to reference, set beforehand.
+  virtual bool SetDataFileName( const boost::filesystem::path dataFile) = 0;
   virtual bool ModifyHeader( const boost::filesystem::path src, const boost::filesystem::path dataFile) = 0;
 
+  //Study and scanner information for a JSON sidecar, named as in BIDS-PET
+  //where BIDS has a name for it (see GetDicomMetadata() and
+  //GetSiemensInterfileMetadata()). Fields that are absent are left out.
+  virtual bool GetMetadata( nlohmann::json &metadata );
+
   virtual ~IDicomExtractor(){};
 
 protected:
@@ -153,6 +284,20 @@ bool IDicomExtractor::SetInputFile(boost::filesystem::path src){
     return true;
 }
 
+//DICOM fields common to all raw data.
+bool IDicomExtractor::GetMetadata( nlohmann::json &metadata ){
+
+  if (!_dicomReader) {
+    LOG(ERROR) << "DICOM reader not initialised. Internal error.";
+    return false;
+  }
+
+  GetDicomMetadata(_dicomReader->GetFile(), metadata);
+  metadata["SourceFile"] = _srcPath.filename().string();
+
+  return true;
+}
+
 class IRawDataFactory {
 //Factory that returns suitable child for given data.
 
@@ -161,27 +306,51 @@ public:
   {
     return std::unique_ptr<IDicomExtractor>(Create_ptr( inFile ));
   }
+
+  //Read the DICOM header of inFile: everything up to the pixel data,
+  //without the values of the pixel data or of GE's (RDF) or Siemens'
+  //raw data elements, which can be gigabytes. This holds all the tags
+  //used to classify files.
+  static bool ReadHeaderOnly(gdcm::Reader &reader, const boost::filesystem::path &inFile);
+
 protected:
   std::unique_ptr<gdcm::Reader> dicomReader;
   std::string manufacturerName;
   std::string modelName;
 
   bool Open(boost::filesystem::path inFile);
+  bool ReadScannerNames(const gdcm::File &file);
   virtual IDicomExtractor* Create_ptr( boost::filesystem::path inFile ) = 0;
 };
 
+bool IRawDataFactory::ReadHeaderOnly(gdcm::Reader &reader, const boost::filesystem::path &inFile){
+
+  //GDCM stops at the first element at or after the pixel data, reading
+  //its value unless it is skipped: the pixel data or, in files without
+  //any, the Siemens raw data that follow.
+  static const std::set<gdcm::Tag> skipTags = {
+    gdcm::Tag(0x0023, 0x1002),  //GE raw data
+    gdcm::Tag(0x7fe0, 0x0010),  //Pixel data
+    gdcm::Tag(0x7fe1, 0x1010)   //Siemens raw data
+  };
+
+  reader.SetFileName(inFile.string().c_str());
+
+  return reader.ReadUpToTag(gdcm::Tag(0x7fe0, 0x0010), skipTags);
+}
+
 bool IRawDataFactory::Open(boost::filesystem::path inFile) {
   dicomReader = std::unique_ptr<gdcm::Reader>(new gdcm::Reader);
-  dicomReader->SetFileName(inFile.string().c_str());
 
-  if (!dicomReader->Read()) {
+  if (!ReadHeaderOnly(*dicomReader, inFile)) {
     LOG(ERROR) << "Unable to read '" << inFile.string() << "' as DICOM file";
     return false;
   }
 
-  //Get dataset via GDCM
-  const gdcm::File &file = dicomReader->GetFile();
-  //const gdcm::DataSet &ds = dicomReader->GetFile().GetDataSet();
+  return ReadScannerNames(dicomReader->GetFile());
+}
+
+bool IRawDataFactory::ReadScannerNames(const gdcm::File &file) {
 
   //Read manufacturer name.
   const gdcm::Tag manufacturer(0x008, 0x0070);
@@ -0,0 +1,385 @@
+/*
+   DicomScanner.hpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Finding DICOM image series in a directory from a minimal header scan.
+ */
+
+#ifndef DICOMSCANNER_HPP
+#define DICOMSCANNER_HPP
+
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <glog/logging.h>
+
+#include "DicomSeries.hpp"
+#include "Parallel.hpp"
+#include "json/json.hpp"
+
+namespace nmtools {
+
+//Groups the slice files of a directory into series, as
+//itk::GDCMSeriesFileNames does with the series date and image orientation
+//restrictions, but reading only the tags used for grouping and sorting.
+//Files are scanned in parallel. If a cache directory is set, the scan of
+//each directory is stored there and only new or modified files (by size
+//and modification time) are re-read on the next scan.
+class DicomSeriesScanner {
+
+public:
+
+  void SetDirectory(const boost::filesystem::path &dir){ _directory = dir; };
+
+  //Store/reuse scan results in this directory. Off by default.
+  void SetCacheDirectory(const boost::filesystem::path &dir){ _cacheDirectory = dir; };
+
+  //Use an existing pool rather than creating one per scan.
+  void SetThreadPool(ThreadPool *pool){ _pool = pool; };
+
+  bool Update();
+
+  //Series identifiers (see GetSeriesIdentifier()), sorted as strings.
+  std::vector<std::string> GetSeriesIdentifiers() const;
+
+  //Slices of a series, sorted along the slice normal.
+  const std::vector<DicomSliceInfo>& GetSlices(const std::string &seriesId) const;
+
+  //Number of files whose headers were read (not taken from the cache).
+  std::size_t GetNumberOfFilesRead() const { return _numFilesRead; };
+
+protected:
+
+  //What is known about one file in the directory.
+  struct FileEntry {
+    uintmax_t size = 0;
+    std::time_t modified = 0;
+    bool valid = false;  //an image slice with position/orientation
+    DicomSliceInfo slice;
+  };
+
+  typedef std::map<std::string, FileEntry> FileEntryMap;
+
+  boost::filesystem::path GetCacheFile() const;
+  bool ReadCache(FileEntryMap &entries) const;
+  bool WriteCache(const FileEntryMap &entries) const;
+
+  static std::string GetSeriesIdentifier(const DicomSliceInfo &slice);
+
+  boost::filesystem::path _directory;
+  boost::filesystem::path _cacheDirectory;
+
+  ThreadPool *_pool = nullptr;
+
+  std::map<std::string, std::vector<DicomSliceInfo> > _series;
+  std::size_t _numFilesRead = 0;
+
+};
+
+//Series UID with the series date and orientation appended, so that
+//slices of one UID acquired on different dates or planes are kept apart.
+std::string DicomSeriesScanner::GetSeriesIdentifier(const DicomSliceInfo &slice){
+
+  std::stringstream ss;
+  ss << slice.seriesUID << "." << slice.seriesDate;
+
+  ss << std::fixed << std::setprecision(6);
+  for (unsigned int i = 0; i < 6; i++)
+    ss << "\\" << slice.orientation[i];
+
+  return ss.str();
+}
+
+//Cache file name from a (stable) FNV-1a hash of the directory path.
+boost::filesystem::path DicomSeriesScanner::GetCacheFile() const {
+
+  const std::string dir = boost::filesystem::absolute(_directory).string();
+
+  uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char c : dir) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+
+  std::stringstream ss;
+  ss << "series-" << std::hex << std::setw(16) << std::setfill('0') << hash << ".json";
+
+  return _cacheDirectory / ss.str();
+}
+
+//Load a previous scan of _directory. Returns false if there is none.
+bool DicomSeriesScanner::ReadCache(FileEntryMap &entries) const {
+
+  const boost::filesystem::path cacheFile = GetCacheFile();
+
+  if (!boost::filesystem::exists(cacheFile))
+    return false;
+
+  try {
+    std::ifstream in(cacheFile.string());
+    nlohmann::json cache;
+    in >> cache;
+
+    if (cache.at("directory").get<std::string>() != boost::filesystem::absolute(_directory).string())
+      return false;
+
+    for (const nlohmann::json &f : cache.at("files")) {
+      FileEntry entry;
+      entry.size = f.at("size").get<uintmax_t>();
+      entry.modified = f.at("modified").get<std::time_t>();
+      entry.valid = f.at("valid").get<bool>();
+
+      DicomSliceInfo &slice = entry.slice;
+      slice.fileName = f.at("name").get<std::string>();
+
+      if (entry.valid) {
+        slice.seriesUID = f.at("seriesUID").get<std::string>();
+        slice.seriesDate = f.at("seriesDate").get<std::string>();
+        slice.seriesDescription = f.value("seriesDescription", std::string());
+        slice.seriesNumber = f.value("seriesNumber", 0);
+        for (unsigned int i = 0; i < 3; i++)
+          slice.position[i] = f.at("position").at(i).get<double>();
+        for (unsigned int i = 0; i < 6; i++)
+          slice.orientation[i] = f.at("orientation").at(i).get<double>();
+        for (unsigned int i = 0; i < 2; i++)
+          slice.spacing[i] = f.at("spacing").at(i).get<double>();
+        slice.rows = f.at("rows").get<unsigned int>();
+        slice.columns = f.at("columns").get<unsigned int>();
+        slice.bitsAllocated = f.value("bitsAllocated", 0u);
+        slice.bitsStored = f.value("bitsStored", 0u);
+        slice.pixelRepresentation = f.value("pixelRepresentation", 0u);
+        slice.rescaleIntercept = f.value("rescaleIntercept", 0.0);
+        slice.rescaleSlope = f.value("rescaleSlope", 1.0);
+        slice.location = f.at("location").get<double>();
+      }
+
+      entries[slice.fileName] = entry;
+    }
+  } catch (std::exception &e) {
+    LOG(WARNING) << "Ignoring unreadable series cache " << cacheFile;
+    entries.clear();
+    return false;
+  }
+
+  DLOG(INFO) << "Read series cache " << cacheFile;
+
+  return true;
+}
+
+//Store the scan of _directory.
+bool DicomSeriesScanner::WriteCache(const FileEntryMap &entries) const {
+
+  nlohmann::json files = nlohmann::json::array();
+
+  for (const auto &e : entries) {
+    const FileEntry &entry = e.second;
+    const DicomSliceInfo &slice = entry.slice;
+
+    nlohmann::json f;
+    f["name"] = e.first;
+    f["size"] = entry.size;
+    f["modified"] = entry.modified;
+    f["valid"] = entry.valid;
+
+    if (entry.valid) {
+      f["seriesUID"] = slice.seriesUID;
+      f["seriesDate"] = slice.seriesDate;
+      f["seriesDescription"] = slice.seriesDescription;
+      f["seriesNumber"] = slice.seriesNumber;
+      f["position"] = std::vector<double>(slice.position, slice.position + 3);
+      f["orientation"] = std::vector<double>(slice.orientation, slice.orientation + 6);
+      f["spacing"] = std::vector<double>(slice.spacing, slice.spacing + 2);
+      f["rows"] = slice.rows;
+      f["columns"] = slice.columns;
+      f["bitsAllocated"] = slice.bitsAllocated;
+      f["bitsStored"] = slice.bitsStored;
+      f["pixelRepresentation"] = slice.pixelRepresentation;
+      f["rescaleIntercept"] = slice.rescaleIntercept;
+      f["rescaleSlope"] = slice.rescaleSlope;
+      f["location"] = slice.location;
+    }
+
+    files.push_back(f);
+  }
+
+  nlohmann::json cache;
+  cache["directory"] = boost::filesystem::absolute(_directory).string();
+  cache["files"] = files;
+
+  const boost::filesystem::path cacheFile = GetCacheFile();
+
+  try {
+    boost::filesystem::create_directories(_cacheDirectory);
+
+    //Write to a temporary file first so concurrent readers never see a
+    //partial cache.
+    boost::filesystem::path tmpFile = cacheFile;
+    tmpFile += boost::filesystem::unique_path(".%%%%%%%%");
+
+    std::ofstream out(tmpFile.string());
+    out << cache;
+    out.close();
+
+    if (!out) {
+      boost::filesystem::remove(tmpFile);
+      LOG(WARNING) << "Unable to write series cache " << cacheFile;
+      return false;
+    }
+
+    boost::filesystem::rename(tmpFile, cacheFile);
+  } catch (boost::filesystem::filesystem_error &e) {
+    LOG(WARNING) << "Unable to write series cache " << cacheFile << ": " << e.what();
+    return false;
+  }
+
+  DLOG(INFO) << "Wrote series cache " << cacheFile;
+
+  return true;
+}
+
+//Scan the directory (not recursively) and group slices into series.
+bool DicomSeriesScanner::Update(){
+
+  namespace fs = boost::filesystem;
+
+  _series.clear();
+  _numFilesRead = 0;
+
+  if (!fs::is_directory(_directory)) {
+    LOG(ERROR) << _directory << " is not a directory!";
+    return false;
+  }
+
+  FileEntryMap cached;
+  const bool useCache = !_cacheDirectory.empty();
+
+  if (useCache)
+    ReadCache(cached);
+
+  //List files, taking unchanged ones from the cache.
+  FileEntryMap entries;
+  std::vector<std::string> toRead;
+
+  try {
+    for (fs::directory_iterator it(_directory), end; it != end; ++it) {
+      if (!fs::is_regular_file(it->status()))
+        continue;
+
+      const std::string fileName = it->path().string();
+
+      FileEntry entry;
+      entry.size = fs::file_size(it->path());
+      entry.modified = fs::last_write_time(it->path());
+      entry.slice.fileName = fileName;
+
+      FileEntryMap::const_iterator c = cached.find(fileName);
+      if (c != cached.end() && c->second.size == entry.size &&
+          c->second.modified == entry.modified) {
+        entry = c->second;
+      }
+      else {
+        toRead.push_back(fileName);
+      }
+
+      entries[fileName] = entry;
+    }
+  } catch (fs::filesystem_error &e) {
+    LOG(ERROR) << "Unable to list " << _directory << ": " << e.what();
+    return false;
+  }
+
+  //Read the headers of new or modified files in parallel.
+  if (!toRead.empty()) {
+
+    std::unique_ptr<ThreadPool> localPool;
+    ThreadPool *pool = _pool;
+    if (pool == nullptr) {
+      localPool.reset(new ThreadPool);
+      pool = localPool.get();
+    }
+
+    std::vector<DicomSliceInfo> slices(toRead.size());
+    std::vector< std::future<bool> > results;
+
+    for (std::size_t i = 0; i < toRead.size(); i++) {
+      results.push_back(pool->Submit([&toRead, &slices, i](){
+        return ReadSliceInfo(toRead[i], slices[i]);
+      }));
+    }
+
+    for (std::size_t i = 0; i < toRead.size(); i++) {
+      FileEntry &entry = entries[toRead[i]];
+      try {
+        entry.valid = results[i].get();
+      } catch (std::exception &e) {
+        entry.valid = false;
+      }
+
+      if (entry.valid)
+        entry.slice = slices[i];
+      else
+        DLOG(INFO) << "Skipping " << toRead[i];
+    }
+
+    _numFilesRead = toRead.size();
+  }
+
+  DLOG(INFO) << "Scanned " << entries.size() << " files, " << _numFilesRead << " read";
+
+  if (useCache && (_numFilesRead > 0 || entries.size() != cached.size()))
+    WriteCache(entries);
+
+  for (const auto &e : entries) {
+    if (e.second.valid)
+      _series[GetSeriesIdentifier(e.second.slice)].push_back(e.second.slice);
+  }
+
+  for (auto &s : _series)
+    SortSlices(s.second);
+
+  return true;
+}
+
+std::vector<std::string> DicomSeriesScanner::GetSeriesIdentifiers() const {
+
+  std::vector<std::string> ids;
+  for (const auto &s : _series)
+    ids.push_back(s.first);
+
+  return ids;
+}
+
+const std::vector<DicomSliceInfo>& DicomSeriesScanner::GetSlices(const std::string &seriesId) const {
+
+  static const std::vector<DicomSliceInfo> empty;
+
+  std::map<std::string, std::vector<DicomSliceInfo> >::const_iterator s = _series.find(seriesId);
+  if (s == _series.end())
+    return empty;
+
+  return s->second;
+}
+
+} //namespace nmtools
+
+#endif
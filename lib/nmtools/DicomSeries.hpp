@@ -0,0 +1,535 @@
+/*
+   DicomSeries.hpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Reading DICOM image series into volumes, one slice file per thread.
+ */
+
+#ifndef DICOMSERIES_HPP
+#define DICOMSERIES_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <itkImage.h>
+#include <gdcmAttribute.h>
+#include <gdcmImageReader.h>
+#include <gdcmReader.h>
+#include <glog/logging.h>
+
+#include "Parallel.hpp"
+
+namespace nmtools {
+
+//Geometry of one slice file, read from its header.
+struct DicomSliceInfo {
+  std::string fileName;
+  std::string seriesUID;   //(0020,000E)
+  std::string seriesDate;  //(0008,0021)
+  std::string seriesDescription;  //(0008,103E)
+  int seriesNumber = 0;           //(0020,0011)
+  double position[3] = {0.0, 0.0, 0.0};                    //(0020,0032)
+  double orientation[6] = {1.0, 0.0, 0.0, 0.0, 1.0, 0.0};  //(0020,0037)
+  double spacing[2] = {1.0, 1.0};  //x,y from (0028,0030)
+  unsigned int columns = 0;        //(0028,0011)
+  unsigned int rows = 0;           //(0028,0010)
+  unsigned int bitsAllocated = 0;        //(0028,0100)
+  unsigned int bitsStored = 0;           //(0028,0101)
+  unsigned int pixelRepresentation = 0;  //(0028,0103), 1 = signed
+  double rescaleIntercept = 0.0;         //(0028,1052)
+  double rescaleSlope = 1.0;             //(0028,1053)
+  double location = 0.0;  //position along the slice normal
+};
+
+//Slice normal from the row and column direction cosines.
+void GetSliceNormal(const double orientation[6], double normal[3]){
+  normal[0] = orientation[1] * orientation[5] - orientation[2] * orientation[4];
+  normal[1] = orientation[2] * orientation[3] - orientation[0] * orientation[5];
+  normal[2] = orientation[0] * orientation[4] - orientation[1] * orientation[3];
+}
+
+//Value of a string element with trailing padding removed ("" if absent).
+std::string GetStringValue(const gdcm::DataSet &ds, const gdcm::Tag &tag){
+
+  if (!ds.FindDataElement(tag))
+    return "";
+
+  const gdcm::ByteValue *bv = ds.GetDataElement(tag).GetByteValue();
+  if (bv == nullptr)
+    return "";
+
+  std::string value(bv->GetPointer(), bv->GetLength());
+  value.erase(value.find_last_not_of(std::string(" \0", 2)) + 1);
+
+  return value;
+}
+
+//Read the series, geometry and matrix tags of a slice. Only the tags
+//needed for grouping and sorting are parsed; the rest of the file
+//(including pixel data) is never read. Returns false, without logging,
+//for files that are not image slices.
+bool ReadSliceInfo(const std::string &fileName, DicomSliceInfo &info){
+
+  static const std::set<gdcm::Tag> selectedTags = {
+    gdcm::Tag(0x0008, 0x0021),  //Series date
+    gdcm::Tag(0x0008, 0x103e),  //Series description
+    gdcm::Tag(0x0020, 0x000e),  //Series instance UID
+    gdcm::Tag(0x0020, 0x0011),  //Series number
+    gdcm::Tag(0x0020, 0x0032),  //Image position (patient)
+    gdcm::Tag(0x0020, 0x0037),  //Image orientation (patient)
+    gdcm::Tag(0x0028, 0x0010),  //Rows
+    gdcm::Tag(0x0028, 0x0011),  //Columns
+    gdcm::Tag(0x0028, 0x0030),  //Pixel spacing
+    gdcm::Tag(0x0028, 0x0100),  //Bits allocated
+    gdcm::Tag(0x0028, 0x0101),  //Bits stored
+    gdcm::Tag(0x0028, 0x0103),  //Pixel representation
+    gdcm::Tag(0x0028, 0x1052),  //Rescale intercept
+    gdcm::Tag(0x0028, 0x1053)   //Rescale slope
+  };
+
+  gdcm::Reader reader;
+  reader.SetFileName(fileName.c_str());
+
+  if (!reader.ReadSelectedTags(selectedTags))
+    return false;
+
+  const gdcm::DataSet &ds = reader.GetFile().GetDataSet();
+
+  if (!ds.FindDataElement(gdcm::Tag(0x0020, 0x0032)) ||
+      !ds.FindDataElement(gdcm::Tag(0x0020, 0x0037)))
+    return false;
+
+  info.seriesUID = GetStringValue(ds, gdcm::Tag(0x0020, 0x000e));
+  info.seriesDate = GetStringValue(ds, gdcm::Tag(0x0008, 0x0021));
+  info.seriesDescription = GetStringValue(ds, gdcm::Tag(0x0008, 0x103e));
+  info.seriesNumber = std::atoi(GetStringValue(ds, gdcm::Tag(0x0020, 0x0011)).c_str());
+
+  gdcm::Attribute<0x0020, 0x0032> ipp;
+  ipp.Set(ds);
+  gdcm::Attribute<0x0020, 0x0037> iop;
+  iop.Set(ds);
+  gdcm::Attribute<0x0028, 0x0010> rows;
+  rows.Set(ds);
+  gdcm::Attribute<0x0028, 0x0011> columns;
+  columns.Set(ds);
+
+  info.fileName = fileName;
+  for (unsigned int i = 0; i < 3; i++)
+    info.position[i] = ipp[i];
+  for (unsigned int i = 0; i < 6; i++)
+    info.orientation[i] = iop[i];
+
+  info.rows = rows.GetValue();
+  info.columns = columns.GetValue();
+
+  gdcm::Attribute<0x0028, 0x0100> bitsAllocated;
+  bitsAllocated.Set(ds);
+  gdcm::Attribute<0x0028, 0x0101> bitsStored;
+  bitsStored.Set(ds);
+  gdcm::Attribute<0x0028, 0x0103> pixelRepresentation;
+  pixelRepresentation.Set(ds);
+
+  info.bitsAllocated = bitsAllocated.GetValue();
+  info.bitsStored = bitsStored.GetValue();
+  info.pixelRepresentation = pixelRepresentation.GetValue();
+
+  const std::string intercept = GetStringValue(ds, gdcm::Tag(0x0028, 0x1052));
+  const std::string slope = GetStringValue(ds, gdcm::Tag(0x0028, 0x1053));
+  info.rescaleIntercept = intercept.empty() ? 0.0 : std::atof(intercept.c_str());
+  info.rescaleSlope = slope.empty() ? 1.0 : std::atof(slope.c_str());
+
+  //Pixel spacing is stored as row spacing (y), column spacing (x).
+  if (ds.FindDataElement(gdcm::Tag(0x0028, 0x0030))) {
+    gdcm::Attribute<0x0028, 0x0030> pixelSpacing;
+    pixelSpacing.Set(ds);
+    info.spacing[0] = pixelSpacing[1];
+    info.spacing[1] = pixelSpacing[0];
+  }
+
+  double normal[3];
+  GetSliceNormal(info.orientation, normal);
+  info.location = info.position[0] * normal[0] + info.position[1] * normal[1] +
+                  info.position[2] * normal[2];
+
+  return true;
+}
+
+//Order slices by position along the slice normal (ascending).
+void SortSlices(std::vector<DicomSliceInfo> &slices){
+  std::stable_sort(slices.begin(), slices.end(),
+    [](const DicomSliceInfo &a, const DicomSliceInfo &b){ return a.location < b.location; });
+}
+
+//True if every slice holds integers (after rescaling) that fit in a
+//signed 16-bit pixel, so the series can be loaded without going to float.
+//Unsigned data must have at most 15 bits stored (max 32767). Without
+//Bits Stored, Bits Allocated is used.
+bool FitsInt16(const std::vector<DicomSliceInfo> &slices){
+
+  if (slices.empty())
+    return false;
+
+  for (const DicomSliceInfo &slice : slices) {
+    if (slice.rescaleSlope != 1.0 || slice.rescaleIntercept != 0.0)
+      return false;
+    if (slice.bitsAllocated == 0 || slice.bitsAllocated > 16)
+      return false;
+
+    const unsigned int bits = slice.bitsStored > 0 ? slice.bitsStored : slice.bitsAllocated;
+    if (bits > 16 || (slice.pixelRepresentation == 0 && bits > 15))
+      return false;
+  }
+
+  return true;
+}
+
+//value with only its low bitsStored bits kept (sign-extended for
+//signed types). Anything above them (e.g. overlays) is dropped.
+template <typename TSource>
+typename std::enable_if<std::is_integral<TSource>::value, TSource>::type
+MaskStoredBits(TSource value, unsigned int bitsStored){
+
+  const uint32_t mask = (1u << bitsStored) - 1;
+  uint32_t v = static_cast<uint32_t>(value) & mask;
+
+  if (std::is_signed<TSource>::value && (v & (1u << (bitsStored - 1))))
+    v |= ~mask;
+
+  return static_cast<TSource>(v);
+}
+
+template <typename TSource>
+typename std::enable_if<!std::is_integral<TSource>::value, TSource>::type
+MaskStoredBits(TSource value, unsigned int){
+  return value;
+}
+
+//dst[i] = src[i] * slope + intercept, with integer source values
+//masked to bitsStored bits (if fewer than the type holds).
+template <typename TSource, typename TPixel>
+void ConvertSlice(const char *src, TPixel *dst, std::size_t numPixels,
+                  double slope, double intercept, unsigned int bitsStored){
+
+  const TSource *in = reinterpret_cast<const TSource*>(src);
+
+  const bool mask = std::is_integral<TSource>::value &&
+                    bitsStored > 0 && bitsStored < 8 * sizeof(TSource);
+
+  if (mask) {
+    for (std::size_t i = 0; i < numPixels; i++)
+      dst[i] = static_cast<TPixel>(MaskStoredBits(in[i], bitsStored) * slope + intercept);
+  }
+  else if (slope == 1.0 && intercept == 0.0) {
+    for (std::size_t i = 0; i < numPixels; i++)
+      dst[i] = static_cast<TPixel>(in[i]);
+  }
+  else {
+    for (std::size_t i = 0; i < numPixels; i++)
+      dst[i] = static_cast<TPixel>(in[i] * slope + intercept);
+  }
+}
+
+//Decode the pixel data of one slice file into dst (numPixels voxels),
+//applying rescale slope/intercept. scratch holds the decoded bytes; pass
+//the same one for each slice so it is allocated only once.
+template <typename TPixel>
+bool DecodeSlice(const std::string &fileName, TPixel *dst, std::size_t numPixels,
+                 std::vector<char> &scratch){
+
+  gdcm::ImageReader reader;
+  reader.SetFileName(fileName.c_str());
+
+  if (!reader.Read()) {
+    LOG(ERROR) << "Unable to read DICOM image " << fileName;
+    return false;
+  }
+
+  const gdcm::Image &image = reader.GetImage();
+  const gdcm::PixelFormat &pf = image.GetPixelFormat();
+
+  if (pf.GetSamplesPerPixel() != 1) {
+    LOG(ERROR) << "Only single-channel images are supported: " << fileName;
+    return false;
+  }
+
+  if (static_cast<std::size_t>(image.GetDimension(0)) * image.GetDimension(1) != numPixels) {
+    LOG(ERROR) << "Slice size mismatch in " << fileName;
+    return false;
+  }
+
+  scratch.resize(image.GetBufferLength());
+  if (!image.GetBuffer(scratch.data())) {
+    LOG(ERROR) << "Unable to decode pixel data in " << fileName;
+    return false;
+  }
+
+  const double slope = image.GetSlope();
+  const double intercept = image.GetIntercept();
+
+  const unsigned int bitsStored = pf.GetBitsStored();
+
+  const char *src = scratch.data();
+
+  switch (pf.GetScalarType()) {
+    case gdcm::PixelFormat::UINT8:
+      ConvertSlice<uint8_t>(src, dst, numPixels, slope, intercept, bitsStored); break;
+    case gdcm::PixelFormat::INT8:
+      ConvertSlice<int8_t>(src, dst, numPixels, slope, intercept, bitsStored); break;
+    case gdcm::PixelFormat::UINT12:
+    case gdcm::PixelFormat::UINT16:
+      ConvertSlice<uint16_t>(src, dst, numPixels, slope, intercept, bitsStored); break;
+    case gdcm::PixelFormat::INT12:
+    case gdcm::PixelFormat::INT16:
+      ConvertSlice<int16_t>(src, dst, numPixels, slope, intercept, bitsStored); break;
+    case gdcm::PixelFormat::UINT32:
+      ConvertSlice<uint32_t>(src, dst, numPixels, slope, intercept, bitsStored); break;
+    case gdcm::PixelFormat::INT32:
+      ConvertSlice<int32_t>(src, dst, numPixels, slope, intercept, bitsStored); break;
+    case gdcm::PixelFormat::FLOAT32:
+      ConvertSlice<float>(src, dst, numPixels, slope, intercept, bitsStored); break;
+    case gdcm::PixelFormat::FLOAT64:
+      ConvertSlice<double>(src, dst, numPixels, slope, intercept, bitsStored); break;
+    default:
+      LOG(ERROR) << "Unsupported pixel format in " << fileName;
+      return false;
+  }
+
+  return true;
+}
+
+//Set image's region, spacing, origin and direction to those of the
+//volume made of slices (sorted with SortSlices()), without allocating
+//or decoding anything. Geometry follows itk::ImageSeriesReader: origin
+//at the first slice, z spacing from the first and last slice positions.
+template <class TImage>
+bool SetSeriesGeometry(const std::vector<DicomSliceInfo> &slices, TImage *image){
+
+  if (slices.empty()) {
+    LOG(ERROR) << "No slices in series!";
+    return false;
+  }
+
+  const DicomSliceInfo &s0 = slices.front();
+  const DicomSliceInfo &sN = slices.back();
+
+  const std::size_t nx = s0.columns;
+  const std::size_t ny = s0.rows;
+  const std::size_t nz = slices.size();
+
+  for (const DicomSliceInfo &slice : slices) {
+    if (slice.columns != nx || slice.rows != ny) {
+      LOG(ERROR) << "Slices in series have different matrix sizes!";
+      return false;
+    }
+  }
+
+  double normal[3];
+  GetSliceNormal(s0.orientation, normal);
+
+  typename TImage::SpacingType spacing;
+  spacing[0] = s0.spacing[0];
+  spacing[1] = s0.spacing[1];
+  spacing[2] = (nz > 1) ? (sN.location - s0.location) / (nz - 1) : 1.0;
+
+  if (spacing[2] <= 0.0) {
+    LOG(WARNING) << "Unable to determine slice spacing. Using 1mm.";
+    spacing[2] = 1.0;
+  }
+
+  typename TImage::PointType origin;
+  typename TImage::DirectionType direction;
+  for (unsigned int i = 0; i < 3; i++) {
+    origin[i] = s0.position[i];
+    direction[i][0] = s0.orientation[i];
+    direction[i][1] = s0.orientation[3 + i];
+    direction[i][2] = normal[i];
+  }
+
+  typename TImage::RegionType region;
+  region.SetSize(0, nx);
+  region.SetSize(1, ny);
+  region.SetSize(2, nz);
+
+  image->SetRegions(region);
+  image->SetSpacing(spacing);
+  image->SetOrigin(origin);
+  image->SetDirection(direction);
+
+  return true;
+}
+
+//Reads a single-frame DICOM series into a 3D volume. Slice headers are
+//scanned and the slice files decoded concurrently on a thread pool, each
+//straight into its place in the preallocated volume. Slices are ordered
+//along the normal of the row/column cosines; see SetSeriesGeometry().
+template <class TImage>
+class DicomSeriesLoader {
+
+public:
+
+  //Slice files in any order.
+  void SetFileNames(const std::vector<std::string> &fileNames);
+
+  //Slices already read with ReadSliceInfo() (skips the header pass).
+  void SetSlices(const std::vector<DicomSliceInfo> &slices){ _slices = slices; };
+
+  //Use an existing pool rather than creating one per read.
+  void SetThreadPool(ThreadPool *pool){ _pool = pool; };
+
+  bool Update();
+
+  typename TImage::Pointer GetOutput(){ return _output; };
+
+  //Slices in volume order, after Update().
+  const std::vector<DicomSliceInfo>& GetSlices() const { return _slices; };
+
+protected:
+
+  bool ScanSlices(ThreadPool &pool);
+
+  std::vector<std::string> _fileNames;
+  std::vector<DicomSliceInfo> _slices;
+
+  ThreadPool *_pool = nullptr;
+
+  typename TImage::Pointer _output;
+
+};
+
+template <class TImage>
+void DicomSeriesLoader<TImage>::SetFileNames(const std::vector<std::string> &fileNames){
+  _fileNames = fileNames;
+  _slices.clear();
+}
+
+//Read position/orientation of every file in parallel.
+template <class TImage>
+bool DicomSeriesLoader<TImage>::ScanSlices(ThreadPool &pool){
+
+  std::vector<DicomSliceInfo> slices(_fileNames.size());
+  std::vector< std::future<bool> > results;
+
+  for (std::size_t i = 0; i < _fileNames.size(); i++) {
+    results.push_back(pool.Submit([this, &slices, i](){
+      if (ReadSliceInfo(_fileNames[i], slices[i]))
+        return true;
+      LOG(ERROR) << "Unable to read slice header from " << _fileNames[i];
+      return false;
+    }));
+  }
+
+  bool bStatus = true;
+  for (auto &r : results) {
+    try {
+      bStatus = r.get() && bStatus;
+    } catch (std::exception &e) {
+      LOG(ERROR) << "Reading slice header failed: " << e.what();
+      bStatus = false;
+    }
+  }
+
+  if (!bStatus)
+    return false;
+
+  _slices = slices;
+  return true;
+}
+
+template <class TImage>
+bool DicomSeriesLoader<TImage>::Update(){
+
+  typedef typename TImage::PixelType PixelType;
+
+  std::unique_ptr<ThreadPool> localPool;
+  ThreadPool *pool = _pool;
+  if (pool == nullptr) {
+    localPool.reset(new ThreadPool);
+    pool = localPool.get();
+  }
+
+  if (_slices.empty()) {
+    if (_fileNames.empty()) {
+      LOG(ERROR) << "No DICOM files to read!";
+      return false;
+    }
+
+    if (!ScanSlices(*pool))
+      return false;
+  }
+
+  SortSlices(_slices);
+
+  _output = TImage::New();
+
+  if (!SetSeriesGeometry(_slices, _output.GetPointer())) {
+    _output = nullptr;
+    return false;
+  }
+
+  const std::size_t nx = _slices.front().columns;
+  const std::size_t ny = _slices.front().rows;
+  const std::size_t nz = _slices.size();
+
+  try {
+    _output->Allocate();
+  } catch (itk::ExceptionObject &ex) {
+    LOG(ERROR) << "Unable to allocate volume for DICOM series!";
+    return false;
+  }
+
+  PixelType *buffer = _output->GetBufferPointer();
+  const std::size_t sliceSize = nx * ny;
+
+  //Decode slices concurrently, each into its own slot. Each pool worker
+  //keeps one decode buffer for all the slices it is given.
+  std::vector< std::future<bool> > results;
+  for (std::size_t z = 0; z < nz; z++) {
+    const std::string &fileName = _slices[z].fileName;
+    results.push_back(pool->Submit([&fileName, buffer, z, sliceSize](){
+      static thread_local std::vector<char> scratch;
+      return DecodeSlice(fileName, buffer + z * sliceSize, sliceSize, scratch);
+    }));
+  }
+
+  bool bStatus = true;
+  for (auto &r : results) {
+    try {
+      bStatus = r.get() && bStatus;
+    } catch (std::exception &e) {
+      LOG(ERROR) << "Slice decoding failed: " << e.what();
+      bStatus = false;
+    }
+  }
+
+  if (!bStatus) {
+    _output = nullptr;
+    return false;
+  }
+
+  DLOG(INFO) << "Read " << nz << " slices of " << nx << "x" << ny;
+
+  return true;
+}
+
+} //namespace nmtools
+
+#endif
@@ -24,9 +24,12 @@
 #ifndef GEPET_HPP
 #define GEPET_HPP
 
+#include <cctype>
+#include <cstdlib>
 #include <memory>
 
 #include <gdcmReader.h>
+#include <gdcmSequenceOfItems.h>
 #include <boost/filesystem.hpp>
 #include <glog/logging.h>
 #include <boost/regex.hpp>
@@ -50,8 +53,13 @@ public:
   { return ExtractRDF( dst ); }
   virtual bool ExtractData( const boost::filesystem::path dst )
   { return true; }
+  virtual bool SetDataFileName( const boost::filesystem::path dataFile)
+  { return true; }
   virtual bool ModifyHeader( const boost::filesystem::path src, const boost::filesystem::path dataFile)
   { return true; }
+  //DICOM fields plus isotope, frame duration and table position (see
+  //GetGEPETMetadata()).
+  virtual bool GetMetadata( nlohmann::json &metadata );
   virtual boost::filesystem::path GetStdFileName( boost::filesystem::path srcFile, ContentType ctype)
   {
     // GE doesn't have header/raw data, it's all just one RDF file
@@ -112,6 +120,130 @@ IGEPET::IGEPET(boost::filesystem::path src)
   : IDicomExtractor(src)
 {}
 
+//Text value of tag in ds, without DICOM padding. Unlike
+//GetOptionalTagInfo(), works on the data sets of sequence items.
+bool GetDataSetString(const gdcm::DataSet &ds, const gdcm::Tag tag, std::string &dst){
+
+  dst.clear();
+
+  if (!ds.FindDataElement(tag))
+    return false;
+
+  const gdcm::ByteValue *bv = ds.GetDataElement(tag).GetByteValue();
+  if (bv == NULL)
+    return false;
+
+  dst.assign(bv->GetPointer(), bv->GetLength());
+
+  const std::string::size_type end = dst.find_last_not_of(std::string(" \0", 2));
+  dst.erase(end == std::string::npos ? 0 : end + 1);
+  const std::string::size_type begin = dst.find_first_not_of(' ');
+  dst.erase(0, begin == std::string::npos ? dst.size() : begin);
+
+  return !dst.empty();
+}
+
+//Copy of the first item of sequence tag in ds.
+bool GetFirstSequenceItem(const gdcm::DataSet &ds, const gdcm::Tag tag, gdcm::DataSet &item){
+
+  if (!ds.FindDataElement(tag))
+    return false;
+
+  gdcm::SmartPointer<gdcm::SequenceOfItems> sq = ds.GetDataElement(tag).GetValueAsSQ();
+  if (!sq || sq->GetNumberOfItems() == 0)
+    return false;
+
+  item = sq->GetItem(1).GetNestedDataSet();
+  return true;
+}
+
+//Radionuclide from a DICOM code meaning ('^18^Fluorine') in the BIDS
+//form ('F18'). Anything else goes through FormatRadionuclide().
+std::string FormatCodedRadionuclide(const std::string &meaning){
+
+  static const std::pair<const char*, const char*> elements[] = {
+    { "fluorine", "F" }, { "carbon", "C" }, { "nitrogen", "N" }, { "oxygen", "O" },
+    { "gallium", "Ga" }, { "rubidium", "Rb" }, { "copper", "Cu" }, { "zirconium", "Zr" },
+    { "iodine", "I" }, { "bromine", "Br" }, { "yttrium", "Y" }, { "scandium", "Sc" },
+    { "germanium", "Ge" }, { "technetium", "Tc" } };
+
+  std::string mass, name;
+  for (char c : meaning) {
+    const unsigned char u = static_cast<unsigned char>(c);
+    if (std::isdigit(u) && name.empty())
+      mass += c;
+    else if (std::isalpha(u))
+      name += static_cast<char>(std::tolower(u));
+    else if (c != '^' && c != ' ')
+      return FormatRadionuclide(meaning);
+  }
+
+  for (const auto &e : elements)
+    if (!mass.empty() && name == e.first)
+      return e.second + mass;
+
+  return FormatRadionuclide(meaning);
+}
+
+//Isotope, half-life, frame duration and table position from the
+//standard tags of a GE raw data file, named as in BIDS-PET where BIDS
+//has a name for them and by their DICOM keyword otherwise. GE files
+//have no study date or time of their own beyond the DICOM ones.
+void GetGEPETMetadata(const gdcm::File &file, nlohmann::json &metadata){
+
+  const gdcm::DataSet &ds = file.GetDataSet();
+  std::string value;
+
+  //Numeric text fields (IS, DS), skipped if they do not parse.
+  auto getNumber = [&](const gdcm::DataSet &set, const gdcm::Tag tag, double &number){
+    if (!GetDataSetString(set, tag, value))
+      return false;
+    char *end = nullptr;
+    number = std::strtod(value.c_str(), &end);
+    return end != value.c_str();
+  };
+
+  double number = 0.0;
+
+  //Radiopharmaceutical Information Sequence: the coded radionuclide,
+  //else the (retired) Radionuclide text.
+  gdcm::DataSet radiopharmaceutical;
+  if (GetFirstSequenceItem(ds, gdcm::Tag(0x0054, 0x0016), radiopharmaceutical)) {
+
+    gdcm::DataSet code;
+    if (GetFirstSequenceItem(radiopharmaceutical, gdcm::Tag(0x0054, 0x0300), code) &&
+        GetDataSetString(code, gdcm::Tag(0x0008, 0x0104), value))
+      metadata["TracerRadionuclide"] = FormatCodedRadionuclide(value);
+    else if (GetDataSetString(radiopharmaceutical, gdcm::Tag(0x0018, 0x0030), value))
+      metadata["TracerRadionuclide"] = FormatRadionuclide(value);
+
+    if (getNumber(radiopharmaceutical, gdcm::Tag(0x0018, 0x1075), number))
+      metadata["RadionuclideHalfLife"] = number;
+  }
+
+  //Actual Frame Duration is in ms; BIDS-PET gives seconds, as a list.
+  if (getNumber(ds, gdcm::Tag(0x0018, 0x1242), number))
+    metadata["FrameDuration"] = { number / 1000.0 };
+
+  //Table Position (FD, mm), binary: read through the DICOM dictionary.
+  if (GetOptionalTagInfo(file, gdcm::Tag(0x0018, 0x9327), value)) {
+    char *end = nullptr;
+    number = std::strtod(value.c_str(), &end);
+    if (end != value.c_str())
+      metadata["TablePosition"] = number;
+  }
+}
+
+bool IGEPET::GetMetadata( nlohmann::json &metadata ){
+
+  if (!IDicomExtractor::GetMetadata(metadata))
+    return false;
+
+  GetGEPETMetadata(_dicomReader->GetFile(), metadata);
+
+  return true;
+}
+
 //Extract raw data.
 bool IGEPET::ExtractBlob( const boost::filesystem::path dst, const gdcm::Tag DataTag ){
 
@@ -203,15 +335,22 @@ public:
 
   FileType GetFileType( boost::filesystem::path src) {
 
+    if (!Open(src)) {
+        return FileType::EERROR;
+    }
+
+    return GetFileType(dicomReader->GetFile());
+  }
+
+  FileType GetFileType( const gdcm::File &file ) {
+
     //Extracts information via DICOM to determine what kind of raw data type we're dealing with.
     FileType foundFileType = FileType::EUNKNOWN;
 
-    if (!Open(src)) {
+    if (!ReadScannerNames(file)) {
         return FileType::EERROR;
     }
 
-    const gdcm::File &file = dicomReader->GetFile();
-    
     if (manufacturerName.find("GE MEDICAL SYSTEMS") != std::string::npos) {
         DLOG(INFO) << "Manufacturer = GE";
 
@@ -278,6 +417,20 @@ public:
     return foundFileType;
   }
 
+  static const char* GetFileTypeName( FileType fType ) {
+    switch (fType) {
+      case FileType::EGEPETCTAC: return "GE_CTAC";
+      case FileType::EGEPETSINO: return "GE_SINO";
+      case FileType::EGEPETLIST: return "GE_LIST";
+      case FileType::EGEPETNORM2D: return "GE_NORM2D";
+      case FileType::EGEPETNORM3D: return "GE_NORM3D";
+      case FileType::EGEPETWCC: return "GE_WCC";
+      case FileType::EGEPETGEO: return "GE_GEO";
+      case FileType::EUNKNOWN: return "UNKNOWN";
+      default: return "ERROR";
+    }
+  }
+
   private:
       IGEPET* Create_ptr( boost::filesystem::path inFile ) {
 
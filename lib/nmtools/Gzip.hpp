@@ -0,0 +1,283 @@
+/*
+   Gzip.hpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Multithreaded gzip compression (pigz-style).
+ */
+
+#ifndef GZIP_HPP
+#define GZIP_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <glog/logging.h>
+#include <zlib.h>
+
+#include "Parallel.hpp"
+
+namespace nmtools {
+
+//Writes a single, standard gzip stream, compressing blocks of the input
+//on several threads at once. As in pigz, each block is deflated on its
+//own, primed with the last 32K of the previous block so the ratio stays
+//close to single-threaded gzip, and ends on a byte boundary (sync flush)
+//so the compressed blocks can simply be concatenated. Block CRCs are
+//combined with crc32_combine() for the trailer.
+class ParallelGzipWriter {
+
+public:
+
+  //level: zlib compression level (0-9, or -1 for zlib's default).
+  explicit ParallelGzipWriter(int level = Z_DEFAULT_COMPRESSION, unsigned int numThreads = 0,
+                              std::size_t blockSize = 1 << 20);
+  ~ParallelGzipWriter();
+
+  ParallelGzipWriter(const ParallelGzipWriter&) = delete;
+  ParallelGzipWriter& operator=(const ParallelGzipWriter&) = delete;
+
+  bool Open(const boost::filesystem::path &dst);
+
+  //Compress n bytes. Whole groups of blocks are compressed straight
+  //from data; only a shorter tail is copied, to wait for more input.
+  bool Write(const char *data, std::size_t n);
+
+  //Compress what is left and write the trailer.
+  bool Close();
+
+protected:
+
+  //Compress and write the n bytes at data, in blocks of _blockSize.
+  //The last block ends the deflate stream if isFinal.
+  bool Flush(const char *data, std::size_t n, bool isFinal);
+
+  bool WriteBytes(const void *data, std::size_t n);
+
+  static const std::size_t kDictionarySize = 32768;
+
+  int _level;
+  unsigned int _numThreads;
+  std::size_t _blockSize;
+
+  FILE *_fp = nullptr;
+  std::vector<char> _pending;     //input short of a whole group
+  std::vector<char> _dictionary;  //last 32K compressed
+
+  uLong _crc = 0;
+  uint64_t _totalIn = 0;
+
+};
+
+const std::size_t ParallelGzipWriter::kDictionarySize;
+
+ParallelGzipWriter::ParallelGzipWriter(int level, unsigned int numThreads, std::size_t blockSize)
+  : _level(level), _numThreads(numThreads), _blockSize(std::max<std::size_t>(blockSize, kDictionarySize)){
+
+  if (_numThreads == 0)
+    _numThreads = GetDefaultNumberOfThreads();
+}
+
+ParallelGzipWriter::~ParallelGzipWriter(){
+  if (_fp != nullptr)
+    std::fclose(_fp);
+}
+
+bool ParallelGzipWriter::Open(const boost::filesystem::path &dst){
+
+  _fp = std::fopen(dst.string().c_str(), "wb");
+
+  if (_fp == nullptr) {
+    LOG(ERROR) << "Unable to open " << dst << " for writing!";
+    return false;
+  }
+
+  _pending.clear();
+  _dictionary.clear();
+  _crc = crc32(0L, Z_NULL, 0);
+  _totalIn = 0;
+
+  //Minimal gzip member header: deflate, no name, no mtime, Unix.
+  const unsigned char header[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3};
+
+  return WriteBytes(header, sizeof(header));
+}
+
+bool ParallelGzipWriter::WriteBytes(const void *data, std::size_t n){
+
+  if (std::fwrite(data, 1, n, _fp) != n) {
+    LOG(ERROR) << "Failed writing compressed data!";
+    return false;
+  }
+
+  return true;
+}
+
+bool ParallelGzipWriter::Write(const char *data, std::size_t n){
+
+  //A group is held back until more input follows: only Close() knows
+  //which block is last.
+  const std::size_t groupSize = _blockSize * _numThreads * 2;
+  bool bStatus = true;
+
+  //Complete the group already pending first.
+  if (!_pending.empty()) {
+    const std::size_t count = std::min(n, groupSize - _pending.size());
+    _pending.insert(_pending.end(), data, data + count);
+    data += count;
+    n -= count;
+
+    if (n == 0)
+      return true;
+
+    bStatus = Flush(_pending.data(), _pending.size(), false);
+    _pending.clear();
+  }
+
+  while (bStatus && n > groupSize) {
+    bStatus = Flush(data, groupSize, false);
+    data += groupSize;
+    n -= groupSize;
+  }
+
+  if (bStatus)
+    _pending.assign(data, data + n);
+
+  return bStatus;
+}
+
+bool ParallelGzipWriter::Flush(const char *data, std::size_t n, bool isFinal){
+
+  std::size_t numBlocks = (n + _blockSize - 1) / _blockSize;
+  if (isFinal && numBlocks == 0)
+    numBlocks = 1;  //empty input still needs a final (empty) block
+
+  std::vector< std::vector<char> > compressed(numBlocks);
+  std::vector<uLong> crcs(numBlocks);
+  std::vector<unsigned char> ok(numBlocks, 0);
+
+  ParallelFor(0, numBlocks, [&](std::size_t first, std::size_t last, unsigned int){
+
+    for (std::size_t b = first; b < last; b++) {
+
+      const std::size_t offset = b * _blockSize;
+      const std::size_t length = std::min(_blockSize, n - std::min(n, offset));
+      const Bytef *in = reinterpret_cast<const Bytef*>(data + offset);
+      const bool isLast = isFinal && b + 1 == numBlocks;
+
+      crcs[b] = crc32(crc32(0L, Z_NULL, 0), in, static_cast<uInt>(length));
+
+      z_stream strm;
+      strm.zalloc = Z_NULL;
+      strm.zfree = Z_NULL;
+      strm.opaque = Z_NULL;
+
+      //Raw deflate: the gzip wrapper is written by this class.
+      if (deflateInit2(&strm, _level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        continue;
+
+      //Prime with the tail of the previous block.
+      if (b > 0) {
+        const std::size_t dictLen = std::min(kDictionarySize, offset);
+        deflateSetDictionary(&strm, in - dictLen, static_cast<uInt>(dictLen));
+      }
+      else if (!_dictionary.empty()) {
+        deflateSetDictionary(&strm, reinterpret_cast<const Bytef*>(_dictionary.data()),
+                             static_cast<uInt>(_dictionary.size()));
+      }
+
+      std::vector<char> &out = compressed[b];
+      out.resize(deflateBound(&strm, length) + 16);
+
+      strm.next_in = const_cast<Bytef*>(in);
+      strm.avail_in = static_cast<uInt>(length);
+
+      int ret;
+      do {
+        if (strm.total_out == out.size())
+          out.resize(out.size() * 2);
+        strm.next_out = reinterpret_cast<Bytef*>(out.data() + strm.total_out);
+        strm.avail_out = static_cast<uInt>(out.size() - strm.total_out);
+        ret = deflate(&strm, isLast ? Z_FINISH : Z_SYNC_FLUSH);
+      } while (isLast ? ret == Z_OK : (ret == Z_OK && strm.avail_out == 0));
+
+      out.resize(strm.total_out);
+      ok[b] = isLast ? (ret == Z_STREAM_END) : (ret == Z_OK || ret == Z_BUF_ERROR);
+
+      deflateEnd(&strm);
+    }
+  }, _numThreads);
+
+  for (std::size_t b = 0; b < numBlocks; b++) {
+
+    if (!ok[b]) {
+      LOG(ERROR) << "Compression failed!";
+      return false;
+    }
+
+    if (!WriteBytes(compressed[b].data(), compressed[b].size()))
+      return false;
+
+    const std::size_t offset = b * _blockSize;
+    const std::size_t length = std::min(_blockSize, n - std::min(n, offset));
+    _crc = crc32_combine(_crc, crcs[b], static_cast<z_off_t>(length));
+  }
+
+  _totalIn += n;
+
+  //Keep the last 32K as the dictionary for the next group: data may
+  //be the caller's and gone by then.
+  if (n >= kDictionarySize)
+    _dictionary.assign(data + (n - kDictionarySize), data + n);
+  else {
+    _dictionary.insert(_dictionary.end(), data, data + n);
+    if (_dictionary.size() > kDictionarySize)
+      _dictionary.erase(_dictionary.begin(), _dictionary.end() - kDictionarySize);
+  }
+
+  return true;
+}
+
+bool ParallelGzipWriter::Close(){
+
+  if (_fp == nullptr)
+    return false;
+
+  bool bStatus = Flush(_pending.data(), _pending.size(), true);
+  _pending.clear();
+
+  if (bStatus) {
+    //Trailer: CRC-32 and input size (mod 2^32), little-endian.
+    unsigned char trailer[8];
+    for (unsigned int i = 0; i < 4; i++) {
+      trailer[i] = static_cast<unsigned char>((_crc >> (8 * i)) & 0xff);
+      trailer[4 + i] = static_cast<unsigned char>((_totalIn >> (8 * i)) & 0xff);
+    }
+    bStatus = WriteBytes(trailer, sizeof(trailer));
+  }
+
+  if (std::fclose(_fp) != 0)
+    bStatus = false;
+  _fp = nullptr;
+
+  return bStatus;
+}
+
+} //namespace nmtools
+
+#endif
@@ -0,0 +1,305 @@
+/*
+   HardwareMuMap.hpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Hardware (patient table, RF coil) mu-map templates resampled onto the
+   grid of a patient mu-map, with a disk cache of the results.
+ */
+
+#ifndef HARDWAREMUMAP_HPP
+#define HARDWAREMUMAP_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include <boost/filesystem.hpp>
+#include <glog/logging.h>
+
+#include <itkImage.h>
+#include <itkImageFileReader.h>
+#include <itkSpatialOrientationAdapter.h>
+
+#include "Orientation.hpp"
+#include "Resample.hpp"
+
+namespace nmtools {
+
+//One hardware mu-map template (any format ITK reads, e.g. NIfTI), in
+//mu-values (cm-1) and registered to the scanner frame at bed position 0.
+//Resampled copies are cached per (template, output geometry, bed
+//position), so repeat studies on the same grid only read them back.
+class HardwareMuMap {
+
+public:
+
+  typedef itk::Image<float, 3> ImageType;
+
+  explicit HardwareMuMap(const boost::filesystem::path &templatePath) : _templatePath(templatePath){};
+
+  //Keep resampled templates here (optional).
+  void SetCacheDirectory(const boost::filesystem::path &dir){ _cacheDirectory = dir; };
+
+  //Table position (mm). The template is shifted by this along z.
+  void SetBedPosition(double position){ _bedPosition = position; };
+
+  //Template on grid's voxels (grid need not be allocated). Voxels the
+  //template does not cover are zero.
+  bool Resample(const ImageType *grid, ImageType::Pointer &output);
+
+protected:
+
+  //Identifies the template file (by path, size and time) and the grid.
+  bool GetCacheKey(const ImageType *grid, std::string &key) const;
+  boost::filesystem::path GetCacheFile(const std::string &key) const;
+
+  //Allocates output on grid's voxels only if the cache holds them.
+  bool ReadCache(const std::string &key, const ImageType *grid, ImageType::Pointer &output) const;
+  bool WriteCache(const std::string &key, const ImageType *output) const;
+
+  bool ResampleTemplate(const ImageType *grid, ImageType::Pointer &output) const;
+
+  boost::filesystem::path _templatePath;
+  boost::filesystem::path _cacheDirectory;
+  double _bedPosition = 0.0;
+
+};
+
+bool HardwareMuMap::GetCacheKey(const ImageType *grid, std::string &key) const {
+
+  std::stringstream ss;
+
+  try {
+    ss << boost::filesystem::canonical(_templatePath).string()
+       << "|" << boost::filesystem::file_size(_templatePath)
+       << "|" << boost::filesystem::last_write_time(_templatePath);
+  } catch (boost::filesystem::filesystem_error &e) {
+    LOG(ERROR) << "Unable to open hardware mu-map " << _templatePath << ": " << e.what();
+    return false;
+  }
+
+  const ImageType::SizeType &size = grid->GetLargestPossibleRegion().GetSize();
+
+  ss << std::setprecision(9);
+  for (unsigned int k = 0; k < 3; k++) {
+    ss << "|" << size[k] << "," << grid->GetSpacing()[k] << "," << grid->GetOrigin()[k];
+    for (unsigned int r = 0; r < 3; r++)
+      ss << "," << grid->GetDirection()[r][k];
+  }
+  ss << "|" << _bedPosition;
+
+  key = ss.str();
+
+  return true;
+}
+
+//Cache file name from a (stable) FNV-1a hash of the key.
+boost::filesystem::path HardwareMuMap::GetCacheFile(const std::string &key) const {
+
+  uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char c : key) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+
+  std::stringstream ss;
+  ss << "hardware-" << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+
+  return _cacheDirectory / ss.str();
+}
+
+//Cache files hold the key on one line, then the voxels as stored in
+//memory. The key and size are checked before the output is allocated,
+//so a miss (or a hash collision) allocates nothing.
+bool HardwareMuMap::ReadCache(const std::string &key, const ImageType *grid,
+                              ImageType::Pointer &output) const {
+
+  const boost::filesystem::path cacheFile = GetCacheFile(key);
+  const std::size_t numVoxels = grid->GetLargestPossibleRegion().GetNumberOfPixels();
+
+  boost::system::error_code ec;
+  const uintmax_t fileSize = boost::filesystem::file_size(cacheFile, ec);
+
+  if (ec)
+    return false;
+
+  FILE *fp = std::fopen(cacheFile.string().c_str(), "rb");
+
+  if (fp == nullptr)
+    return false;
+
+  std::string stored(key.size() + 1, '\0');
+
+  bool bStatus = fileSize == stored.size() + numVoxels * sizeof(float) &&
+                 std::fread(&stored[0], 1, stored.size(), fp) == stored.size() &&
+                 stored == key + "\n";
+
+  if (bStatus) {
+    ImageType::RegionType region;
+    region.SetSize(grid->GetLargestPossibleRegion().GetSize());
+
+    output = ImageType::New();
+    output->SetRegions(region);
+    output->SetSpacing(grid->GetSpacing());
+    output->SetOrigin(grid->GetOrigin());
+    output->SetDirection(grid->GetDirection());
+
+    try {
+      output->Allocate();
+      bStatus = std::fread(output->GetBufferPointer(), sizeof(float), numVoxels, fp) == numVoxels;
+    } catch (itk::ExceptionObject &ex){
+      LOG(ERROR) << "Unable to allocate hardware mu-map!";
+      bStatus = false;
+    }
+  }
+
+  std::fclose(fp);
+
+  if (!bStatus) {
+    output = nullptr;
+    LOG(WARNING) << "Ignoring stale hardware mu-map cache " << cacheFile;
+    return false;
+  }
+
+  DLOG(INFO) << "Read hardware mu-map cache " << cacheFile;
+
+  return true;
+}
+
+bool HardwareMuMap::WriteCache(const std::string &key, const ImageType *output) const {
+
+  const boost::filesystem::path cacheFile = GetCacheFile(key);
+  const std::size_t numVoxels = output->GetBufferedRegion().GetNumberOfPixels();
+
+  try {
+    boost::filesystem::create_directories(_cacheDirectory);
+
+    //Write to a temporary file first so concurrent readers never see a
+    //partial cache.
+    boost::filesystem::path tmpFile = cacheFile;
+    tmpFile += boost::filesystem::unique_path(".%%%%%%%%");
+
+    FILE *fp = std::fopen(tmpFile.string().c_str(), "wb");
+
+    if (fp == nullptr) {
+      LOG(WARNING) << "Unable to write hardware mu-map cache " << cacheFile;
+      return false;
+    }
+
+    const std::string line = key + "\n";
+    bool bStatus = std::fwrite(line.data(), 1, line.size(), fp) == line.size() &&
+                   std::fwrite(output->GetBufferPointer(), sizeof(float), numVoxels, fp) == numVoxels;
+
+    if (std::fclose(fp) != 0)
+      bStatus = false;
+
+    if (!bStatus) {
+      boost::filesystem::remove(tmpFile);
+      LOG(WARNING) << "Unable to write hardware mu-map cache " << cacheFile;
+      return false;
+    }
+
+    boost::filesystem::rename(tmpFile, cacheFile);
+  } catch (boost::filesystem::filesystem_error &e) {
+    LOG(WARNING) << "Unable to write hardware mu-map cache " << cacheFile << ": " << e.what();
+    return false;
+  }
+
+  DLOG(INFO) << "Wrote hardware mu-map cache " << cacheFile;
+
+  return true;
+}
+
+//Read the template, bring it to grid's orientation (as a view) and
+//resample it linearly onto grid. Fails unless the two then have the
+//same direction cosines.
+bool HardwareMuMap::ResampleTemplate(const ImageType *grid, ImageType::Pointer &output) const {
+
+  typedef itk::ImageFileReader<ImageType> ReaderType;
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(_templatePath.string());
+
+  try {
+    reader->Update();
+  } catch (itk::ExceptionObject &ex){
+    LOG(ERROR) << "Unable to read hardware mu-map " << _templatePath << ": " << ex.GetDescription();
+    return false;
+  }
+
+  const ImageType::Pointer hardware = reader->GetOutput();
+
+  itk::SpatialOrientationAdapter adapter;
+  const AxisMapping mapping = ComputeAxisMapping(hardware->GetDirection(),
+                                                 adapter.FromDirectionCosines(grid->GetDirection()));
+
+  const ImageType::Pointer geometry = GetMappedGeometry<ImageType>(hardware.GetPointer(), mapping);
+
+  //Resampling is along the grid's axes: an oblique grid (or template)
+  //would place the hardware wrongly.
+  if (!IsSameDirection(geometry->GetDirection(), grid->GetDirection())) {
+    LOG(ERROR) << "Hardware mu-map " << _templatePath << " is not aligned with the axes of the mu-map"
+               << " (oblique acquisition?); resample it to the mu-map's orientation first";
+    return false;
+  }
+
+  ImageType::PointType origin = geometry->GetOrigin();
+  origin[2] += _bedPosition;
+  geometry->SetOrigin(origin);
+
+  AxisAlignedResampler<ImageType, ImageType> resampler;
+  resampler.SetInput( geometry );
+  resampler.SetInputView( MakeMappedView(hardware.GetPointer(), mapping) );
+  resampler.SetOutputOrigin( grid->GetOrigin() );
+  resampler.SetOutputSpacing( grid->GetSpacing() );
+  resampler.SetSize( grid->GetLargestPossibleRegion().GetSize() );
+  resampler.SetInterpolation( Interpolation::Linear );
+
+  if (!resampler.Update()){
+    LOG(ERROR) << "Unable to resample hardware mu-map " << _templatePath;
+    return false;
+  }
+
+  output = resampler.GetOutput();
+
+  return true;
+}
+
+bool HardwareMuMap::Resample(const ImageType *grid, ImageType::Pointer &output){
+
+  std::string key;
+  if (!GetCacheKey(grid, key))
+    return false;
+
+  if (!_cacheDirectory.empty() && ReadCache(key, grid, output)) {
+    LOG(INFO) << "Using cached hardware mu-map for " << _templatePath;
+    return true;
+  }
+
+  LOG(INFO) << "Resampling hardware mu-map " << _templatePath;
+
+  if (!ResampleTemplate(grid, output))
+    return false;
+
+  if (!_cacheDirectory.empty())
+    WriteCache(key, output.GetPointer());
+
+  return true;
+}
+
+} //namespace nmtools
+
+#endif
@@ -0,0 +1,207 @@
+/*
+   Interfile.hpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Writing Interfile (.hv/.v) image volumes and (.hs/.s) sinograms.
+ */
+
+#ifndef INTERFILE_HPP
+#define INTERFILE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <glog/logging.h>
+
+#include "InterfileHeader.hpp"
+
+namespace nmtools {
+
+//True if this machine stores multi-byte values little-endian first.
+bool IsLittleEndianHost(){
+  const uint16_t one = 1;
+  return *reinterpret_cast<const unsigned char*>(&one) == 1;
+}
+
+//Writes an Interfile image: the given .hv header and a single .v file
+//holding every frame back to back, little-endian, in one buffered stream
+//straight from the image buffers (no intermediate image file).
+//The header should describe the frames added (e.g. 'number of time
+//frames'); its 'name of data file' is set to the .v file name.
+class InterfileImageWriter {
+
+public:
+
+  //Header, with a 'name of data file' key.
+  void SetHeader(const InterfileHeaderBuilder &header){ _header = header; };
+
+  //Append a frame. The buffer must stay valid until Write(); every frame
+  //must have the same number of voxels.
+  template <typename TPixel>
+  void AddFrame(const TPixel *data, std::size_t numVoxels);
+
+  //Append an ITK image as a frame.
+  template <class TImage>
+  void AddFrame(const TImage *image){
+    AddFrame(image->GetBufferPointer(), image->GetBufferedRegion().GetNumberOfPixels());
+  };
+
+  //Header and data file extensions. Default .hv/.v (images).
+  void SetExtensions(const std::string &header, const std::string &data){
+    _headerExtension = header;
+    _dataExtension = data;
+  };
+
+  //Write <dst>.hv and <dst>.v (dst's extension is replaced).
+  bool Write(boost::filesystem::path dst);
+
+protected:
+
+  struct Frame {
+    const char *data;
+    std::size_t numBytes;
+  };
+
+  bool WriteData(const boost::filesystem::path &dataPath) const;
+
+  InterfileHeaderBuilder _header;
+  std::vector<Frame> _frames;
+  std::size_t _bytesPerVoxel = 0;
+
+  std::string _headerExtension = ".hv";
+  std::string _dataExtension = ".v";
+
+};
+
+template <typename TPixel>
+void InterfileImageWriter::AddFrame(const TPixel *data, std::size_t numVoxels){
+
+  Frame frame;
+  frame.data = reinterpret_cast<const char*>(data);
+  frame.numBytes = numVoxels * sizeof(TPixel);
+
+  _bytesPerVoxel = sizeof(TPixel);
+  _frames.push_back(frame);
+}
+
+//Stream all frames into one file. Data are written directly from the
+//frame buffers, except on big-endian hosts where they are byte-swapped a
+//block at a time.
+bool InterfileImageWriter::WriteData(const boost::filesystem::path &dataPath) const {
+
+  FILE *fp = std::fopen(dataPath.string().c_str(), "wb");
+
+  if (fp == nullptr) {
+    LOG(ERROR) << "Unable to open " << dataPath << " for writing!";
+    return false;
+  }
+
+  //Large stdio buffer: few, big writes.
+  std::setvbuf(fp, nullptr, _IOFBF, 1 << 22);
+
+  const bool swap = !IsLittleEndianHost() && _bytesPerVoxel > 1;
+  std::vector<char> block;
+
+  bool bStatus = true;
+
+  for (const Frame &frame : _frames) {
+
+    if (!swap) {
+      bStatus = std::fwrite(frame.data, 1, frame.numBytes, fp) == frame.numBytes;
+    }
+    else {
+      const std::size_t blockSize = (1 << 20) * _bytesPerVoxel;
+      for (std::size_t offset = 0; offset < frame.numBytes && bStatus; offset += blockSize) {
+        const std::size_t n = std::min(blockSize, frame.numBytes - offset);
+        block.assign(frame.data + offset, frame.data + offset + n);
+        for (std::size_t i = 0; i < n; i += _bytesPerVoxel)
+          std::reverse(block.begin() + i, block.begin() + i + _bytesPerVoxel);
+        bStatus = std::fwrite(block.data(), 1, n, fp) == n;
+      }
+    }
+
+    if (!bStatus)
+      break;
+  }
+
+  if (std::fclose(fp) != 0)
+    bStatus = false;
+
+  if (!bStatus)
+    LOG(ERROR) << "Failed writing image data to " << dataPath;
+
+  return bStatus;
+}
+
+bool InterfileImageWriter::Write(boost::filesystem::path dst){
+
+  if (_frames.empty()) {
+    LOG(ERROR) << "No image data to write!";
+    return false;
+  }
+
+  for (const Frame &frame : _frames) {
+    if (frame.numBytes != _frames[0].numBytes) {
+      LOG(ERROR) << "All Interfile frames must be the same size!";
+      return false;
+    }
+  }
+
+  boost::filesystem::path dataPath = dst;
+  dataPath.replace_extension(_dataExtension);
+
+  boost::filesystem::path headerPath = dst;
+  headerPath.replace_extension(_headerExtension);
+
+  if (!WriteData(dataPath))
+    return false;
+
+  //Point the header at the data file (relative, next to the header).
+  InterfileHeaderBuilder builder = _header;
+
+  if (builder.Has("name of data file"))
+    builder.Set("name of data file", dataPath.filename().string());
+  else
+    LOG(WARNING) << "Interfile header has no data file key!";
+
+  const std::string header = builder.ToString();
+
+  FILE *fp = std::fopen(headerPath.string().c_str(), "wb");
+
+  if (fp == nullptr) {
+    LOG(ERROR) << "Could not write Interfile header to " << headerPath;
+    return false;
+  }
+
+  const bool bStatus = std::fwrite(header.data(), 1, header.size(), fp) == header.size();
+
+  if (std::fclose(fp) != 0 || !bStatus) {
+    LOG(ERROR) << "Could not write Interfile header to " << headerPath;
+    return false;
+  }
+
+  LOG(INFO) << "Wrote Interfile header to " << headerPath;
+
+  return true;
+}
+
+} //namespace nmtools
+
+#endif
@@ -0,0 +1,197 @@
+/*
+   InterfileHeader.hpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Building Interfile headers from typed fields.
+ */
+
+#ifndef INTERFILEHEADER_HPP
+#define INTERFILEHEADER_HPP
+
+#include <limits>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "InterfileParser.hpp"
+
+namespace nmtools {
+
+//An Interfile header as an ordered list of lines, with 'key:=value' lines
+//indexed by key (as InterfileParser::Find() matches them). Fields are set
+//with their own types and the text is produced once, by ToString().
+//Setting a key that is present replaces its value where it stands;
+//otherwise the line is appended.
+class InterfileHeaderBuilder {
+
+public:
+
+  InterfileHeaderBuilder(){};
+
+  //Start from an existing header. Lines are kept as written (up to and
+  //including ':=' for fields), whatever their line endings.
+  explicit InterfileHeaderBuilder(const std::string &text);
+
+  //Between key and value in lines added from now on. Default ':='.
+  void SetSeparator(const std::string &separator){ _separator = separator; };
+
+  //'title:=' heading, e.g. '!GENERAL DATA'.
+  void AddSection(const std::string &title);
+
+  //Verbatim line (blank lines, comments).
+  void AddLine(const std::string &line);
+
+  void Set(const std::string &key, const std::string &value);
+  void Set(const std::string &key, const char *value){ Set(key, std::string(value)); };
+
+  //Integers as they are; float to round-trip precision, double to 15
+  //significant digits (dropping the noise of computed values).
+  template <typename T>
+  typename std::enable_if<std::is_arithmetic<T>::value>::type
+  Set(const std::string &key, T value){ Set(key, Format(value)); };
+
+  bool Has(const std::string &key) const;
+  bool GetValue(const std::string &key, std::string &value) const;
+
+  //The header text, every line ending in lineEnding.
+  std::string ToString(const std::string &lineEnding = "\n") const;
+
+protected:
+
+  template <typename T>
+  static std::string Format(T value);
+
+  struct Line {
+    std::string prefix;  //Key and ':=' as written, or the whole line.
+    std::string value;
+  };
+
+  std::vector<Line> _lines;
+  std::unordered_map<std::string, std::size_t> _index;
+
+  std::string _separator = ":=";
+
+};
+
+template <typename T>
+std::string InterfileHeaderBuilder::Format(T value){
+
+  if (std::is_integral<T>::value)
+    return std::to_string(value);
+
+  std::ostringstream ss;
+  ss.precision(std::is_same<T, float>::value ? std::numeric_limits<float>::max_digits10
+                                             : std::numeric_limits<double>::digits10);
+  ss << value;
+
+  return ss.str();
+}
+
+InterfileHeaderBuilder::InterfileHeaderBuilder(const std::string &text){
+
+  const InterfileParser parser(text);
+  const std::vector<InterfileEntry> &entries = parser.GetEntries();
+
+  _lines.reserve(parser.GetLines().size());
+
+  //Entries are in line order, at most one per line.
+  std::size_t e = 0;
+  for (const auto &line : parser.GetLines()) {
+
+    if (e < entries.size() && entries[e].lineBegin == line.first) {
+      const InterfileEntry &entry = entries[e++];
+      Line l;
+      l.prefix = text.substr(line.first, entry.valueBegin - line.first);
+      l.value = text.substr(entry.valueBegin, line.second - entry.valueBegin);
+      _index.insert(std::make_pair(InterfileParser::NormaliseKey(entry.key), _lines.size()));
+      _lines.push_back(l);
+    }
+    else {
+      AddLine(text.substr(line.first, line.second - line.first));
+    }
+  }
+}
+
+void InterfileHeaderBuilder::AddLine(const std::string &line){
+
+  Line l;
+  l.prefix = line;
+  _lines.push_back(l);
+}
+
+void InterfileHeaderBuilder::AddSection(const std::string &title){
+
+  //No trailing space after the separator.
+  const std::size_t end = _separator.find_last_not_of(' ');
+  AddLine(title + _separator.substr(0, end + 1));
+}
+
+void InterfileHeaderBuilder::Set(const std::string &key, const std::string &value){
+
+  const std::string normalised = InterfileParser::NormaliseKey(key);
+  const auto it = _index.find(normalised);
+
+  if (it != _index.end()) {
+    _lines[it->second].value = value;
+    return;
+  }
+
+  Line l;
+  l.prefix = key + _separator;
+  l.value = value;
+
+  _index.insert(std::make_pair(normalised, _lines.size()));
+  _lines.push_back(l);
+}
+
+bool InterfileHeaderBuilder::Has(const std::string &key) const {
+  return _index.count(InterfileParser::NormaliseKey(key)) > 0;
+}
+
+bool InterfileHeaderBuilder::GetValue(const std::string &key, std::string &value) const {
+
+  const auto it = _index.find(InterfileParser::NormaliseKey(key));
+
+  if (it == _index.end())
+    return false;
+
+  value = _lines[it->second].value;
+
+  return true;
+}
+
+std::string InterfileHeaderBuilder::ToString(const std::string &lineEnding) const {
+
+  std::size_t length = 0;
+  for (const Line &l : _lines)
+    length += l.prefix.size() + l.value.size() + lineEnding.size();
+
+  std::string text;
+  text.reserve(length);
+
+  for (const Line &l : _lines) {
+    text += l.prefix;
+    text += l.value;
+    text += lineEnding;
+  }
+
+  return text;
+}
+
+} //namespace nmtools
+
+#endif
@@ -0,0 +1,214 @@
+/*
+   InterfileParser.hpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Single-pass parsing of Interfile headers.
+ */
+
+#ifndef INTERFILEPARSER_HPP
+#define INTERFILEPARSER_HPP
+
+#include <cctype>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/utility/string_ref.hpp>
+
+namespace nmtools {
+
+//One 'key := value' line. key and value are trimmed views into the
+//parsed buffer; the offsets locate the line for in-place rewriting.
+struct InterfileEntry {
+  boost::string_ref key;
+  boost::string_ref value;
+  std::size_t lineBegin = 0;
+  std::size_t valueBegin = 0;  //just after ':='
+  std::size_t lineEnd = 0;     //before the line ending
+};
+
+//Splits an Interfile header into entries in one pass and indexes them by
+//key. Lines may end in \n, \r\n or (as in mMR norm headers) \r\r\n.
+//Lookups ignore case, a leading '!' and repeated spaces, so "!name of
+//data file" is found as "name of data file"; the first occurrence of a
+//key wins. The buffer is not copied and must outlive the parser.
+class InterfileParser {
+
+public:
+
+  InterfileParser(){};
+  explicit InterfileParser(const std::string &buffer){ Parse(buffer); };
+  //Entries point into the buffer: a temporary would leave them dangling.
+  InterfileParser(std::string&&) = delete;
+
+  void Parse(const std::string &buffer);
+  void Parse(std::string&&) = delete;
+
+  const std::vector<InterfileEntry>& GetEntries() const { return _entries; };
+
+  //nullptr if the key is absent.
+  const InterfileEntry* Find(const std::string &key) const;
+
+  bool GetValue(const std::string &key, std::string &value) const;
+
+  //First run of digits in the value (e.g. '123' in ':= 123 words').
+  bool GetUnsigned(const std::string &key, uint64_t &value) const;
+
+  //Every line, as (begin, end before the line ending) offsets.
+  const std::vector< std::pair<std::size_t, std::size_t> >& GetLines() const { return _lines; };
+
+  //Lower case, no leading '!', single spaces.
+  static std::string NormaliseKey(boost::string_ref key);
+
+protected:
+
+  static boost::string_ref Trim(boost::string_ref s);
+
+  std::vector<InterfileEntry> _entries;
+  std::unordered_map<std::string, std::size_t> _index;
+
+  //Line boundaries: (begin, end before line ending).
+  std::vector< std::pair<std::size_t, std::size_t> > _lines;
+
+};
+
+boost::string_ref InterfileParser::Trim(boost::string_ref s){
+
+  while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front())))
+    s.remove_prefix(1);
+  while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back())))
+    s.remove_suffix(1);
+
+  return s;
+}
+
+std::string InterfileParser::NormaliseKey(boost::string_ref key){
+
+  key = Trim(key);
+  if (!key.empty() && key.front() == '!')
+    key = Trim(key.substr(1));
+
+  std::string normalised;
+  normalised.reserve(key.size());
+
+  bool space = false;
+  for (char c : key) {
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      space = true;
+      continue;
+    }
+    if (space && !normalised.empty())
+      normalised += ' ';
+    space = false;
+    normalised += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+
+  return normalised;
+}
+
+void InterfileParser::Parse(const std::string &buffer){
+
+  _entries.clear();
+  _index.clear();
+  _lines.clear();
+
+  const std::size_t n = buffer.size();
+  std::size_t begin = 0;
+
+  while (begin < n) {
+    std::size_t next = buffer.find('\n', begin);
+    if (next == std::string::npos)
+      next = n;
+
+    //Drop any \r before the \n.
+    std::size_t end = next;
+    while (end > begin && buffer[end - 1] == '\r')
+      end--;
+
+    _lines.push_back(std::make_pair(begin, end));
+
+    const boost::string_ref line(buffer.data() + begin, end - begin);
+    const std::size_t separator = line.find(":=");
+
+    if (separator != boost::string_ref::npos) {
+      InterfileEntry entry;
+      entry.key = Trim(line.substr(0, separator));
+      entry.value = Trim(line.substr(separator + 2));
+      entry.lineBegin = begin;
+      entry.valueBegin = begin + separator + 2;
+      entry.lineEnd = end;
+
+      _index.insert(std::make_pair(NormaliseKey(entry.key), _entries.size()));
+      _entries.push_back(entry);
+    }
+
+    begin = next + 1;
+  }
+}
+
+const InterfileEntry* InterfileParser::Find(const std::string &key) const {
+
+  const auto it = _index.find(NormaliseKey(key));
+
+  if (it == _index.end())
+    return nullptr;
+
+  return &_entries[it->second];
+}
+
+bool InterfileParser::GetValue(const std::string &key, std::string &value) const {
+
+  const InterfileEntry *entry = Find(key);
+
+  if (entry == nullptr)
+    return false;
+
+  value.assign(entry->value.data(), entry->value.size());
+
+  return true;
+}
+
+bool InterfileParser::GetUnsigned(const std::string &key, uint64_t &value) const {
+
+  const InterfileEntry *entry = Find(key);
+
+  if (entry == nullptr)
+    return false;
+
+  const boost::string_ref v = entry->value;
+  std::size_t i = 0;
+  while (i < v.size() && !std::isdigit(static_cast<unsigned char>(v[i])))
+    i++;
+
+  if (i == v.size())
+    return false;
+
+  value = 0;
+  for (; i < v.size() && std::isdigit(static_cast<unsigned char>(v[i])); i++) {
+    const uint64_t digit = static_cast<uint64_t>(v[i] - '0');
+    if (value > (std::numeric_limits<uint64_t>::max() - digit) / 10)
+      return false;
+    value = value * 10 + digit;
+  }
+
+  return true;
+}
+
+} //namespace nmtools
+
+#endif
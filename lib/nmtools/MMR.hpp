@@ -24,14 +24,15 @@
 #ifndef MMR_HPP
 #define MMR_HPP
 
+#include <cstdlib>
 #include <memory>
 
 #include <gdcmReader.h>
 #include <boost/filesystem.hpp>
 #include <glog/logging.h>
-#include <boost/regex.hpp>
 
 #include "Common.hpp"
+#include "InterfileHeader.hpp"
 
 namespace nmtools {
 
@@ -44,19 +45,41 @@ public:
 
     //FileType GetFileType( boost::filesystem::path src );
 
+  //Write the header to dst. If a data file name was set, the header
+  //points at it (updated in memory, written once).
   virtual bool ExtractHeader( const boost::filesystem::path dst );
+  bool SetDataFileName( const boost::filesystem::path dataFile);
   bool ModifyHeader( const boost::filesystem::path src, const boost::filesystem::path dataFile);
   //Deal with EOF in norm header.
   std::string CleanUpLineEncoding( std::string );
 
+  //DICOM fields plus isotope, duration, bed position and word counts
+  //from the Interfile header.
+  bool GetMetadata( nlohmann::json &metadata );
+
   virtual ~IMMR(){};
 
 protected:
 
+  //Read the Interfile header from DICOM into _headerString and index it
+  //in _header.
   bool ReadHeader();
 
+  typedef std::vector< std::pair<std::string, std::string> > HeaderUpdates;
+
+  //Keys to change for the header to point at dataFile.
+  virtual HeaderUpdates GetHeaderUpdates( const boost::filesystem::path dataFile ) const;
+
+  //headerString with updates applied and \r\n line endings.
+  bool UpdateHeader( const std::string &headerString, const HeaderUpdates &updates,
+                     std::string &newHeader ) const;
+
   FileStatusCode CheckForSiemensBFFile(boost::filesystem::path src, uint64_t numOfWords);
   std::string _headerString;
+  InterfileParser _header;
+
+  //Data file named in the extracted header, if set.
+  boost::filesystem::path _dataFileName;
 
 };
 
@@ -69,6 +92,11 @@ public:
   bool ExtractData( const boost::filesystem::path dst );
   boost::filesystem::path GetStdFileName( boost::filesystem::path srcFile, ContentType ctype);
 
+protected:
+
+  //'%total listmode word counts' from the header.
+  bool GetExpectedNumberOfWords(uint64_t &numWords) const;
+
 };
 
 class MMRSino : public IMMR {
@@ -92,9 +120,11 @@ public:
 
   bool IsValid();
   bool ExtractData( const boost::filesystem::path dst );
-  bool ModifyHeader( const boost::filesystem::path src, const boost::filesystem::path dataFile);
   boost::filesystem::path GetStdFileName( boost::filesystem::path srcFile, ContentType ctype);
 protected:
+
+  //'%data set [1]' names the data file as well.
+  HeaderUpdates GetHeaderUpdates( const boost::filesystem::path dataFile ) const;
 };
 
 class SiemensPETFactory : public IRawDataFactory{
@@ -104,6 +134,15 @@ public:
 
   FileType GetFileType( boost::filesystem::path src){
 
+    if (!Open(src)) {
+      return FileType::EERROR;
+    }
+
+    return GetFileType(dicomReader->GetFile());
+  }
+
+  FileType GetFileType( const gdcm::File &file ){
+
     //Extracts information via DICOM to determine what kind of mMR
     //raw data type we're dealing with.
     //
@@ -113,12 +152,10 @@ public:
 
     FileType foundFileType = FileType::EUNKNOWN;
 
-    if (!Open(src)) {
+    if (!ReadScannerNames(file)) {
       return FileType::EERROR;
     }
 
-    const gdcm::File &file = dicomReader->GetFile();
-
     if (manufacturerName.find("SIEMENS") != std::string::npos) {
       DLOG(INFO) << "Manufacturer = SIEMENS";
 
@@ -143,7 +180,17 @@ public:
       }
     }
     return foundFileType;
-  }  
+  }
+
+  static const char* GetFileTypeName( FileType fType ){
+    switch (fType) {
+      case FileType::EMMRSINO: return "MMR_SINO";
+      case FileType::EMMRLIST: return "MMR_LIST";
+      case FileType::EMMRNORM: return "MMR_NORM";
+      case FileType::EUNKNOWN: return "UNKNOWN";
+      default: return "ERROR";
+    }
+  }
 private:
   IMMR* Create_ptr( boost::filesystem::path inFile ) {
 
@@ -176,19 +223,12 @@ IMMR::IMMR(boost::filesystem::path src)
   : IDicomExtractor(src)
 {}
 
-//Header extraction
-bool IMMR::ReadHeader() {
-
-  if (!_dicomReader) {
-      LOG(ERROR) << "DICOM reader not initialised. Internal error.";
-      return false;
-  }
-
-  const gdcm::File &file = _dicomReader->GetFile();
+//Interfile header of Siemens raw data, from (0029,1010), or (0029,1110)
+//for SMS-MI v 3.2 (SV10) files.
+bool GetSiemensInterfileHeader(const gdcm::File &file, std::string &headerString) {
 
   const gdcm::Tag headerTag(0x029, 0x1010);
 
-  std::string headerString;
   std::string headerStringTmp;
 
   if (!GetTagInfo(file,headerTag,headerStringTmp)){
@@ -208,41 +248,76 @@ bool IMMR::ReadHeader() {
     headerString = headerStringTmp;
   }
 
-  _headerString = headerString;
+  return headerString.size() > 0;
+}
 
-  if (_headerString.size() > 0)
-    return true;
+//Isotope, duration, bed position and word counts from a Siemens
+//Interfile header. Fields BIDS-PET has are named (and formatted) as in
+//BIDS; the others are prefixed with 'Interfile'.
+void GetSiemensInterfileMetadata(const InterfileParser &header, nlohmann::json &metadata) {
 
-  return false;
-}
+  std::string value;
 
-//Header extraction and writing to file dst.
-bool IMMR::ExtractHeader( const boost::filesystem::path dst ){
+  if (header.GetValue("originating system", value) && !value.empty())
+    metadata["InterfileOriginatingSystem"] = value;
 
-  bool bStatus = false;
+  if (header.GetValue("isotope name", value) && !value.empty())
+    metadata["TracerRadionuclide"] = FormatRadionuclide(value);
 
-  const gdcm::File &file = _dicomReader->GetFile();
-  //const gdcm::DataSet &ds = _dicomReader->GetFile().GetDataSet();
+  if (header.GetValue("%study date (yyyy:mm:dd)", value) && !value.empty())
+    metadata["InterfileStudyDate"] = value;
 
-  const gdcm::Tag headerTag(0x029, 0x1010);
+  if (header.GetValue("%study time (hh:mm:ss GMT+00:00)", value) && !value.empty())
+    metadata["InterfileStudyTime"] = value;
 
-  std::string headerString;
-  std::string headerStringTmp;
+  //Numeric fields, skipped if they do not parse.
+  auto getNumber = [&](const std::string &key, double &number){
+    if (!header.GetValue(key, value) || value.empty())
+      return false;
+    char *end = nullptr;
+    number = std::strtod(value.c_str(), &end);
+    return end != value.c_str();
+  };
 
-  if (!GetTagInfo(file,headerTag,headerStringTmp)){
-    LOG(ERROR) << "Unable to header from " << headerTag;
-    return false;  
-  }
-  //If this is actually a SMS-MI v 3.2 file then get header from 0029,1110.
-  if (headerStringTmp.find("SV10") != std::string::npos) {
-    gdcm::Tag altHeaderTag(0x029, 0x1110);
-    if (!GetTagInfo(file,altHeaderTag,headerString)){
-      LOG(ERROR) << "Unable to header (SV10) from " << altHeaderTag;
-      return false;  
-    }
+  double number = 0.0;
+
+  if (getNumber("isotope gamma halflife (sec)", number))
+    metadata["InterfileIsotopeHalfLife"] = number;
+
+  //BIDS-PET gives frame durations as a list.
+  if (getNumber("image duration (sec)", number) || getNumber("image duration (sec)[1]", number))
+    metadata["FrameDuration"] = { number };
+
+  if (getNumber("start horizontal bed position (mm)", number))
+    metadata["InterfileHorizontalBedPosition"] = number;
+
+  uint64_t words = 0;
+  if (header.GetUnsigned("%total listmode word counts", words))
+    metadata["InterfileListmodeWordCount"] = words;
+}
+
+//Header extraction
+bool IMMR::ReadHeader() {
+
+  if (!_dicomReader) {
+      LOG(ERROR) << "DICOM reader not initialised. Internal error.";
+      return false;
   }
-  else {
-    headerString = headerStringTmp;
+
+  _headerString.clear();
+  const bool bStatus = GetSiemensInterfileHeader(_dicomReader->GetFile(), _headerString);
+  _header.Parse(_headerString);
+
+  return bStatus;
+}
+
+//Header extraction and writing to file dst.
+bool IMMR::ExtractHeader( const boost::filesystem::path dst ){
+
+  //Read once; ExtractData() will usually have done so already.
+  if (_headerString.empty() && !ReadHeader()) {
+    LOG(ERROR) << "Unable to read header from DICOM";
+    return false;
   }
 
   if (boost::filesystem::exists(dst)) {
@@ -251,15 +326,26 @@ bool IMMR::ExtractHeader( const boost::filesystem::path dst ){
       return false;
   }
 
+  std::string newHeader;
+  const std::string *headerString = &_headerString;
+
+  if (!_dataFileName.empty()) {
+    if (!UpdateHeader(_headerString, GetHeaderUpdates(_dataFileName), newHeader))
+      return false;
+    headerString = &newHeader;
+  }
+
+  bool bStatus = false;
+
   std::ofstream outfile(dst.string().c_str(), std::ios::out | std::ios::binary);
   if (!outfile.is_open()) {
     LOG(ERROR) << "Unable to write header to " << dst;
     return false;
   }
   else {
-    outfile << headerString;
+    outfile << *headerString;
     outfile.close();
-    bStatus = true;
+    bStatus = outfile.good();
   }
 
   if (bStatus == true)
@@ -270,6 +356,27 @@ bool IMMR::ExtractHeader( const boost::filesystem::path dst ){
   return bStatus;
 }
 
+bool IMMR::GetMetadata( nlohmann::json &metadata ){
+
+  if (!IDicomExtractor::GetMetadata(metadata))
+    return false;
+
+  if (_headerString.empty() && !ReadHeader()) {
+    LOG(WARNING) << "No Interfile header; metadata from DICOM only";
+    return true;
+  }
+
+  GetSiemensInterfileMetadata(_header, metadata);
+
+  return true;
+}
+
+//Point the extracted header at dataFile.
+bool IMMR::SetDataFileName( const boost::filesystem::path dataFile ){
+  _dataFileName = dataFile;
+  return true;
+}
+
 FileStatusCode IMMR::CheckForSiemensBFFile(boost::filesystem::path src, uint64_t numOfBytes) {
   //Test for existence of associated bf file and if the length is correct
   //according to the Interfile header.
@@ -303,6 +410,23 @@ FileStatusCode IMMR::CheckForSiemensBFFile(boost::filesystem::path src, uint64_t
 
 }
 
+bool MMR32BitList::GetExpectedNumberOfWords(uint64_t &numWords) const {
+
+  const std::string key = "%total listmode word counts";
+
+  if (_header.Find(key) == nullptr) {
+    LOG(INFO) << "No word count tag found in Interfile header";
+    return false;
+  }
+
+  if (!_header.GetUnsigned(key, numWords)) {
+    LOG(INFO) << "No word count number found in Interfile header";
+    return false;
+  }
+
+  return true;
+}
+
 //Extract raw data and write to dst.
 bool MMR32BitList::ExtractData( const boost::filesystem::path dst ){
 
@@ -323,25 +447,9 @@ bool MMR32BitList::ExtractData( const boost::filesystem::path dst ){
 
   const gdcm::DataSet &ds = _dicomReader->GetFile().GetDataSet();
 
-  std::string target = "%total listmode word counts";
-  if (_headerString.find(target) == std::string::npos) {
-    LOG(INFO) << "No word count tag found in Interfile header";
-    return false;
-  }
-
-  std::string lastline = _headerString.substr(_headerString.find(target), _headerString.length());
-  lastline = lastline.substr(0, lastline.find("\n"));
-
-  boost::regex pattern("[0-9]+");
-  boost::smatch result;
-
   uint64_t expectedNoWords = 0;
-  if (boost::regex_search(lastline, result, pattern)) {
-    expectedNoWords = boost::lexical_cast<unsigned long>(result);
-  } else {
-    LOG(INFO) << "No word count number found in Interfile header";
+  if (!GetExpectedNumberOfWords(expectedNoWords))
     return false;
-  }
 
   LOG(INFO) << "Expected number of LM words: " << expectedNoWords;
 
@@ -415,25 +523,9 @@ bool MMR32BitList::IsValid(){
 
   const gdcm::DataSet &ds = _dicomReader->GetFile().GetDataSet();
 
-  std::string target = "%total listmode word counts";
-  if (_headerString.find(target) == std::string::npos) {
-    LOG(INFO) << "No word count tag found in Interfile header";
-    return false;
-  }
-
-  std::string lastline = _headerString.substr(_headerString.find(target), _headerString.length());
-  lastline = lastline.substr(0, lastline.find("\n"));
-
-  boost::regex pattern("[0-9]+");
-  boost::smatch result;
-
   uint64_t expectedNoWords = 0;
-  if (boost::regex_search(lastline, result, pattern)) {
-    expectedNoWords = boost::lexical_cast<unsigned long>(result);
-  } else {
-    LOG(INFO) << "No word count number found in Interfile header";
+  if (!GetExpectedNumberOfWords(expectedNoWords))
     return false;
-  }
 
   LOG(INFO) << "Expected number of LM words: " << expectedNoWords;
 
@@ -687,121 +779,78 @@ bool MMRNorm::IsValid(){
   return bStatus;
 }
 
-//Re-write list mode data file location in header.
-bool IMMR::ModifyHeader(const boost::filesystem::path src, const boost::filesystem::path dataFile){
-
-  std::ifstream headerFile( boost::filesystem::canonical( src ).string().c_str() );
-  std::stringstream buffer;
-  buffer << headerFile.rdbuf();
-
-  headerFile.close();
+IMMR::HeaderUpdates IMMR::GetHeaderUpdates( const boost::filesystem::path dataFile ) const {
+  return { { "name of data file", dataFile.filename().string() } };
+}
 
-  DLOG(INFO) << "Read " << src;
+IMMR::HeaderUpdates MMRNorm::GetHeaderUpdates( const boost::filesystem::path dataFile ) const {
 
-  std::string headerInfo = buffer.str();
+  const std::string name = dataFile.filename().string();
 
-  std::string::size_type pos = 0;
-  std::string target = "name of data file";
+  return { { "%data set [1]", "{0,," + name + "}" },
+           { "name of data file", name } };
+}
 
-  pos = headerInfo.find(target);
-  std::string line = headerInfo.substr(pos,headerInfo.length());
-  std::string::size_type end = std::min(line.find("\n"), line.find("\r"));
-  line = line.substr(0, end);
+//Apply updates to headerString in memory.
+bool IMMR::UpdateHeader( const std::string &headerString, const HeaderUpdates &updates,
+                         std::string &newHeader ) const {
 
-  std::string newLine = "name of data file:=" + dataFile.filename().string();
-  headerInfo.replace(pos,line.length(), newLine);
+  InterfileHeaderBuilder header(headerString);
 
-  std::ofstream outfile( src.string().c_str(), std::ios::out | std::ios::binary);
-
-  if ( ! outfile.is_open() ) {
-      LOG(ERROR) << "Unable to update header in " << src;
+  for (const auto &kv : updates) {
+    if (!header.Has(kv.first)) {
+      LOG(ERROR) << "No '" << kv.first << "' key in Interfile header";
       return false;
+    }
+    header.Set(kv.first, kv.second);
   }
 
-  //Find /r/r/n and replace with /r/n.
-  headerInfo = CleanUpLineEncoding( headerInfo );
-
-  outfile << headerInfo;
-  outfile.close();
+  //\r\n line endings and a final empty line.
+  newHeader = header.ToString("\r\n") + "\r\n";
 
   return true;
-
 }
 
-//Re-write norm data file location in header.
-bool MMRNorm::ModifyHeader(const boost::filesystem::path src, const boost::filesystem::path dataFile){
+//Re-write data file location in an extracted header.
+bool IMMR::ModifyHeader(const boost::filesystem::path src, const boost::filesystem::path dataFile){
 
-  std::ifstream headerFile( boost::filesystem::canonical( src ).string().c_str() );
-  std::stringstream buffer;
-  buffer << headerFile.rdbuf();
-  headerFile.close();
+  std::ifstream headerFile( src.string().c_str(), std::ios::in | std::ios::binary );
 
-  std::string headerInfo = buffer.str();
+  if ( ! headerFile.is_open() ) {
+    LOG(ERROR) << "Unable to read header " << src;
+    return false;
+  }
 
-  std::string::size_type pos = 0;
-  std::string target = "%data set [1]:={0,,";
+  const std::string headerInfo( (std::istreambuf_iterator<char>(headerFile)),
+                                std::istreambuf_iterator<char>() );
+  headerFile.close();
 
-  pos = headerInfo.find(target);
-  std::string line = headerInfo.substr(pos,headerInfo.length());
-  std::string::size_type end = std::min(line.find("\n"), line.find("\r"));
-  line = line.substr(0, end);
+  DLOG(INFO) << "Read " << src;
 
-  std::string newLine = "%data set [1]:={0,," +  dataFile.filename().string() + "}";
-  headerInfo.replace(pos,line.length(), newLine);
+  std::string newHeader;
+  if (!UpdateHeader(headerInfo, GetHeaderUpdates(dataFile), newHeader))
+    return false;
 
   std::ofstream outfile( src.string().c_str(), std::ios::out | std::ios::binary);
 
   if ( ! outfile.is_open() ) {
-      LOG(ERROR) << "Unable to update norm header in " << src;
+      LOG(ERROR) << "Unable to update header in " << src;
       return false;
   }
 
-  //Find /r/r/n and replace with /r/n.
-  headerInfo = CleanUpLineEncoding( headerInfo );
-
-  outfile << headerInfo;
+  outfile << newHeader;
   outfile.close();
 
-  // Also need to run the superclass to update name of data file and run cleanup
-  IMMR::ModifyHeader(src, dataFile);
-
   return true;
-
 }
 
 //Removes \r\r\n line endings in mMR norm header and replaces it with \r\n
 std::string IMMR::CleanUpLineEncoding( const std::string origStr ){
 
-  std::stringstream ss;
-  ss << origStr;
-  std::string outstr;
-
-  std::string line;
-  std::string::size_type pos;
-
-  while (std::getline(ss, line)) {
-      // \r\r -> \r
-      pos = line.find("\r\r");
-      if (pos != std::string::npos) {
-            DLOG(INFO) << "fixed: " << line;
-            line.replace(pos,1,"");
-      } else {
-            DLOG(INFO) << "left:  " << line;
-      }
-
-      // no \r -> \r
-      pos = line.find("\r");
-      if (pos == std::string::npos) {
-            outstr += line + "\r\n";
-      } else {
-            outstr += line + "\n";
-      }
-  }
+  const InterfileHeaderBuilder header(origStr);
 
   //Add carriage return at EOF
-  outstr += "\r\n";
-
-  return outstr;
+  return header.ToString("\r\n") + "\r\n";
 }
 
 //Create destination filename for list mode.
@@ -0,0 +1,517 @@
+/*
+   MRAC-Stitch.hpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Whole-body mu-maps stitched from multi-bed mMR MRAC.
+ */
+
+#ifndef MRAC_STITCH_HPP
+#define MRAC_STITCH_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DicomScanner.hpp"
+#include "MRAC-mMR.hpp"
+
+namespace nmtools {
+
+//The beds are the series in the input directory that share their
+//description, in-plane matrix, voxel size and slice orientation: those
+//with the description given to SetBedDescription(), or else those whose
+//description names a mu-map (UMAP, MU-MAP). The largest such set is
+//taken; if two are as large, or none is found, Read() fails rather than
+//guess (a Dixon contrast scaled as a mu-map would look plausible).
+//Other series are skipped. Beds are resampled slice by slice straight
+//into one mu-map on a grid covering all of them, with the voxel size
+//and orientation of the first bed. The output is built in slice order
+//and each bed is decoded (kept as stored, 16-bit where possible) only
+//when the first slice it covers is reached and released after the last,
+//so at most the beds overlapping one stretch of slices are held at
+//once. Where beds overlap they are blended with weights falling
+//linearly towards each bed's end slices. Smoothing and hardware
+//insertion then apply as for MMRMRAC, and the result is written with
+//MRAC2MU::Write().
+class StitchedMRAC : public MMRMRAC {
+  using MMRMRAC::MMRMRAC;
+
+public:
+  bool Update();
+
+  std::size_t GetNumberOfBeds() const { return _bedSlices.size(); };
+
+  //Take the series with this description (ignoring case) as the beds.
+  void SetBedDescription(const std::string &description) override { _bedDescription = description; };
+
+protected:
+
+  //Find the beds (headers only) and create the Interfile skeleton.
+  bool Read();
+
+  bool ReadBeds();
+
+  //Blend the beds into _muImage (and _stats), decoding each in turn.
+  bool Stitch();
+
+  template <class TImage>
+  bool StitchBeds();
+
+  //Slices (sorted) and geometry (no buffer) of each bed.
+  std::vector< std::vector<DicomSliceInfo> > _bedSlices;
+  std::vector<typename MuMapImageType::Pointer> _bedGeometries;
+
+  //Beds are decoded as 16-bit integers unless one does not fit.
+  bool _useIntegerBeds = false;
+
+  std::string _bedDescription;
+
+};
+
+//Run pipeline
+bool StitchedMRAC::Update(){
+
+  if (!Read()){
+    LOG(ERROR) << "Reading failed!!";
+    return false;
+  }
+
+  if (!Stitch())
+    return false;
+
+  if (!PostProcess())
+    return false;
+
+  FillInterfileHeader();
+
+  return true;
+}
+
+bool StitchedMRAC::Read(){
+
+  if (!ReadBeds())
+    return false;
+
+  CreateInterfileHeader();
+
+  return true;
+}
+
+//Same description, in-plane matrix, voxel size and slice orientation:
+//possibly beds of one study.
+bool IsSameBedSeries(const DicomSliceInfo &a, const DicomSliceInfo &b){
+
+  bool bSame = a.seriesDescription == b.seriesDescription &&
+               a.columns == b.columns && a.rows == b.rows;
+  for (unsigned int k = 0; k < 2; k++)
+    bSame = bSame && std::fabs(a.spacing[k] - b.spacing[k]) <= 1e-3 * a.spacing[k];
+  for (unsigned int k = 0; k < 6; k++)
+    bSame = bSame && std::fabs(a.orientation[k] - b.orientation[k]) <= 1e-3;
+
+  return bSame;
+}
+
+//Upper-case copy of text.
+std::string ToUpperCase(std::string text){
+  std::transform(text.begin(), text.end(), text.begin(),
+                 [](unsigned char c){ return static_cast<char>(std::toupper(c)); });
+  return text;
+}
+
+//Series description of an mMR MRAC mu-map (e.g. 'Head_MRAC_PET_UMAP',
+//'MRAC_1_UMAP', 'mu-map'). 'MRAC' alone is not enough: the Dixon
+//contrasts are named 'MRAC_..._in', '..._opp', '..._W' and '..._F'.
+bool IsMuMapDescription(const std::string &description){
+
+  const std::string upper = ToUpperCase(description);
+  return upper.find("UMAP") != std::string::npos || upper.find("MU-MAP") != std::string::npos ||
+         upper.find("MUMAP") != std::string::npos;
+}
+
+//Scan once for all series and pick out the beds. Nothing is decoded.
+bool StitchedMRAC::ReadBeds(){
+
+  std::unique_ptr<ThreadPool> localPool;
+  ThreadPool *pool = _pool;
+  if (pool == nullptr) {
+    localPool.reset(new ThreadPool);
+    pool = localPool.get();
+  }
+
+  DicomSeriesScanner scanner;
+  scanner.SetDirectory(_srcPath);
+  scanner.SetCacheDirectory(_cachePath);
+  scanner.SetThreadPool(pool);
+
+  if (!scanner.Update()){
+    LOG(ERROR) << "Cannot read DICOM directory!";
+    return false;
+  }
+
+  const std::vector<std::string> seriesIds = scanner.GetSeriesIdentifiers();
+
+  if (seriesIds.empty()){
+    LOG(ERROR) << "No valid DICOM series found";
+    return false;
+  }
+
+  _bedSlices.clear();
+  _bedGeometries.clear();
+  _useIntegerBeds = _useIntegerPipeline;
+
+  //Group the series by description and plane.
+  std::vector< std::vector<std::string> > groups;
+
+  for (const std::string &id : seriesIds) {
+
+    const std::vector<DicomSliceInfo> &slices = scanner.GetSlices(id);
+
+    std::size_t g = 0;
+    while (g < groups.size() && !IsSameBedSeries(scanner.GetSlices(groups[g][0])[0], slices[0]))
+      g++;
+
+    if (g == groups.size())
+      groups.push_back(std::vector<std::string>());
+
+    groups[g].push_back(id);
+  }
+
+  //Candidate groups: the description asked for, else mu-map series.
+  std::vector<std::size_t> candidates;
+  for (std::size_t g = 0; g < groups.size(); g++) {
+    const std::string &groupDescription = scanner.GetSlices(groups[g][0])[0].seriesDescription;
+    if (_bedDescription.empty() ? IsMuMapDescription(groupDescription)
+                                : ToUpperCase(groupDescription) == ToUpperCase(_bedDescription))
+      candidates.push_back(g);
+  }
+
+  if (candidates.empty()) {
+    if (_bedDescription.empty())
+      LOG(ERROR) << "No mu-map (UMAP) series to stitch; give the bed series description";
+    else
+      LOG(ERROR) << "No series described as '" << _bedDescription << "' to stitch";
+    return false;
+  }
+
+  std::size_t best = candidates[0];
+  bool bTie = false;
+  for (std::size_t i = 1; i < candidates.size(); i++) {
+    const std::size_t g = candidates[i];
+    if (groups[g].size() > groups[best].size()) {
+      best = g;
+      bTie = false;
+    }
+    else if (groups[g].size() == groups[best].size())
+      bTie = true;
+  }
+
+  if (bTie) {
+    LOG(ERROR) << "Several sets of " << groups[best].size()
+               << " series could be the beds; give the bed series description:";
+    for (std::size_t g : candidates)
+      LOG(ERROR) << "  " << scanner.GetSlices(groups[g][0])[0].seriesDescription
+                 << " (" << groups[g].size() << " series)";
+    return false;
+  }
+
+  const std::string description = scanner.GetSlices(groups[best][0])[0].seriesDescription;
+
+  for (std::size_t g = 0; g < groups.size(); g++) {
+    if (g == best)
+      continue;
+    for (const std::string &id : groups[g]) {
+      const DicomSliceInfo &first = scanner.GetSlices(id)[0];
+      LOG(WARNING) << "Skipping series " << id << " (" << first.seriesDescription << ", "
+                   << first.columns << "x" << first.rows << "), not a bed of " << description;
+    }
+  }
+
+  for (const std::string &id : groups[best]) {
+
+    std::vector<DicomSliceInfo> slices = scanner.GetSlices(id);
+
+    SortSlices(slices);
+
+    MuMapImageType::Pointer geometry = MuMapImageType::New();
+    if (!SetSeriesGeometry(slices, geometry.GetPointer())) {
+      LOG(ERROR) << "Unable to read bed " << _bedSlices.size() + 1 << " (" << id << ")";
+      return false;
+    }
+
+    _useIntegerBeds = _useIntegerBeds && FitsInt16(slices);
+    _bedSlices.push_back(slices);
+    _bedGeometries.push_back(geometry);
+  }
+
+  LOG(INFO) << "Stitching " << _bedSlices.size() << " bed(s) of " << description;
+
+  return ReadDicomInfo(_bedSlices[0][0].fileName);
+}
+
+bool StitchedMRAC::Stitch(){
+
+  if (_useIntegerBeds)
+    return StitchBeds<MRACImageType>();
+
+  return StitchBeds<MuMapImageType>();
+}
+
+template <class TImage>
+bool StitchedMRAC::StitchBeds(){
+
+  typedef typename TImage::PixelType PixelType;
+
+  const std::size_t numBeds = _bedSlices.size();
+
+  //Each bed as it is in the output orientation (no copies).
+  std::vector<AxisMapping> mappings(numBeds);
+  std::vector<typename MuMapImageType::Pointer> geometries(numBeds);
+
+  for (std::size_t b = 0; b < numBeds; b++) {
+    mappings[b] = ComputeAxisMapping(_bedGeometries[b]->GetDirection(), _outputOrientation);
+    geometries[b] = GetMappedGeometry<MuMapImageType>(_bedGeometries[b].GetPointer(), mappings[b]);
+  }
+
+  //Output grid: the first bed's voxels, extended to cover every bed.
+  const MuMapImageType *reference = geometries[0].GetPointer();
+  const MuMapImageType::SpacingType &spacing = reference->GetSpacing();
+  const MuMapImageType::DirectionType &direction = reference->GetDirection();
+
+  double lower[3] = {0.0, 0.0, 0.0};
+  double upper[3] = {0.0, 0.0, 0.0};
+
+  for (std::size_t b = 0; b < numBeds; b++) {
+    const MuMapImageType *geometry = geometries[b].GetPointer();
+
+    for (unsigned int k = 0; k < 3; k++) {
+      if (std::fabs(geometry->GetSpacing()[k] - spacing[k]) > 1e-3 * spacing[k]) {
+        LOG(ERROR) << "Bed " << b + 1 << " has a different voxel size from bed 1!";
+        return false;
+      }
+      for (unsigned int r = 0; r < 3; r++) {
+        if (std::fabs(geometry->GetDirection()[r][k] - direction[r][k]) > 1e-3) {
+          LOG(ERROR) << "Bed " << b + 1 << " has a different orientation from bed 1!";
+          return false;
+        }
+      }
+    }
+
+    itk::ContinuousIndex<double, 3> start;
+    reference->TransformPhysicalPointToContinuousIndex(geometry->GetOrigin(), start);
+
+    for (unsigned int k = 0; k < 3; k++) {
+      const double last = start[k] + geometry->GetBufferedRegion().GetSize()[k] - 1.0;
+      lower[k] = b == 0 ? start[k] : std::min(lower[k], start[k]);
+      upper[k] = b == 0 ? last : std::max(upper[k], last);
+    }
+  }
+
+  MuMapImageType::SizeType size;
+  itk::ContinuousIndex<double, 3> first;
+  for (unsigned int k = 0; k < 3; k++) {
+    first[k] = std::floor(lower[k] + 0.5);
+    size[k] = static_cast<std::size_t>(std::floor(upper[k] + 0.5) - first[k]) + 1;
+  }
+
+  MuMapImageType::PointType origin;
+  reference->TransformContinuousIndexToPhysicalPoint(first, origin);
+
+  MuMapImageType::RegionType region;
+  region.SetSize(size);
+
+  _muImage = MuMapImageType::New();
+  _muImage->SetRegions(region);
+  _muImage->SetSpacing(spacing);
+  _muImage->SetOrigin(origin);
+  _muImage->SetDirection(direction);
+
+  try {
+    _muImage->Allocate();
+  } catch (itk::ExceptionObject &ex){
+    LOG(ERROR) << "Unable to allocate whole-body mu-map!";
+    return false;
+  }
+
+  LOG(INFO) << "Whole-body grid: " << size[0] << "x" << size[1] << "x" << size[2];
+
+  const std::size_t nx = size[0];
+  const std::size_t ny = size[1];
+  const std::size_t nz = size[2];
+  const std::size_t sliceSize = nx * ny;
+
+  //Linear sampling of each bed along each output axis, and the output
+  //slices [zBegin, zEnd) each bed covers.
+  std::vector< std::vector<AxisSampling> > tables(numBeds, std::vector<AxisSampling>(3));
+  std::vector<std::size_t> zBegin(numBeds, nz), zEnd(numBeds, 0);
+
+  for (std::size_t b = 0; b < numBeds; b++) {
+    itk::ContinuousIndex<double, 3> start;
+    geometries[b]->TransformPhysicalPointToContinuousIndex(origin, start);
+
+    for (unsigned int k = 0; k < 3; k++)
+      tables[b][k] = ComputeLinearSampling(geometries[b]->GetBufferedRegion().GetSize()[k], size[k],
+                                           start[k], spacing[k] / geometries[b]->GetSpacing()[k]);
+
+    for (std::size_t z = 0; z < nz; z++) {
+      if (tables[b][2].inside[z]) {
+        zBegin[b] = std::min(zBegin[b], z);
+        zEnd[b] = z + 1;
+      }
+    }
+  }
+
+  //The output is built in stretches of slices covered by the same beds.
+  std::vector<std::size_t> bounds = { 0, nz };
+  for (std::size_t b = 0; b < numBeds; b++) {
+    bounds.push_back(std::min(zBegin[b], nz));
+    bounds.push_back(zEnd[b]);
+  }
+  std::sort(bounds.begin(), bounds.end());
+  bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+  std::unique_ptr<ThreadPool> localPool;
+  ThreadPool *pool = _pool;
+  if (pool == nullptr) {
+    localPool.reset(new ThreadPool);
+    pool = localPool.get();
+  }
+
+  std::vector<typename TImage::Pointer> beds(numBeds);
+  std::vector< VolumeView<PixelType> > views(numBeds);
+
+  const unsigned int numThreads = GetDefaultNumberOfThreads();
+  std::vector<PartialStatistics> partials(numThreads);
+
+  for (std::size_t s = 0; s + 1 < bounds.size(); s++) {
+
+    const std::size_t zFirst = bounds[s];
+    const std::size_t zLast = bounds[s + 1];
+
+    //Decode the beds this stretch needs that are not held yet, together.
+    std::vector<std::size_t> toLoad;
+    for (std::size_t b = 0; b < numBeds; b++)
+      if (zBegin[b] < zLast && zEnd[b] > zFirst && beds[b].GetPointer() == nullptr)
+        toLoad.push_back(b);
+
+    if (!toLoad.empty()) {
+      std::vector<char> loaded(toLoad.size(), 0);
+
+      ParallelFor(0, toLoad.size(), [&](std::size_t first, std::size_t last, unsigned int){
+        for (std::size_t i = first; i < last; i++)
+          loaded[i] = LoadSeries<TImage>(_bedSlices[toLoad[i]], pool, beds[toLoad[i]]);
+      }, static_cast<unsigned int>(toLoad.size()));
+
+      for (std::size_t i = 0; i < toLoad.size(); i++) {
+        if (!loaded[i]){
+          LOG(ERROR) << "Unable to read bed " << toLoad[i] + 1;
+          return false;
+        }
+        views[toLoad[i]] = MakeMappedView(beds[toLoad[i]].GetPointer(), mappings[toLoad[i]]);
+        DLOG(INFO) << "Decoded bed " << toLoad[i] + 1;
+      }
+    }
+
+    //Output slices are independent: each one is blended from the beds
+    //covering it, in per-thread slice buffers, and written once.
+    ParallelFor(zFirst, zLast, [&](std::size_t zStart, std::size_t zStop, unsigned int chunk){
+
+      std::vector<float> sum(sliceSize);
+      std::vector<float> weight(sliceSize);
+
+      for (std::size_t z = zStart; z < zStop; z++) {
+
+        std::fill(sum.begin(), sum.end(), 0.0f);
+        std::fill(weight.begin(), weight.end(), 0.0f);
+
+        for (std::size_t b = 0; b < numBeds; b++) {
+
+          const AxisSampling &tx = tables[b][0];
+          const AxisSampling &ty = tables[b][1];
+          const AxisSampling &tz = tables[b][2];
+
+          if (!tz.inside[z])
+            continue;
+
+          //Feathering: distance (in slices) from the nearer end of the bed.
+          const std::ptrdiff_t lastSlice = static_cast<std::ptrdiff_t>(views[b].size[2]) - 1;
+          const double position = tz.index[2*z] + tz.weight[2*z + 1] *
+                                  static_cast<double>(tz.index[2*z + 1] - tz.index[2*z]);
+          const float bedWeight = static_cast<float>(
+            std::max(0.0, std::min(position, lastSlice - position)) + 1.0);
+
+          const VolumeView<PixelType> &view = views[b];
+          const PixelType *planes[2] = { view.data + tz.index[2*z] * view.stride[2],
+                                         view.data + tz.index[2*z + 1] * view.stride[2] };
+          const float wz[2] = { tz.weight[2*z], tz.weight[2*z + 1] };
+
+          for (std::size_t y = 0; y < ny; y++) {
+            if (!ty.inside[y])
+              continue;
+
+            float *sumRow = &sum[y * nx];
+            float *weightRow = &weight[y * nx];
+
+            for (unsigned int t = 0; t < 4; t++) {
+              const float w = wz[t / 2] * ty.weight[2*y + t % 2];
+              if (w == 0.0f)
+                continue;
+
+              const PixelType *row = planes[t / 2] + ty.index[2*y + t % 2] * view.stride[1];
+
+              for (std::size_t x = 0; x < nx; x++) {
+                if (!tx.inside[x])
+                  continue;
+                const float v = tx.weight[2*x] * static_cast<float>(row[tx.index[2*x] * view.stride[0]]) +
+                                tx.weight[2*x + 1] * static_cast<float>(row[tx.index[2*x + 1] * view.stride[0]]);
+                sumRow[x] += bedWeight * w * v;
+              }
+            }
+
+            for (std::size_t x = 0; x < nx; x++)
+              if (tx.inside[x])
+                weightRow[x] += bedWeight;
+          }
+        }
+
+        float *out = _muImage->GetBufferPointer() + z * sliceSize;
+
+        for (std::size_t i = 0; i < sliceSize; i++)
+          out[i] = weight[i] > 0.0f ? sum[i] / (weight[i] * 10000.0f) : 0.0f;
+
+        partials[chunk].Add(out, sliceSize, _stats);
+      }
+    }, numThreads);
+
+    //Release the beds that end in this stretch.
+    for (std::size_t b = 0; b < numBeds; b++) {
+      if (zEnd[b] <= zLast && beds[b].GetPointer() != nullptr) {
+        beds[b] = nullptr;
+        views[b] = VolumeView<PixelType>();
+        DLOG(INFO) << "Released bed " << b + 1;
+      }
+    }
+  }
+
+  MergeStatistics(partials, _stats);
+
+  return true;
+}
+
+} //namespace nmtools
+
+#endif
@@ -22,31 +22,32 @@
 #ifndef MRAC_HPP
 #define MRAC_HPP
 
+#include <cmath>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <itkImage.h>
-#include <itkImageSeriesReader.h>
+#include <itkImageFileReader.h>
 #include <itkImageFileWriter.h>
-#include <itkImageDuplicator.h>
 #include <itkGDCMImageIO.h>
-#include <itkGDCMSeriesFileNames.h>
-#include <itkResampleImageFilter.h>
-#include <itkIdentityTransform.h>
-#include <itkLinearInterpolateImageFunction.h>
-#include <itkConstantPadImageFilter.h>
-#include <itkCropImageFilter.h>
-#include <itkDivideImageFilter.h>
-#include <itkOrientImageFilter.h>
-#include <itkMinimumMaximumImageCalculator.h>
 
 #include <glog/logging.h>
 
 #include <boost/filesystem.hpp>
-#include <boost/any.hpp>
-#include <boost/lexical_cast.hpp>
 
 #include "nmtools/Common.hpp"
+#include "nmtools/DicomScanner.hpp"
+#include "nmtools/DicomSeries.hpp"
+#include "nmtools/Interfile.hpp"
+#include "nmtools/MuMapKernels.hpp"
+#include "nmtools/Nifti.hpp"
+#include "nmtools/Orientation.hpp"
+#include "nmtools/Resample.hpp"
+#include "nmtools/Registration.hpp"
+#include "nmtools/Smoothing.hpp"
+#include "nmtools/Truncation.hpp"
 #include "json/json.hpp"
 
 namespace nmtools {
@@ -54,6 +55,121 @@ namespace nmtools {
 //All images are 3D 32-bit float ITK images.
 typedef typename itk::Image<float, 3 >  MuMapImageType;
 
+//MRAC series are kept as stored (16-bit) until they are scaled.
+typedef typename itk::Image<short, 3 >  MRACImageType;
+
+//Default parameters for reslicing
+//FOV = 700mm; voxel size = [2.09,2.09,2.03];
+//Matrix size: [344,344,127].
+const nlohmann::json resliceDefaultParams = R"(
+{
+  "FOV": 700.0,
+  "px": 2.08626,
+  "py": 2.08626,
+  "pz": 2.03125,
+  "sx": 344,
+  "sy": 344,
+  "sz": 127
+}
+)"_json;
+
+//Output grid for head reslicing, in the output orientation.
+struct ReslicingGrid {
+  MuMapImageType::SizeType size;
+  MuMapImageType::SpacingType spacing;
+  MuMapImageType::PointType origin;
+
+  //Voxels outside this region are zero (if useSupport).
+  MuMapImageType::RegionType support;
+  bool useSupport = false;
+
+  //Transaxial FOV diameter (mm). 0 = none.
+  double fovDiameter = 0.0;
+};
+
+//True if value is a number > 0 (and an integer if isInteger).
+bool IsPositiveNumber(const nlohmann::json &value, bool isInteger = false){
+
+  if (isInteger)
+    return value.is_number_integer() && value.get<long>() > 0;
+
+  return value.is_number() && value.get<double>() > 0.0;
+}
+
+//True if params[key] is an array of three numbers (all > 0 if positive).
+bool IsTriplet(const nlohmann::json &params, const std::string &key, bool positive,
+               bool isInteger = false){
+
+  if (!params.count(key) || !params.at(key).is_array() || params.at(key).size() != 3)
+    return false;
+
+  for (const nlohmann::json &v : params.at(key)) {
+    if (positive ? !IsPositiveNumber(v, isInteger) : !v.is_number())
+      return false;
+  }
+
+  return true;
+}
+
+//Check reslicing params before any work is done. Two forms are accepted:
+//- legacy mMR head grid: "px", "py", "pz" (voxel size, mm) and "sx",
+//  "sy" (x-y matrix size); slices are cropped as for the mMR head.
+//- "mode": "geometry": "size" [nx, ny, nz] and "spacing" [mm x 3] of the
+//  output grid, with optional "origin" [mm x 3] (first voxel, physical
+//  coordinates; default centres the grid on the input) and "FOV"
+//  (transaxial diameter about the scanner axis, physical x = y = 0, mm;
+//  voxels outside are zero).
+bool ValidateReslicingParams(const nlohmann::json &params){
+
+  if (!params.is_object()) {
+    LOG(ERROR) << "Reslicing params must be a JSON object!";
+    return false;
+  }
+
+  const std::string mode = params.value("mode", std::string("mmr-head"));
+
+  if (mode == "geometry") {
+    if (!IsTriplet(params, "size", true, true)) {
+      LOG(ERROR) << "Reslicing params: 'size' must be three positive integers";
+      return false;
+    }
+    if (!IsTriplet(params, "spacing", true)) {
+      LOG(ERROR) << "Reslicing params: 'spacing' must be three positive numbers (mm)";
+      return false;
+    }
+    if (params.count("origin") && !IsTriplet(params, "origin", false)) {
+      LOG(ERROR) << "Reslicing params: 'origin' must be three numbers (mm)";
+      return false;
+    }
+    if (params.count("FOV") && !IsPositiveNumber(params.at("FOV"))) {
+      LOG(ERROR) << "Reslicing params: 'FOV' must be a positive number (mm)";
+      return false;
+    }
+    return true;
+  }
+
+  if (mode != "mmr-head") {
+    LOG(ERROR) << "Unknown reslicing mode: " << mode << " (expected geometry or mmr-head)";
+    return false;
+  }
+
+  for (const char *key : { "px", "py", "pz" }) {
+    if (!params.count(key) || !IsPositiveNumber(params.at(key))) {
+      LOG(ERROR) << "Reslicing params: '" << key << "' must be a positive number (mm)";
+      return false;
+    }
+  }
+
+  for (const char *key : { "sx", "sy" }) {
+    if (!params.count(key) || !IsPositiveNumber(params.at(key), true)) {
+      LOG(ERROR) << "Reslicing params: '" << key << "' must be a positive integer";
+      return false;
+    }
+  }
+
+  return true;
+}
+
 class MRAC2MU {
   //Class for converting from mMR MRAC to mu values.
 
@@ -67,15 +183,73 @@ public:
   explicit MRAC2MU(boost::filesystem::path src, std::string orientationCode);
   MRAC2MU(boost::filesystem::path src, nlohmann::json params, std::string orientationCode);
 
+  //Converters are held and deleted through base class pointers.
+  virtual ~MRAC2MU(){};
+
   //Set input file and attempt to read.
   bool SetInput(boost::filesystem::path src);
 
-  //Accept alternative reslicing parameters.
-  void SetParams(nlohmann::json params);
+  //Accept alternative reslicing parameters (see ValidateReslicingParams()).
+  //Returns false, keeping the current ones, if they are invalid.
+  bool SetParams(nlohmann::json params);
 
   //Toggle whether mMR head or not.
   void SetIsHead(bool bStatus){ _isHead = bStatus; };
 
+  //Cache directory scans here (optional).
+  void SetCacheDirectory(boost::filesystem::path dir){ _cachePath = dir; };
+
+  //Convert this series rather than the first one in the directory.
+  void SetSeries(const std::vector<DicomSliceInfo> &slices){ _slices = slices; };
+
+  //Scan and decode on this pool rather than creating one per read.
+  void SetThreadPool(ThreadPool *pool){ _pool = pool; };
+
+  //Keep 16-bit series as integers until the final scale (default), or
+  //always convert to float on load.
+  void SetUseIntegerPipeline(bool bStatus){ _useIntegerPipeline = bStatus; };
+
+  //gzip level (0-9) for .nii.gz output. Default is zlib's (6).
+  void SetCompressionLevel(int level){ _compressionLevel = level; };
+
+  //Kernel for head reslicing. Default is linear.
+  void SetInterpolation(Interpolation interp){ _interpolation = interp; };
+
+  //Gaussian smoothing (FWHM in mm) of the final mu-map, e.g. to match
+  //PET resolution. Default is 0 (none).
+  void SetSmoothing(double fwhm){ _smoothingFWHM = fwhm; };
+
+  //Rigidly align the mu-map to this non-attenuation corrected PET image
+  //(any format ITK reads) before the other post-processing stages. Off
+  //by default.
+  void SetRegistrationTarget(const boost::filesystem::path &nacPath){ _registrationTarget = nacPath; };
+
+  //Fill body regions truncated by the MR field of view, using the outline
+  //of this NAC PET image or body template (see TruncationCompletion) above
+  //threshold times its maximum. Off by default.
+  void SetTruncationCompletion(const boost::filesystem::path &outlinePath, double threshold = 0.1){
+    _truncationOutline = outlinePath;
+    _truncationThreshold = threshold;
+  };
+
+  //Add a hardware mu-map template (e.g. table or head coil) to the output.
+  //Only scanners with templates support this; by default it is ignored
+  //with a warning.
+  virtual void AddHardwareMuMap(const boost::filesystem::path &templatePath){
+    LOG(WARNING) << "Hardware mu-maps are not supported here, ignoring " << templatePath;
+  };
+
+  //Table position (mm) used to place hardware templates.
+  virtual void SetBedPosition(double){};
+
+  //Series description of the beds, for converters that stitch them.
+  virtual void SetBedDescription(const std::string &){};
+
+  //Request a histogram of the mu-map, gathered during scaling.
+  void SetHistogram(std::size_t bins, float minVal, float maxVal){
+    _stats.SetHistogram(bins, minVal, maxVal);
+  };
+
   //Trigger execution
   virtual bool Update();
 
@@ -85,6 +259,9 @@ public:
   //Get manufactured Interfile header. 
   std::string GetInterfileHdr() const;
 
+  //Min/max (and optional histogram) of the final image.
+  const MuMapStatistics& GetStatistics() const { return _stats; };
+
   //Write file(s) to dst.
   bool Write(boost::filesystem::path dst);
 
@@ -93,28 +270,94 @@ protected:
   //File reading
   virtual bool Read();
 
+  //Load the first series in _srcPath into _rawImage or _inputImage.
+  bool ReadSeries();
+
+  //Study info. (date, time) from the header of one DICOM file.
+  bool ReadDicomInfo(const std::string &fileName);
+
+  //Interfile header with placeholders for FillInterfileHeader().
+  void CreateInterfileHeader();
+
+  //Decode slices into a volume of type TImage, as stored.
+  template <class TImage>
+  bool LoadSeries(const std::vector<DicomSliceInfo> &slices, ThreadPool *pool,
+                  typename TImage::Pointer &output);
+
+  //Scale whichever input image is held into _muImage, gathering _stats.
+  bool ScaleInput();
+
+  template <class TInputImage>
+  bool ScaleAndOrient(const TInputImage *input);
+
 //Do reslicing etc.
   bool Scale();
   bool ScaleAndResliceHead();
 
+  //Single-pass resample, scale, pad and crop into the head matrix
+  //described by params.
+  bool GenerateHeadMuMap(const nlohmann::json &params);
+
+  //As GenerateHeadMuMap(), sampling the head matrix through the
+  //registration so the data are interpolated once.
+  bool GenerateRegisteredHeadMuMap(const nlohmann::json &params);
+
+  template <class TInputImage>
+  bool GenerateHeadMuMap(const TInputImage *input, const nlohmann::json &params);
+
+  //Output grid for GenerateHeadMuMap() from input's geometry (in the
+  //output orientation) and params.
+  bool ComputeLegacyHeadGrid(const MuMapImageType *input, const nlohmann::json &params,
+                             ReslicingGrid &grid);
+  bool ComputeTargetGrid(const MuMapImageType *input, const nlohmann::json &params,
+                         ReslicingGrid &grid);
+
+  //Stages applied to the final _muImage before its header is filled.
+  //Default: registration, truncation completion, then smoothing, each
+  //if requested.
+  virtual bool PostProcess();
+
+  //Register _muImage to the NAC PET image and resample it once with the
+  //result, updating _stats. Nothing is done if the head matrix was
+  //already sampled through the registration.
+  bool Register();
+
+  //Rigid transform from the NAC PET image's space to _muImage's.
+  bool ComputeRegistration(RigidTransform &transform);
+
+  //Fill truncated regions of _muImage if requested, updating _stats.
+  bool CompleteTruncation();
+
+  //Smooth _muImage in place if requested, updating _stats.
+  bool Smooth();
+
   //Write interfile case.
   bool WriteToInterFile(boost::filesystem::path dst);
 
-  //Modify header 
-  bool UpdateInterfile(const std::string &key, const boost::any info);
+  //Write .nii.gz case, compressing on several threads.
+  bool WriteToCompressedNifti(boost::filesystem::path dst);
+
+  //Fill sizes, min/max and study info. into the Interfile header.
+  void FillInterfileHeader();
 
   //Grab info from DICOM data.
   bool GetStudyDate(std::string &studyDate);
   bool GetStudyTime(std::string &studyTime);
 
-  //Original image
+  //Original image, if read as float
   typename MuMapImageType::Pointer _inputImage;
 
+  //Original image, if read as 16-bit integers
+  typename MRACImageType::Pointer _rawImage;
+
   //Output image
   typename MuMapImageType::Pointer _muImage;
 
+  //Statistics of _muImage
+  MuMapStatistics _stats;
+
   //Interfile header
-  std::string _header;
+  InterfileHeaderBuilder _header;
 
   //DICOM data
   typename ImageIOType::Pointer _pDicomInfo;
@@ -122,13 +365,46 @@ protected:
   //Source path
   boost::filesystem::path _srcPath;
 
+  //Directory scan cache (empty = no caching)
+  boost::filesystem::path _cachePath;
+
+  //Slices of the series to convert
+  std::vector<DicomSliceInfo> _slices;
+
+  //Shared pool for scanning/decoding (optional)
+  ThreadPool *_pool = nullptr;
+
+  //gzip level for .nii.gz output
+  int _compressionLevel = Z_DEFAULT_COMPRESSION;
+
+  //Load 16-bit series without converting to float
+  bool _useIntegerPipeline = true;
+
+  //Reslicing kernel
+  Interpolation _interpolation = Interpolation::Linear;
+
+  //Smoothing FWHM (mm), 0 = none
+  double _smoothingFWHM = 0.0;
+
+  //NAC PET image to register to (empty = none)
+  boost::filesystem::path _registrationTarget;
+  bool _isRegistered = false;
+
+  //Body outline for truncation completion (empty = none)
+  boost::filesystem::path _truncationOutline;
+  double _truncationThreshold = 0.1;
+
   //JSON params for reslicing.
-  nlohmann::json _params;
+  nlohmann::json _params = resliceDefaultParams;
 
   //Default image orientation is RAI
   itk::SpatialOrientation::ValidCoordinateOrientationFlags _outputOrientation 
     = itk::SpatialOrientation::ITK_COORDINATE_ORIENTATION_RAI;
 
+  //Input axes to output axes. Applied when the input is first read
+  //(scaling or reslicing), not as a separate pass.
+  AxisMapping _axisMapping;
+
   //Reslice and crop into 344x344 matrix for brain. Off by default.
   bool _isHead = false;
 
@@ -163,7 +439,9 @@ MRAC2MU::MRAC2MU(boost::filesystem::path src, nlohmann::json params, std::string
     throw false;
   }
 
-  _params = params;
+  if (!SetParams(params))
+    throw false;
+
   DLOG(INFO) << "JSON = " << std::setw(4) << _params;
 }
 
@@ -192,10 +470,14 @@ bool MRAC2MU::SetInput(boost::filesystem::path src){
 }
 
 //Use user-specified reslicing parameters.
-void MRAC2MU::SetParams(nlohmann::json params){
-  //TODO: validate JSON inputs (11/12/2017)
+bool MRAC2MU::SetParams(nlohmann::json params){
+
+  if (!ValidateReslicingParams(params))
+    return false;
 
   _params = params;
+
+  return true;
 }
 
 //Run pipeline
@@ -211,235 +493,216 @@ const typename MuMapImageType::Pointer MRAC2MU::GetOutput(){
 
 //Return header.
 std::string MRAC2MU::GetInterfileHdr() const {
-  return _header;
+  return _header.ToString();
 }
 
-//- Reads input directory with GDCM (via ITK).
-//- Creates image from slices and orients to LPS.
-//- Creates Interfile skeleton.
-bool MRAC2MU::Read(){
+//Study info. only needs the header of one slice.
+bool MRAC2MU::ReadDicomInfo(const std::string &fileName){
 
-  //Generic DICOM to ITK image read.
-  //Will only convert first series in a folder.
+  _pDicomInfo = ImageIOType::New();
 
-  DLOG(INFO) << "Reading DICOMDIR";
+  _pDicomInfo->SetMaxSizeLoadEntry(0xffffffffffffffff);
+  _pDicomInfo->SetLoadPrivateTags(true);
+  _pDicomInfo->SetLoadSequences(true);
+  //_pDicomInfo->SetLoadPrivateTagsDefault(true);
 
-  if (!boost::filesystem::exists(_srcPath))
+  try
   {
-    LOG(ERROR) << "Input path " << _srcPath << " does not exist!";
+    _pDicomInfo->SetFileName(fileName);
+    _pDicomInfo->ReadImageInformation();
+  }
+  catch (itk::ExceptionObject &ex)
+  {
+    //std::cout << ex << std::endl;
+    LOG(ERROR) << "Cannot read DICOM header!";
     return false;
   }
 
-  _pDicomInfo = ImageIOType::New();
+  return true;
+}
 
-  typedef itk::GDCMSeriesFileNames NamesGeneratorType;
-  NamesGeneratorType::Pointer nameGenerator = NamesGeneratorType::New();
+//- Finds the first series in the input directory (unless a series
+//  was given with SetSeries()).
+//- Decodes its slices concurrently into a single volume.
+//- Works out how to index it in the requested orientation. The volume
+//  itself is reordered later, by the stage that reads it.
+bool MRAC2MU::ReadSeries(){
 
-  nameGenerator->SetUseSeriesDetails(true);
-  nameGenerator->AddSeriesRestriction("0008|0021"); //Series date
-  nameGenerator->AddSeriesRestriction("0020|0037"); //Patient orientation
-  nameGenerator->SetLoadSequences(true);
-  nameGenerator->SetLoadPrivateTags(true);
+  DLOG(INFO) << "Reading DICOMDIR";
 
-  _pDicomInfo->SetMaxSizeLoadEntry(0xffffffffffffffff);
-  _pDicomInfo->SetLoadPrivateTags(true);
-  _pDicomInfo->SetLoadSequences(true);
-  //_pDicomInfo->SetLoadPrivateTagsDefault(true);
+  if (!boost::filesystem::exists(_srcPath))
+  {
+    LOG(ERROR) << "Input path " << _srcPath << " does not exist!";
+    return false;
+  }
 
-  //Create ITK ImageSeriesReader
-  typedef typename itk::ImageSeriesReader<MuMapImageType> ReaderType;
-  typename ReaderType::Pointer dicomReader = ReaderType::New();
+  std::unique_ptr<ThreadPool> localPool;
+  ThreadPool *pool = _pool;
+  if (pool == nullptr) {
+    localPool.reset(new ThreadPool);
+    pool = localPool.get();
+  }
 
-  try
+  if (_slices.empty())
   {
-    DLOG(INFO) << "DICOMDIR directory: " << _srcPath;
-
-    std::string pathToSeries = _srcPath.string();
-    //Load directory
-    nameGenerator->SetDirectory(pathToSeries);
+    //Will only convert first series in a folder.
+    //Group files into series from a minimal (possibly cached) header scan.
+    DicomSeriesScanner scanner;
+    scanner.SetDirectory(_srcPath);
+    scanner.SetCacheDirectory(_cachePath);
+    scanner.SetThreadPool(pool);
 
-    //TODO: Should probably check Series UIDs here 14/12/2017
-    //typedef std::vector<std::string> SeriesIdContainer;
-    //const SeriesIdContainer &seriesUID = nameGenerator->GetSeriesUIDs();
+    DLOG(INFO) << "DICOMDIR directory: " << _srcPath;
 
-    const typename ReaderType::FileNamesContainer &fileNames = nameGenerator->GetInputFileNames();
-    nameGenerator->Update();
+    if (!scanner.Update())
+    {
+      LOG(ERROR) << "Cannot read DICOM directory!";
+      return false;
+    }
 
-    //Set reader to update _pDicomInfo with header information.
-    dicomReader->SetImageIO(_pDicomInfo);
-    dicomReader->SetFileNames(fileNames);
+    const std::vector<std::string> seriesIds = scanner.GetSeriesIdentifiers();
 
-    if (fileNames.size() == 0)
+    if (seriesIds.empty())
     {
       LOG(ERROR) << "No valid DICOM series found";
       return false;
     }
+
+    if (seriesIds.size() > 1)
+      LOG(WARNING) << "Found " << seriesIds.size() << " series. Only converting the first.";
+
+    _slices = scanner.GetSlices(seriesIds[0]);
   }
-  catch (itk::ExceptionObject &ex)
-  {
-    //std::cout << ex << std::endl;
-    LOG(ERROR) << "Cannot read DICOM directory!";
+
+  const std::vector<DicomSliceInfo> &slices = _slices;
+
+  if (!ReadDicomInfo(slices[0].fileName))
     return false;
-  }
 
-  try
-  {
-    //Execute pipeline
-    dicomReader->Update();
-
-    //Re-orient
-    typedef typename itk::OrientImageFilter<MuMapImageType,MuMapImageType> OrienterType;
-    typename OrienterType::Pointer orienter = OrienterType::New();
-  
-    orienter->UseImageDirectionOn();
-    orienter->SetDesiredCoordinateOrientation(_outputOrientation);
-    orienter->SetInput(dicomReader->GetOutput());
-    orienter->Update();
-
-    //Duplicate contents of reader into _inputImage.
-    typedef typename itk::ImageDuplicator<MuMapImageType> DuplicatorType;
-    typename DuplicatorType::Pointer duplicator = DuplicatorType::New();
-    duplicator->SetInputImage(orienter->GetOutput());
-    duplicator->Update();
-    _inputImage = duplicator->GetOutput();
-
-    DLOG(INFO) << "DICOM Origin: " << _inputImage->GetOrigin();
+  _inputImage = nullptr;
+  _rawImage = nullptr;
+
+  bool bStatus;
+  if (_useIntegerPipeline && FitsInt16(slices)) {
+    DLOG(INFO) << "Reading series as 16-bit integers";
+    bStatus = LoadSeries<MRACImageType>(slices, pool, _rawImage);
   }
-  catch (itk::ExceptionObject &ex)
-  {
-    //std::cout << ex << std::endl;
-    LOG(ERROR) << "Unable to get image from DICOM series";
-    return false;
+  else {
+    DLOG(INFO) << "Reading series as float";
+    bStatus = LoadSeries<MuMapImageType>(slices, pool, _inputImage);
   }
 
-  DLOG(INFO) << "Reading complete";
+  if (!bStatus)
+    return false;
 
-  //TODO: Finish filling Interfile header
-  _header.clear();
-
-  std::stringstream ss;
-
-  ss << "!INTERFILE:=" << std::endl;
-  ss << "%comment:=created with nm_mrac2mu for mMR data" << std::endl;
-  ss << "!originating system:=2008" << std::endl;
-
-  ss << std::endl << "!GENERAL DATA:=" << std::endl;
-  ss << "!name of data file:=<%%DATAFILE%%>";
-  
-  ss << std::endl << "!GENERAL IMAGE DATA:=" << std::endl;
-  ss << "!type of data := PET" << std::endl;
-
-
-  ss << std::endl << "%study date (yyyy:mm:dd):=<%%STUDYDATE%%>"  << std::endl;
-  ss << "%study time (hh:mm:ss GMT+00:00):=<%%STUDYTIME%%>" << std::endl;
-  ss << "imagedata byte order:=LITTLEENDIAN" << std::endl;
-  ss << "%patient orientation:=HFS" << std::endl;
-  ss << "!PET data type:=image" << std::endl;
-  ss << "number format:=float" << std::endl;
-  ss << "!number of bytes per pixel:=4" << std::endl;
-  ss << "number of dimensions:=3" << std::endl;
-  ss << "matrix axis label[1]:=x" << std::endl;
-  ss << "matrix axis label[2]:=y" << std::endl;
-  ss << "matrix axis label[3]:=z" << std::endl;
-  ss << "matrix size[1]:=<%%NX%%>" << std::endl;
-  ss << "matrix size[2]:=<%%NY%%>" << std::endl;
-  ss << "matrix size[3]:=<%%NZ%%>" << std::endl;
-  ss << "scaling factor (mm/pixel) [1]:=<%%SX%%>" << std::endl;
-  ss << "scaling factor (mm/pixel) [2]:=<%%SY%%>" << std::endl;
-  ss << "scaling factor (mm/pixel) [3]:=<%%SZ%%>" << std::endl;
-  ss << "start horizontal bed position (mm):=0" << std::endl;
-  ss << "end horizontal bed position (mm):=0" << std::endl;
-  ss << "start vertical bed position (mm):=0.0" << std::endl;
-
-  ss << std::endl << "!IMAGE DATA DESCRIPTION:=" << std::endl;
-  ss << "!total number of data sets:=1" << std::endl;
-  ss << "number of time frames:=1" << std::endl;
-  ss << "!image duration (sec)[1]:=0" << std::endl;
-  ss << "!image relative start time (sec)[1]:=0" << std::endl;
-
-  ss << std::endl << "%SUPPLEMENTARY ATTRIBUTES:=" << std::endl;
-  ss << "quantification units:=1/cm" << std::endl;
-  ss << "slice orientation:=Transverse" << std::endl;
-  ss << "%image zoom:=1" << std::endl;
-  ss << "%x-offset (mm):=0.0" << std::endl;
-  ss << "%y-offset (mm):=0.0" << std::endl;
-  ss << "%image slope:=1" << std::endl;
-  ss << "%image intercept:=0.0" << std::endl;
-  ss << "maximum pixel count:=<%%MAXVAL%%>" << std::endl;
-  ss << "minimum pixel count:=<%%MINVAL%%>" << std::endl;
-
-  ss << "!END OF INTERFILE :=" << std::endl;
-
-  _header = ss.str();
+  if (_rawImage)
+    _axisMapping = ComputeAxisMapping(_rawImage->GetDirection(), _outputOrientation);
+  else
+    _axisMapping = ComputeAxisMapping(_inputImage->GetDirection(), _outputOrientation);
 
-  return true;
+  if (_axisMapping.IsIdentity())
+    DLOG(INFO) << "Series already in requested orientation";
 
-}
+  DLOG(INFO) << "Reading complete";
 
-//Insert info. into Interfile header.
-//Casting might not be totally safe.
-bool MRAC2MU::UpdateInterfile(const std::string &key, const boost::any info){
+  return true;
+}
 
-  std::string updateStr;
+//Decode all slices in parallel, straight into the volume.
+template <class TImage>
+bool MRAC2MU::LoadSeries(const std::vector<DicomSliceInfo> &slices, ThreadPool *pool,
+                         typename TImage::Pointer &output){
 
-  bool bStatus = false;
+  DicomSeriesLoader<TImage> loader;
+  loader.SetSlices(slices);
+  loader.SetThreadPool(pool);
 
-  try {
-    updateStr = boost::any_cast<std::string>(info);
-    bStatus=true;
+  if (!loader.Update())
+  {
+    LOG(ERROR) << "Unable to get image from DICOM series";
+    return false;
   }
-  catch (boost::bad_any_cast &e) {
 
-  }
+  output = loader.GetOutput();
 
-  if (!bStatus){
-    try {
-      updateStr = boost::lexical_cast<std::string>(boost::any_cast<const char *>(info));
-      bStatus=true;
-    }
-    catch (boost::bad_any_cast &e) {
+  DLOG(INFO) << "DICOM Origin: " << output->GetOrigin();
 
-    }
-  }
-
-  if (!bStatus){
-    try {
-      updateStr = boost::lexical_cast<std::string>(boost::any_cast<float>(info));
-      bStatus=true;
-    }
-    catch (boost::bad_any_cast &e) {
-      
-    }
-  }
+  return true;
+}
 
-  if (!bStatus){
-    try {
-      updateStr = boost::lexical_cast<std::string>(boost::any_cast<int>(info));
-      bStatus=true;
-    }
-    catch (boost::bad_any_cast &e) {
-      
-    }
-  }
+//- Reads input directory and orients the volume.
+//- Creates Interfile skeleton.
+bool MRAC2MU::Read(){
 
-  if (!bStatus){
-    LOG(WARNING) << "Unable to find conversion for Interfile header update";
+  if (!ReadSeries())
     return false;
-  }
-
-  std::string target = "<%%" + key + "%%>";
-  std::string::size_type n;
 
-  n = _header.find(target);
+  CreateInterfileHeader();
 
-  if (n == std::string::npos){
-    LOG(WARNING) << "Interfile replacement key: " << target << " not found!";
-    return false; 
-  }
+  return true;
+}
 
-  _header.replace(n,target.length(),updateStr);
+//Interfile skeleton, filled in by FillInterfileHeader().
+void MRAC2MU::CreateInterfileHeader(){
 
-  return bStatus;
+  //TODO: Finish filling Interfile header
+  _header = InterfileHeaderBuilder();
+
+  _header.AddSection("!INTERFILE");
+  _header.Set("%comment", "created with nm_mrac2mu for mMR data");
+  _header.Set("!originating system", "2008");
+
+  _header.AddLine("");
+  _header.AddSection("!GENERAL DATA");
+  _header.Set("!name of data file", "");
+
+  _header.AddSection("!GENERAL IMAGE DATA");
+  _header.SetSeparator(" := ");
+  _header.Set("!type of data", "PET");
+  _header.SetSeparator(":=");
+
+  _header.AddLine("");
+  _header.Set("%study date (yyyy:mm:dd)", "");
+  _header.Set("%study time (hh:mm:ss GMT+00:00)", "");
+  _header.Set("imagedata byte order", "LITTLEENDIAN");
+  _header.Set("%patient orientation", "HFS");
+  _header.Set("!PET data type", "image");
+  _header.Set("number format", "float");
+  _header.Set("!number of bytes per pixel", 4);
+  _header.Set("number of dimensions", 3);
+  _header.Set("matrix axis label[1]", "x");
+  _header.Set("matrix axis label[2]", "y");
+  _header.Set("matrix axis label[3]", "z");
+  _header.Set("matrix size[1]", 0);
+  _header.Set("matrix size[2]", 0);
+  _header.Set("matrix size[3]", 0);
+  _header.Set("scaling factor (mm/pixel) [1]", 0.0f);
+  _header.Set("scaling factor (mm/pixel) [2]", 0.0f);
+  _header.Set("scaling factor (mm/pixel) [3]", 0.0f);
+  _header.Set("start horizontal bed position (mm)", "0");
+  _header.Set("end horizontal bed position (mm)", "0");
+  _header.Set("start vertical bed position (mm)", "0.0");
+
+  _header.AddLine("");
+  _header.AddSection("!IMAGE DATA DESCRIPTION");
+  _header.Set("!total number of data sets", 1);
+  _header.Set("number of time frames", 1);
+  _header.Set("!image duration (sec)[1]", 0);
+  _header.Set("!image relative start time (sec)[1]", 0);
+
+  _header.AddLine("");
+  _header.AddSection("%SUPPLEMENTARY ATTRIBUTES");
+  _header.Set("quantification units", "1/cm");
+  _header.Set("slice orientation", "Transverse");
+  _header.Set("%image zoom", 1);
+  _header.Set("%x-offset (mm)", "0.0");
+  _header.Set("%y-offset (mm)", "0.0");
+  _header.Set("%image slope", 1);
+  _header.Set("%image intercept", "0.0");
+  _header.Set("maximum pixel count", 0.0f);
+  _header.Set("minimum pixel count", 0.0f);
+
+  _header.AddSection("!END OF INTERFILE ");
 }
 
 //Get study date from DICOM and convert from 'YYYYMMDD' to 'YYYY:MM:DD'.
@@ -480,71 +743,469 @@ bool MRAC2MU::GetStudyTime(std::string &studyTime){
 }
 
 //Divide by 10000 to get mu-values (cm-1).
-//Interpolate and reslice according to JSON params.
+//Scaling and min/max are computed in a single multithreaded pass.
 bool MRAC2MU::Scale(){
 
-  typedef typename itk::DivideImageFilter<MuMapImageType, MuMapImageType, MuMapImageType> DivideFilterType;
+  if (!ScaleInput())
+    return false;
+
+  if (!PostProcess())
+    return false;
 
-  //Scale to mu-values
-  DivideFilterType::Pointer divide = DivideFilterType::New();
-  divide->SetInput( _inputImage );
-  divide->SetConstant( 10000.0 );
+  FillInterfileHeader();
 
-  try {
-    divide->Update();
-  } catch (itk::ExceptionObject &ex){
-    //std::cout << ex << std::endl;
-    LOG(ERROR) << "Unable to scale!";
+  return true;
+}
+
+//Scale the input into _muImage, in the output orientation. Float input
+//already in that orientation is scaled in place; otherwise the input is
+//reordered (and 16-bit input converted to float) in the same pass.
+bool MRAC2MU::ScaleInput(){
+
+  if (_rawImage)
+    return ScaleAndOrient(_rawImage.GetPointer());
+
+  if (!_inputImage){
+    LOG(ERROR) << "No input image to scale!";
     return false;
   }
 
+  if (!_axisMapping.IsIdentity())
+    return ScaleAndOrient(_inputImage.GetPointer());
+
+  //Scale in place and hand the buffer over to _muImage.
+  _muImage = _inputImage;
+  _inputImage = nullptr;
+
+  ScaleAndComputeStatistics(_muImage->GetBufferPointer(), _muImage->GetBufferPointer(),
+                            _muImage->GetLargestPossibleRegion().GetNumberOfPixels(),
+                            10000.0f, _stats);
+
+  return true;
+}
+
+//Scale input into a new _muImage, reordering voxels by _axisMapping.
+template <class TInputImage>
+bool MRAC2MU::ScaleAndOrient(const TInputImage *input){
+
+  _muImage = GetMappedGeometry<MuMapImageType>(input, _axisMapping);
+
   try {
-    //Duplicate contents or reader into _muImage.
-    typedef typename itk::ImageDuplicator<MuMapImageType> DuplicatorType;
-    typename DuplicatorType::Pointer duplicator = DuplicatorType::New();
-    duplicator->SetInputImage(divide->GetOutput());
-    duplicator->Update();
-    _muImage = duplicator->GetOutput();
+    _muImage->Allocate();
   } catch (itk::ExceptionObject &ex){
-    //std::cout << ex << std::endl;
-    LOG(ERROR) << "Unable to scale to mu!";
+    LOG(ERROR) << "Unable to allocate mu-map!";
     return false;
   }
 
-  //Get max and min voxel values to insert into Interfile header.
-  typedef typename itk::MinimumMaximumImageCalculator <MuMapImageType> ImageCalculatorFilterType;
-  typename ImageCalculatorFilterType::Pointer minmax = ImageCalculatorFilterType::New();
-  minmax->SetImage(_muImage);
+  ScaleAndComputeStatistics(MakeMappedView(input, _axisMapping), _muImage->GetBufferPointer(),
+                            10000.0f, _stats);
+
+  _inputImage = nullptr;
+  _rawImage = nullptr;
+
+  return true;
+}
+
+bool MRAC2MU::PostProcess(){
+
+  return Register() && CompleteTruncation() && Smooth();
+}
+
+bool MRAC2MU::Register(){
+
+  if (_registrationTarget.empty() || _isRegistered)
+    return true;
+
+  RigidTransform transform;
+  if (!ComputeRegistration(transform))
+    return false;
+
+  MuMapImageType::Pointer registered;
+  if (!ResampleRigid(_muImage.GetPointer(), transform, registered, &_stats))
+    return false;
+
+  _muImage = registered;
+  _isRegistered = true;
+
+  return true;
+}
+
+bool MRAC2MU::ComputeRegistration(RigidTransform &transform){
+
+  if (!_muImage){
+    LOG(ERROR) << "No mu-map to register!";
+    return false;
+  }
+
+  typedef itk::ImageFileReader<MuMapImageType> ReaderType;
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(_registrationTarget.string());
 
   try {
-    minmax->Compute();
+    reader->Update();
   } catch (itk::ExceptionObject &ex){
-    //std::cout << ex << std::endl;
-    LOG(ERROR) << "Unable to calculate min/max!";
+    LOG(ERROR) << "Unable to read NAC PET image " << _registrationTarget << ": " << ex.GetDescription();
+    return false;
+  }
+
+  LOG(INFO) << "Registering mu-map to " << _registrationTarget;
+
+  RigidRegistration registration;
+  registration.SetFixedImage(reader->GetOutput());
+  registration.SetMovingImage(_muImage.GetPointer());
+
+  if (!registration.Update()){
+    LOG(ERROR) << "Registration failed!";
+    return false;
+  }
+
+  transform = registration.GetTransform();
+
+  LOG(INFO) << "Rotation (degrees): " << transform.angles[0] * 180.0 / M_PI << ", "
+            << transform.angles[1] * 180.0 / M_PI << ", " << transform.angles[2] * 180.0 / M_PI;
+  LOG(INFO) << "Translation (mm): " << transform.translation[0] << ", "
+            << transform.translation[1] << ", " << transform.translation[2];
+
+  return true;
+}
+
+bool MRAC2MU::CompleteTruncation(){
+
+  if (_truncationOutline.empty())
+    return true;
+
+  if (!_muImage){
+    LOG(ERROR) << "No mu-map to complete!";
+    return false;
+  }
+
+  LOG(INFO) << "Completing truncation from " << _truncationOutline;
+
+  TruncationCompletion completion(_truncationOutline);
+  completion.SetThreshold(_truncationThreshold);
+
+  if (!completion.Update(_muImage.GetPointer(), &_stats)){
+    LOG(ERROR) << "Truncation completion failed!";
+    return false;
+  }
+
+  LOG(INFO) << "Filled " << completion.GetNumberOfFilledVoxels() << " truncated voxels";
+
+  return true;
+}
+
+//Gaussian of _smoothingFWHM mm applied along each axis of _muImage.
+//_stats are gathered again in the last pass.
+bool MRAC2MU::Smooth(){
+
+  if (_smoothingFWHM <= 0.0)
+    return true;
+
+  if (!_muImage){
+    LOG(ERROR) << "No mu-map to smooth!";
     return false;
   }
 
-  //Update the Interfile header with new sizes etc.
+  const MuMapImageType::SizeType &imageSize = _muImage->GetLargestPossibleRegion().GetSize();
+  const MuMapImageType::SpacingType &spacing = _muImage->GetSpacing();
+
+  std::size_t size[3];
+  double sigma[3];
+  for (unsigned int k = 0; k < 3; k++) {
+    size[k] = imageSize[k];
+    sigma[k] = _smoothingFWHM / (kFWHMPerSigma * spacing[k]);
+  }
+
+  LOG(INFO) << "Smoothing with FWHM " << _smoothingFWHM << " mm";
+
+  SmoothGaussian(_muImage->GetBufferPointer(), size, sigma, &_stats);
+
+  return true;
+}
+
+//Update the Interfile header with new sizes etc.
+void MRAC2MU::FillInterfileHeader(){
+
   const MuMapImageType::SizeType& size = _muImage->GetLargestPossibleRegion().GetSize();
-  this->UpdateInterfile("NX", int(size[0]));
-  this->UpdateInterfile("NY", int(size[1]));
-  this->UpdateInterfile("NZ", int(size[2]));
+  _header.Set("matrix size[1]", size[0]);
+  _header.Set("matrix size[2]", size[1]);
+  _header.Set("matrix size[3]", size[2]);
 
   const MuMapImageType::SpacingType& voxSize = _muImage->GetSpacing();
-  this->UpdateInterfile("SX", float(voxSize[0]));
-  this->UpdateInterfile("SY", float(voxSize[1]));
-  this->UpdateInterfile("SZ", float(voxSize[2]));  
+  _header.Set("scaling factor (mm/pixel) [1]", float(voxSize[0]));
+  _header.Set("scaling factor (mm/pixel) [2]", float(voxSize[1]));
+  _header.Set("scaling factor (mm/pixel) [3]", float(voxSize[2]));
+
+  LOG(INFO) << "Image min: " << _stats.minimum;
+  LOG(INFO) << "Image max: " << _stats.maximum;
 
-  this->UpdateInterfile("MAXVAL", float(minmax->GetMaximum()));
-  this->UpdateInterfile("MINVAL", float(minmax->GetMinimum()));
+  _header.Set("maximum pixel count", _stats.maximum);
+  _header.Set("minimum pixel count", _stats.minimum);
 
   std::string studyDate;
   if (GetStudyDate(studyDate))
-    this->UpdateInterfile("STUDYDATE", studyDate);
+    _header.Set("%study date (yyyy:mm:dd)", studyDate);
 
   std::string studyTime;
   if (GetStudyTime(studyTime))
-    this->UpdateInterfile("STUDYTIME", studyTime);
+    _header.Set("%study time (hh:mm:ss GMT+00:00)", studyTime);
+}
+
+//Head mu-map from whichever input image (16-bit or float) is held.
+bool MRAC2MU::GenerateHeadMuMap(const nlohmann::json &params){
+
+  if (!_registrationTarget.empty())
+    return GenerateRegisteredHeadMuMap(params);
+
+  if (_rawImage)
+    return GenerateHeadMuMap(_rawImage.GetPointer(), params);
+
+  if (!_inputImage){
+    LOG(ERROR) << "No input image to reslice!";
+    return false;
+  }
+
+  return GenerateHeadMuMap(_inputImage.GetPointer(), params);
+}
+
+//Legacy mMR head grid: equivalent to resampling to the new voxel size,
+//padding x-y to the requested matrix size and cropping 11/10 slices
+//from the bottom/top, but computed directly as the final grid.
+bool MRAC2MU::ComputeLegacyHeadGrid(const MuMapImageType *input, const nlohmann::json &params,
+                                    ReslicingGrid &grid){
+
+  //Grab original voxel and matrix size.
+  const MuMapImageType::SpacingType inputSpacing = input->GetSpacing();
+  const MuMapImageType::SizeType inputSize = input->GetLargestPossibleRegion().GetSize();
+
+  //Get new voxel size from JSON params.
+  MuMapImageType::SpacingType &outputSpacing = grid.spacing;
+  outputSpacing[0] = params.at("px").get<double>();
+  outputSpacing[1] = params.at("py").get<double>();
+  outputSpacing[2] = params.at("pz").get<double>();
+
+  //Size of the input after reslicing to the new voxel size.
+  MuMapImageType::SizeType resampledSize;
+  typedef MuMapImageType::SizeType::SizeValueType SizeValueType;
+  resampledSize[0] = static_cast<SizeValueType>(inputSize[0] * inputSpacing[0] / outputSpacing[0] + .5);
+  resampledSize[1] = static_cast<SizeValueType>(inputSize[1] * inputSpacing[1] / outputSpacing[1] + .5);
+  resampledSize[2] = static_cast<SizeValueType>(inputSize[2] * inputSpacing[2] / outputSpacing[2] + .5);
+
+  if ((resampledSize[0] % 2 == 1) or (resampledSize[1] % 2 == 1)){
+    LOG(ERROR) << "Input x or y size is odd. Unsure how to resample!";
+    return false;
+  }
+
+  //Pad x-y
+  int pad_x = (params.at("sx").get<int>() - static_cast<int>(resampledSize[0])) / 2;
+  if (pad_x < 0) {
+    pad_x = 0;
+  }
+  int pad_y = (params.at("sy").get<int>() - static_cast<int>(resampledSize[1])) / 2;
+  if (pad_y < 0) {
+    pad_y = 0;
+  }
+
+  // magic numbers
+  int z_lcrop = 11;
+  int z_ucrop = 10;
+
+  if (resampledSize[2] <= static_cast<SizeValueType>(z_lcrop + z_ucrop)){
+    LOG(ERROR) << "Too few slices to crop to head matrix!";
+    return false;
+  }
+
+  //Final grid, in terms of the resampled grid: starts at index
+  //(-pad_x, -pad_y, z_lcrop).
+  grid.size[0] = resampledSize[0] + 2 * pad_x;
+  grid.size[1] = resampledSize[1] + 2 * pad_y;
+  grid.size[2] = resampledSize[2] - z_lcrop - z_ucrop;
+
+  const double startIndex[3] = { -static_cast<double>(pad_x), -static_cast<double>(pad_y),
+                                 static_cast<double>(z_lcrop) };
+
+  const MuMapImageType::PointType &inputOrigin = input->GetOrigin();
+  const MuMapImageType::DirectionType &direction = input->GetDirection();
+
+  for (unsigned int r = 0; r < 3; r++) {
+    grid.origin[r] = inputOrigin[r];
+    for (unsigned int c = 0; c < 3; c++)
+      grid.origin[r] += direction[r][c] * startIndex[c] * outputSpacing[c];
+  }
+
+  //Padded voxels are zero, even if they overlap the input.
+  grid.support.SetIndex(0, pad_x);
+  grid.support.SetIndex(1, pad_y);
+  grid.support.SetIndex(2, 0);
+  grid.support.SetSize(0, resampledSize[0]);
+  grid.support.SetSize(1, resampledSize[1]);
+  grid.support.SetSize(2, grid.size[2]);
+  grid.useSupport = true;
+
+  return true;
+}
+
+//Target grid given explicitly by params (see ValidateReslicingParams()).
+//Without an origin, the grid is centred on the input volume.
+bool MRAC2MU::ComputeTargetGrid(const MuMapImageType *input, const nlohmann::json &params,
+                                ReslicingGrid &grid){
+
+  for (unsigned int k = 0; k < 3; k++) {
+    grid.size[k] = params.at("size").at(k).get<unsigned int>();
+    grid.spacing[k] = params.at("spacing").at(k).get<double>();
+  }
+
+  const MuMapImageType::DirectionType &direction = input->GetDirection();
+
+  if (params.count("origin")) {
+    for (unsigned int r = 0; r < 3; r++)
+      grid.origin[r] = params.at("origin").at(r).get<double>();
+  }
+  else {
+    const MuMapImageType::SpacingType &inputSpacing = input->GetSpacing();
+    const MuMapImageType::SizeType &inputSize = input->GetLargestPossibleRegion().GetSize();
+
+    for (unsigned int r = 0; r < 3; r++) {
+      grid.origin[r] = input->GetOrigin()[r];
+      for (unsigned int c = 0; c < 3; c++)
+        grid.origin[r] += direction[r][c] * 0.5 *
+          ((inputSize[c] - 1.0) * inputSpacing[c] - (grid.size[c] - 1.0) * grid.spacing[c]);
+    }
+  }
+
+  grid.fovDiameter = params.value("FOV", 0.0);
+
+  DLOG(INFO) << "Target grid: " << grid.size << " voxels of " << grid.spacing
+             << " mm from " << grid.origin;
+
+  return true;
+}
+
+//Divide by 10000 to get mu-values (cm-1).
+//Interpolate and reslice according to JSON params, either onto the
+//legacy mMR head grid or onto an explicit target geometry. Each output
+//voxel is sampled from the input where the input covers it and is zero
+//elsewhere, in a single pass.
+template <class TInputImage>
+bool MRAC2MU::GenerateHeadMuMap(const TInputImage *image, const nlohmann::json &params){
+
+  if (!ValidateReslicingParams(params))
+    return false;
+
+  //The input as it is in the output orientation. Its voxels are read
+  //through a mapped view rather than reordered first.
+  const typename TInputImage::Pointer input = GetMappedGeometry<TInputImage>(image, _axisMapping);
+  const MuMapImageType::Pointer geometry = GetMappedGeometry<MuMapImageType>(image, _axisMapping);
+
+  ReslicingGrid grid;
+  const bool isTarget = params.value("mode", std::string()) == "geometry";
+
+  if (!(isTarget ? ComputeTargetGrid(geometry, params, grid)
+                 : ComputeLegacyHeadGrid(geometry, params, grid)))
+    return false;
+
+  AxisAlignedResampler<TInputImage, MuMapImageType> resampler;
+  resampler.SetInput( input );
+  resampler.SetInputView( MakeMappedView(image, _axisMapping) );
+  resampler.SetOutputOrigin( grid.origin );
+  resampler.SetOutputSpacing( grid.spacing );
+  resampler.SetSize( grid.size );
+  if (grid.useSupport)
+    resampler.SetSupportRegion( grid.support );
+  resampler.SetTransaxialFOV( grid.fovDiameter );
+  resampler.SetDivisor( 10000.0f );
+  resampler.SetInterpolation( _interpolation );
+
+  if (!resampler.Update(&_stats)){
+    LOG(ERROR) << "Unable to resample!";
+    return false;
+  }
+
+  _muImage = resampler.GetOutput();
+  _inputImage = nullptr;
+  _rawImage = nullptr;
+
+  if (!PostProcess())
+    return false;
+
+  FillInterfileHeader();
+
+  return true;
+}
+
+//Registration needs the mu-map, and resampling it onto the head matrix
+//and then again through the transform would interpolate twice. Instead
+//the input is only scaled and reordered (no interpolation), registered
+//at full resolution, and the head matrix is sampled from it through
+//the transform in one (linear) pass, which also applies the padding and
+//the FOV.
+bool MRAC2MU::GenerateRegisteredHeadMuMap(const nlohmann::json &params){
+
+  if (!ValidateReslicingParams(params))
+    return false;
+
+  if (_interpolation != Interpolation::Linear)
+    LOG(WARNING) << "Reslicing through the registration is linear, ignoring the "
+                 << GetInterpolationName(_interpolation) << " kernel";
+
+  if (!ScaleInput())
+    return false;
+
+  RigidTransform transform;
+  if (!ComputeRegistration(transform))
+    return false;
+
+  ReslicingGrid grid;
+  const bool isTarget = params.value("mode", std::string()) == "geometry";
+
+  if (!(isTarget ? ComputeTargetGrid(_muImage, params, grid)
+                 : ComputeLegacyHeadGrid(_muImage, params, grid)))
+    return false;
+
+  const MuMapImageType::DirectionType &direction = _muImage->GetDirection();
+  const std::size_t size[3] = { grid.size[0], grid.size[1], grid.size[2] };
+
+  //Padding (the support region spans every slice) and FOV, in-plane.
+  std::vector<unsigned char> mask;
+  if (grid.fovDiameter > 0.0) {
+    if (std::fabs(direction[0][2]) > 1e-6 || std::fabs(direction[1][2]) > 1e-6) {
+      LOG(ERROR) << "A transaxial FOV needs transaxial output slices!";
+      return false;
+    }
+    mask = GetTransaxialFOVMask(grid.origin, grid.spacing, direction, size, grid.fovDiameter);
+  }
+
+  if (grid.useSupport) {
+    mask.resize(size[0] * size[1], 1);
+    const MuMapImageType::IndexType &lower = grid.support.GetIndex();
+    const MuMapImageType::SizeType &extent = grid.support.GetSize();
+    for (std::size_t y = 0; y < size[1]; y++)
+      for (std::size_t x = 0; x < size[0]; x++)
+        if (static_cast<long>(x) < lower[0] || static_cast<long>(x) >= lower[0] + static_cast<long>(extent[0]) ||
+            static_cast<long>(y) < lower[1] || static_cast<long>(y) >= lower[1] + static_cast<long>(extent[1]))
+          mask[y * size[0] + x] = 0;
+  }
+
+  MuMapImageType::RegionType region;
+  region.SetSize(grid.size);
+
+  MuMapImageType::Pointer output = MuMapImageType::New();
+  output->SetRegions(region);
+  output->SetSpacing(grid.spacing);
+  output->SetOrigin(grid.origin);
+  output->SetDirection(direction);
+
+  if (!ResampleRigid(_muImage.GetPointer(), transform, output.GetPointer(),
+                     mask.empty() ? nullptr : mask.data(), &_stats))
+    return false;
+
+  _muImage = output;
+  _isRegistered = true;
+
+  if (!PostProcess())
+    return false;
+
+  FillInterfileHeader();
 
   return true;
 }
@@ -556,6 +1217,10 @@ bool MRAC2MU::Write(boost::filesystem::path dst) {
    return WriteToInterFile(dst);
   }
 
+  if (dst.extension() == ".gz" && dst.stem().extension() == ".nii"){
+    return WriteToCompressedNifti(dst);
+  }
+
   //Write output file
   typedef typename itk::ImageFileWriter<MuMapImageType> WriterType; 
 
@@ -575,48 +1240,36 @@ bool MRAC2MU::Write(boost::filesystem::path dst) {
 
 }
 
-//Write Interfile header and image pair to disk.
-bool MRAC2MU::WriteToInterFile(boost::filesystem::path dst){
-
-  boost::filesystem::path altPath = dst;
-  altPath.replace_extension(".mhd");
-  //Write output file
-  typedef typename itk::ImageFileWriter<MuMapImageType> WriterType; 
-
-  typename WriterType::Pointer writer = WriterType::New();
-  writer->SetFileName( altPath.string().c_str() );
-  writer->SetInput( _muImage );
+//Write .nii.gz from memory, compressing on all cores (ITK's own
+//compression is single-threaded).
+bool MRAC2MU::WriteToCompressedNifti(boost::filesystem::path dst){
 
-  try {
-    writer->Update();
-  }
-  catch (itk::ExceptionObject &ex){
-    LOG(ERROR) << " Could not write output data!";
-    return false;    
+  if (!_muImage){
+    LOG(ERROR) << "No mu-map to write!";
+    return false;
   }
 
-  //Put new data file in header.
-  boost::filesystem::path dataFile =  dst.replace_extension(".raw");
-  this->UpdateInterfile("DATAFILE", dataFile.filename().string());
-
-  std::string outputHeader = GetInterfileHdr();
+  if (!WriteCompressedNifti(_muImage.GetPointer(), dst, _compressionLevel)){
+    LOG(ERROR) << " Could not write output file!";
+    return false;
+  }
 
-  altPath = dst;
-  altPath.replace_extension(".hv");
+  return true;
+}
 
-  std::ofstream infoStream;
+//Write Interfile header (.hv) and data (.v) directly from the mu-map.
+bool MRAC2MU::WriteToInterFile(boost::filesystem::path dst){
 
-  if ( infoStream ) {
-    infoStream.open(altPath.string().c_str());
-    infoStream << outputHeader;
-    infoStream.close();
-    LOG(INFO) << "Wrote Interfile header to " << altPath;
-  } else {
-    LOG(INFO) << "Could not write Interfile header to " << altPath;
+  if (!_muImage){
+    LOG(ERROR) << "No mu-map to write!";
     return false;
   }
 
-  return true;
+  InterfileImageWriter writer;
+  writer.SetHeader(_header);
+  writer.AddFrame(_muImage.GetPointer());
+
+  return writer.Write(dst);
 }
 
 } //namespace nmtools
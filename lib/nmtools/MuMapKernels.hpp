@@ -0,0 +1,205 @@
+/*
+   MuMapKernels.hpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Fused voxel-wise kernels used when generating mu-maps.
+ */
+
+#ifndef MUMAPKERNELS_HPP
+#define MUMAPKERNELS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "Parallel.hpp"
+
+namespace nmtools {
+
+//Summary statistics of a mu-map, gathered while it is written.
+struct MuMapStatistics {
+
+  float minimum = 0.0f;
+  float maximum = 0.0f;
+
+  //Optional histogram. Left empty unless bins are requested with
+  //SetHistogram(). Values outside [histogramMin, histogramMax) are
+  //counted in the first/last bin; NaNs are not counted.
+  std::vector<uint64_t> histogram;
+  float histogramMin = 0.0f;
+  float histogramMax = 0.0f;
+
+  void SetHistogram(std::size_t bins, float minVal, float maxVal){
+    histogram.assign(bins, 0);
+    histogramMin = minVal;
+    histogramMax = maxVal;
+  }
+};
+
+//Statistics gathered by one thread, merged with MergeStatistics() once
+//all threads are done.
+struct PartialStatistics {
+
+  float minimum = std::numeric_limits<float>::max();
+  float maximum = std::numeric_limits<float>::lowest();
+  std::vector<uint64_t> histogram;
+  bool used = false;
+
+  //Add n values to the min/max and histogram of stats' layout.
+  template <typename TPixel>
+  void Add(const TPixel *v, std::size_t n, const MuMapStatistics &layout);
+};
+
+template <typename TPixel>
+void PartialStatistics::Add(const TPixel *v, std::size_t n, const MuMapStatistics &layout){
+
+  const std::size_t numBins = layout.histogram.size();
+
+  float lo = minimum;
+  float hi = maximum;
+
+  for (std::size_t i = 0; i < n; i++) {
+    lo = std::min(lo, static_cast<float>(v[i]));
+    hi = std::max(hi, static_cast<float>(v[i]));
+  }
+
+  if (numBins > 0) {
+    if (histogram.size() != numBins)
+      histogram.assign(numBins, 0);
+
+    const float binScale = (layout.histogramMax > layout.histogramMin) ?
+      numBins / (layout.histogramMax - layout.histogramMin) : 0.0f;
+    const long lastBin = static_cast<long>(numBins) - 1;
+
+    for (std::size_t i = 0; i < n; i++) {
+      const float value = static_cast<float>(v[i]);
+      //NaN has no bin.
+      if (!(value == value))
+        continue;
+      long bin = static_cast<long>((value - layout.histogramMin) * binScale);
+      bin = std::max(0L, std::min(lastBin, bin));
+      histogram[bin]++;
+    }
+  }
+
+  minimum = lo;
+  maximum = hi;
+  used = true;
+}
+
+//Combine per-thread statistics into stats (whose histogram layout, if
+//any, is kept).
+void MergeStatistics(const std::vector<PartialStatistics> &partials, MuMapStatistics &stats){
+
+  std::fill(stats.histogram.begin(), stats.histogram.end(), 0);
+  stats.minimum = 0.0f;
+  stats.maximum = 0.0f;
+  bool first = true;
+
+  for (const PartialStatistics &p : partials) {
+    if (!p.used)
+      continue;
+
+    stats.minimum = first ? p.minimum : std::min(stats.minimum, p.minimum);
+    stats.maximum = first ? p.maximum : std::max(stats.maximum, p.maximum);
+    first = false;
+
+    for (std::size_t b = 0; b < p.histogram.size() && b < stats.histogram.size(); b++)
+      stats.histogram[b] += p.histogram[b];
+  }
+}
+
+//Computes dst[i] = src[i] / divisor for n voxels, gathering min/max (and
+//the histogram, if requested) in the same sweep. src and dst may point to
+//the same buffer. Work is split into contiguous chunks across threads.
+template <typename TInputPixel, typename TOutputPixel>
+void ScaleAndComputeStatistics(const TInputPixel *src, TOutputPixel *dst, std::size_t n,
+                               float divisor, MuMapStatistics &stats){
+
+  const std::size_t numBins = stats.histogram.size();
+  const float histMin = stats.histogramMin;
+  const float binScale = (numBins > 0 && stats.histogramMax > histMin) ?
+    numBins / (stats.histogramMax - histMin) : 0.0f;
+
+  const unsigned int numThreads = GetDefaultNumberOfThreads();
+  std::vector<PartialStatistics> partials(numThreads);
+
+  ParallelFor(0, n, [&](std::size_t first, std::size_t last, unsigned int chunk){
+
+    PartialStatistics &local = partials[chunk];
+    float lo = std::numeric_limits<float>::max();
+    float hi = std::numeric_limits<float>::lowest();
+
+    if (numBins == 0) {
+      //Plain scale/min/max loop, kept branch-free so it vectorises.
+      for (std::size_t i = first; i < last; i++) {
+        const float v = static_cast<float>(src[i]) / divisor;
+        dst[i] = static_cast<TOutputPixel>(v);
+        lo = std::min(lo, v);
+        hi = std::max(hi, v);
+      }
+    }
+    else {
+      local.histogram.assign(numBins, 0);
+      const long lastBin = static_cast<long>(numBins) - 1;
+      for (std::size_t i = first; i < last; i++) {
+        const float v = static_cast<float>(src[i]) / divisor;
+        dst[i] = static_cast<TOutputPixel>(v);
+        lo = std::min(lo, v);
+        hi = std::max(hi, v);
+        if (!(v == v))
+          continue;
+        long bin = static_cast<long>((v - histMin) * binScale);
+        bin = std::max(0L, std::min(lastBin, bin));
+        local.histogram[bin]++;
+      }
+    }
+
+    local.minimum = lo;
+    local.maximum = hi;
+    local.used = true;
+  }, numThreads);
+
+  MergeStatistics(partials, stats);
+}
+
+//Computes dst[i] += src[i] for n voxels, gathering statistics of dst in
+//the same sweep (a block at a time, while it is still in cache).
+template <typename TPixel>
+void AddAndComputeStatistics(const TPixel *src, TPixel *dst, std::size_t n,
+                             MuMapStatistics &stats){
+
+  const std::size_t blockSize = 4096;
+
+  const unsigned int numThreads = GetDefaultNumberOfThreads();
+  std::vector<PartialStatistics> partials(numThreads);
+
+  ParallelFor(0, n, [&](std::size_t first, std::size_t last, unsigned int chunk){
+
+    for (std::size_t block = first; block < last; block += blockSize) {
+      const std::size_t blockEnd = std::min(last, block + blockSize);
+      for (std::size_t i = block; i < blockEnd; i++)
+        dst[i] += src[i];
+      partials[chunk].Add(dst + block, blockEnd - block, stats);
+    }
+  }, numThreads);
+
+  MergeStatistics(partials, stats);
+}
+
+} //namespace nmtools
+
+#endif
@@ -0,0 +1,223 @@
+/*
+   Nifti.hpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Writing NIfTI-1 images straight from memory.
+ */
+
+#ifndef NIFTI_HPP
+#define NIFTI_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <boost/filesystem.hpp>
+#include <glog/logging.h>
+
+#include "Gzip.hpp"
+
+namespace nmtools {
+
+//The NIfTI-1 header (nifti1.h), 348 bytes.
+struct NiftiHeader {
+  int32_t sizeof_hdr;
+  char data_type[10];
+  char db_name[18];
+  int32_t extents;
+  int16_t session_error;
+  char regular;
+  char dim_info;
+  int16_t dim[8];
+  float intent_p1, intent_p2, intent_p3;
+  int16_t intent_code;
+  int16_t datatype;
+  int16_t bitpix;
+  int16_t slice_start;
+  float pixdim[8];
+  float vox_offset;
+  float scl_slope, scl_inter;
+  int16_t slice_end;
+  char slice_code;
+  char xyzt_units;
+  float cal_max, cal_min;
+  float slice_duration;
+  float toffset;
+  int32_t glmax, glmin;
+  char descrip[80];
+  char aux_file[24];
+  int16_t qform_code, sform_code;
+  float quatern_b, quatern_c, quatern_d;
+  float qoffset_x, qoffset_y, qoffset_z;
+  float srow_x[4], srow_y[4], srow_z[4];
+  char intent_name[16];
+  char magic[4];
+};
+
+static_assert(sizeof(NiftiHeader) == 348, "NIfTI-1 header must be 348 bytes");
+
+//NIfTI datatype codes of the pixel types written.
+template <typename TPixel> struct NiftiDataType;
+template <> struct NiftiDataType<int16_t> { static const int16_t value = 4; };
+template <> struct NiftiDataType<float> { static const int16_t value = 16; };
+
+//Header for a 3D ITK image, with its geometry as both qform and sform
+//(scanner coordinates), as ITK's NiftiImageIO writes it. ITK works in
+//LPS; NIfTI is RAS, so x and y change sign.
+template <class TImage>
+NiftiHeader GetNiftiHeader(const TImage *image){
+
+  NiftiHeader hdr;
+  std::memset(&hdr, 0, sizeof(hdr));
+
+  const typename TImage::SizeType &size = image->GetLargestPossibleRegion().GetSize();
+  const typename TImage::SpacingType &spacing = image->GetSpacing();
+  const typename TImage::PointType &origin = image->GetOrigin();
+  const typename TImage::DirectionType &direction = image->GetDirection();
+
+  hdr.sizeof_hdr = 348;
+  hdr.regular = 'r';
+  hdr.dim[0] = 3;
+  hdr.pixdim[0] = 1.0f;
+  for (unsigned int k = 0; k < 3; k++) {
+    hdr.dim[k + 1] = static_cast<int16_t>(size[k]);
+    hdr.pixdim[k + 1] = static_cast<float>(spacing[k]);
+  }
+  for (unsigned int k = 4; k < 8; k++) {
+    hdr.dim[k] = 1;
+    hdr.pixdim[k] = 1.0f;
+  }
+
+  hdr.datatype = NiftiDataType<typename TImage::PixelType>::value;
+  hdr.bitpix = static_cast<int16_t>(8 * sizeof(typename TImage::PixelType));
+
+  //Header plus an empty extension block.
+  hdr.vox_offset = 352.0f;
+  hdr.scl_slope = 1.0f;
+  hdr.xyzt_units = 2 | 8;  //mm, s
+
+  //Voxel index to RAS: rotation r, and the image's own axes.
+  const double sign[3] = { -1.0, -1.0, 1.0 };
+  double r[3][3];
+  float *srow[3] = { hdr.srow_x, hdr.srow_y, hdr.srow_z };
+
+  for (unsigned int i = 0; i < 3; i++) {
+    for (unsigned int k = 0; k < 3; k++) {
+      r[i][k] = sign[i] * direction[i][k];
+      srow[i][k] = static_cast<float>(r[i][k] * spacing[k]);
+    }
+    srow[i][3] = static_cast<float>(sign[i] * origin[i]);
+  }
+
+  hdr.qform_code = 1;
+  hdr.sform_code = 1;
+  hdr.qoffset_x = hdr.srow_x[3];
+  hdr.qoffset_y = hdr.srow_y[3];
+  hdr.qoffset_z = hdr.srow_z[3];
+
+  //Quaternion of r (as nifti_mat44_to_quatern). A left-handed r is
+  //stored with its third column flipped and qfac (pixdim[0]) = -1.
+  const double det = r[0][0] * (r[1][1] * r[2][2] - r[1][2] * r[2][1])
+                   - r[0][1] * (r[1][0] * r[2][2] - r[1][2] * r[2][0])
+                   + r[0][2] * (r[1][0] * r[2][1] - r[1][1] * r[2][0]);
+  if (det < 0.0) {
+    hdr.pixdim[0] = -1.0f;
+    for (unsigned int i = 0; i < 3; i++)
+      r[i][2] = -r[i][2];
+  }
+
+  double a = r[0][0] + r[1][1] + r[2][2] + 1.0;
+  double b, c, d;
+
+  if (a > 0.5) {
+    a = 0.5 * std::sqrt(a);
+    b = 0.25 * (r[2][1] - r[1][2]) / a;
+    c = 0.25 * (r[0][2] - r[2][0]) / a;
+    d = 0.25 * (r[1][0] - r[0][1]) / a;
+  }
+  else {
+    const double xd = 1.0 + r[0][0] - (r[1][1] + r[2][2]);
+    const double yd = 1.0 + r[1][1] - (r[0][0] + r[2][2]);
+    const double zd = 1.0 + r[2][2] - (r[0][0] + r[1][1]);
+
+    if (xd > 1.0) {
+      b = 0.5 * std::sqrt(xd);
+      c = 0.25 * (r[0][1] + r[1][0]) / b;
+      d = 0.25 * (r[0][2] + r[2][0]) / b;
+      a = 0.25 * (r[2][1] - r[1][2]) / b;
+    }
+    else if (yd > 1.0) {
+      c = 0.5 * std::sqrt(yd);
+      b = 0.25 * (r[0][1] + r[1][0]) / c;
+      d = 0.25 * (r[1][2] + r[2][1]) / c;
+      a = 0.25 * (r[0][2] - r[2][0]) / c;
+    }
+    else {
+      d = 0.5 * std::sqrt(zd);
+      b = 0.25 * (r[0][2] + r[2][0]) / d;
+      c = 0.25 * (r[1][2] + r[2][1]) / d;
+      a = 0.25 * (r[1][0] - r[0][1]) / d;
+    }
+
+    if (a < 0.0) {
+      b = -b;
+      c = -c;
+      d = -d;
+    }
+  }
+
+  hdr.quatern_b = static_cast<float>(b);
+  hdr.quatern_c = static_cast<float>(c);
+  hdr.quatern_d = static_cast<float>(d);
+
+  std::memcpy(hdr.magic, "n+1", 4);
+
+  return hdr;
+}
+
+//Write image to dst as a gzipped single-file NIfTI (.nii.gz), feeding
+//the header and image buffer straight to a ParallelGzipWriter. dst is
+//removed if anything fails.
+template <class TImage>
+bool WriteCompressedNifti(const TImage *image, const boost::filesystem::path &dst,
+                          int level = Z_DEFAULT_COMPRESSION, unsigned int numThreads = 0){
+
+  const NiftiHeader hdr = GetNiftiHeader(image);
+  const char extension[4] = { 0, 0, 0, 0 };
+
+  const std::size_t numBytes = image->GetLargestPossibleRegion().GetNumberOfPixels() *
+    sizeof(typename TImage::PixelType);
+
+  ParallelGzipWriter writer(level, numThreads);
+
+  bool bStatus = writer.Open(dst) &&
+                 writer.Write(reinterpret_cast<const char*>(&hdr), sizeof(hdr)) &&
+                 writer.Write(extension, sizeof(extension)) &&
+                 writer.Write(reinterpret_cast<const char*>(image->GetBufferPointer()), numBytes);
+
+  bStatus = writer.Close() && bStatus;
+
+  if (!bStatus) {
+    LOG(ERROR) << "Unable to write " << dst;
+    boost::system::error_code ec;
+    boost::filesystem::remove(dst, ec);
+  }
+
+  return bStatus;
+}
+
+} //namespace nmtools
+
+#endif
@@ -0,0 +1,255 @@
+/*
+   Orientation.hpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Re-orienting volumes by axis permutation/flip without copying them.
+ */
+
+#ifndef ORIENTATION_HPP
+#define ORIENTATION_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <vector>
+
+#include <itkImage.h>
+#include <itkSpatialOrientation.h>
+#include <itkSpatialOrientationAdapter.h>
+
+#include "MuMapKernels.hpp"
+#include "Parallel.hpp"
+#include "Resample.hpp"
+
+namespace nmtools {
+
+//How to index an image so that it has a requested orientation: output
+//axis j runs along input axis axis[j], reversed if flip[j]. This is what
+//itk::OrientImageFilter applies (with UseImageDirectionOn), but here it
+//is kept as a mapping and applied by the stage that reads the voxels.
+struct AxisMapping {
+  unsigned int axis[3] = {0, 1, 2};
+  bool flip[3] = {false, false, false};
+
+  bool IsIdentity() const {
+    for (unsigned int j = 0; j < 3; j++)
+      if (axis[j] != j || flip[j])
+        return false;
+    return true;
+  }
+};
+
+//Mapping from an image with the given direction cosines to the desired
+//orientation. Oblique directions are taken to the closest orientation,
+//as itk::OrientImageFilter does.
+AxisMapping ComputeAxisMapping(const itk::SpatialOrientationAdapter::DirectionType &direction,
+                               itk::SpatialOrientation::ValidCoordinateOrientationFlags desired){
+
+  itk::SpatialOrientationAdapter adapter;
+
+  const itk::SpatialOrientationAdapter::DirectionType current =
+    adapter.ToDirectionCosines(adapter.FromDirectionCosines(direction));
+  const itk::SpatialOrientationAdapter::DirectionType target =
+    adapter.ToDirectionCosines(desired);
+
+  AxisMapping mapping;
+
+  for (unsigned int j = 0; j < 3; j++) {
+    for (unsigned int i = 0; i < 3; i++) {
+      double m = 0.0;
+      for (unsigned int r = 0; r < 3; r++)
+        m += current[r][i] * target[r][j];
+
+      if (std::fabs(m) > 0.5) {
+        mapping.axis[j] = i;
+        mapping.flip[j] = m < 0.0;
+      }
+    }
+  }
+
+  return mapping;
+}
+
+//True if the direction cosines of a and b agree to within tol. An image
+//mapped with ComputeAxisMapping() is only snapped to the closest axes,
+//so it keeps any obliquity: it can be resampled onto another grid
+//index by index (AxisAlignedResampler) only if this holds.
+template <class TDirection>
+bool IsSameDirection(const TDirection &a, const TDirection &b, double tol = 1e-3){
+
+  for (unsigned int r = 0; r < 3; r++)
+    for (unsigned int k = 0; k < 3; k++)
+      if (std::fabs(a[r][k] - b[r][k]) > tol)
+        return false;
+
+  return true;
+}
+
+//Geometry of image once mapped, as an image of type TOutputImage with
+//size, spacing, origin and direction set but no buffer. Physical
+//positions of voxels are unchanged.
+template <class TOutputImage, class TInputImage>
+typename TOutputImage::Pointer GetMappedGeometry(const TInputImage *image, const AxisMapping &mapping){
+
+  const typename TInputImage::SizeType &size = image->GetBufferedRegion().GetSize();
+  const typename TInputImage::SpacingType &spacing = image->GetSpacing();
+  const typename TInputImage::DirectionType &direction = image->GetDirection();
+
+  typename TOutputImage::SizeType mappedSize;
+  typename TOutputImage::SpacingType mappedSpacing;
+  typename TOutputImage::DirectionType mappedDirection;
+  typename TInputImage::IndexType firstVoxel;
+
+  for (unsigned int j = 0; j < 3; j++) {
+    const unsigned int i = mapping.axis[j];
+    mappedSize[j] = size[i];
+    mappedSpacing[j] = spacing[i];
+    for (unsigned int r = 0; r < 3; r++)
+      mappedDirection[r][j] = mapping.flip[j] ? -direction[r][i] : direction[r][i];
+    firstVoxel[i] = image->GetBufferedRegion().GetIndex()[i] +
+                    (mapping.flip[j] ? static_cast<long>(size[i]) - 1 : 0);
+  }
+
+  typename TOutputImage::PointType mappedOrigin;
+  image->TransformIndexToPhysicalPoint(firstVoxel, mappedOrigin);
+
+  typename TOutputImage::RegionType region;
+  region.SetSize(mappedSize);
+
+  typename TOutputImage::Pointer geometry = TOutputImage::New();
+  geometry->SetRegions(region);
+  geometry->SetSpacing(mappedSpacing);
+  geometry->SetOrigin(mappedOrigin);
+  geometry->SetDirection(mappedDirection);
+
+  return geometry;
+}
+
+//View of image's buffer in mapped index order (no copy).
+template <class TImage>
+VolumeView<typename TImage::PixelType> MakeMappedView(const TImage *image, const AxisMapping &mapping){
+
+  const VolumeView<typename TImage::PixelType> in = MakeVolumeView(image);
+  VolumeView<typename TImage::PixelType> out;
+
+  out.data = in.data;
+  for (unsigned int j = 0; j < 3; j++) {
+    const unsigned int i = mapping.axis[j];
+    out.size[j] = in.size[i];
+    out.stride[j] = mapping.flip[j] ? -in.stride[i] : in.stride[i];
+    if (mapping.flip[j])
+      out.data += static_cast<std::ptrdiff_t>(in.size[i] - 1) * in.stride[i];
+  }
+
+  return out;
+}
+
+//Writes dst[i] = view[i] / divisor in the view's index order, gathering
+//statistics as it goes. Slices are done in parallel; when x is not the
+//fastest-varying axis of the source, each slice is copied in square
+//tiles so reads and writes both stay in cache. When z is (sagittal or
+//coronal acquisitions), each tile also spans a block of slices, so a
+//source cache line is used up before it is evicted.
+template <typename TInputPixel, typename TOutputPixel>
+void ScaleAndComputeStatistics(const VolumeView<TInputPixel> &in, TOutputPixel *dst,
+                               float divisor, MuMapStatistics &stats){
+
+  const std::size_t nx = in.size[0];
+  const std::size_t ny = in.size[1];
+  const std::size_t nz = in.size[2];
+  const std::size_t sliceSize = nx * ny;
+  const std::ptrdiff_t sx = in.stride[0];
+  const std::ptrdiff_t sy = in.stride[1];
+  const std::ptrdiff_t sz = in.stride[2];
+  const std::size_t tile = 32;
+  const std::size_t zTile = 16;
+
+  const unsigned int numThreads = GetDefaultNumberOfThreads();
+  std::vector<PartialStatistics> partials(numThreads);
+
+  const bool isZFastest = std::abs(sz) < std::abs(sx) && std::abs(sz) < std::abs(sy);
+
+  if (isZFastest) {
+    ParallelFor(0, nz, [&](std::size_t zFirst, std::size_t zLast, unsigned int chunk){
+
+      for (std::size_t zt = zFirst; zt < zLast; zt += zTile) {
+        const std::size_t zEnd = std::min(zLast, zt + zTile);
+        const TInputPixel *src = in.data + static_cast<std::ptrdiff_t>(zt) * sz;
+
+        for (std::size_t yt = 0; yt < ny; yt += tile) {
+          const std::size_t yEnd = std::min(ny, yt + tile);
+          for (std::size_t xt = 0; xt < nx; xt += tile) {
+            const std::size_t xEnd = std::min(nx, xt + tile);
+            for (std::size_t y = yt; y < yEnd; y++)
+              for (std::size_t x = xt; x < xEnd; x++) {
+                const TInputPixel *column = src + static_cast<std::ptrdiff_t>(y) * sy +
+                                            static_cast<std::ptrdiff_t>(x) * sx;
+                TOutputPixel *out = dst + zt * sliceSize + y * nx + x;
+                for (std::size_t z = zt; z < zEnd; z++, column += sz, out += sliceSize)
+                  *out = static_cast<TOutputPixel>(static_cast<float>(*column) / divisor);
+              }
+          }
+        }
+
+        for (std::size_t z = zt; z < zEnd; z++)
+          partials[chunk].Add(dst + z * sliceSize, sliceSize, stats);
+      }
+    }, numThreads);
+
+    MergeStatistics(partials, stats);
+    return;
+  }
+
+  ParallelFor(0, nz, [&](std::size_t zFirst, std::size_t zLast, unsigned int chunk){
+
+    for (std::size_t z = zFirst; z < zLast; z++) {
+
+      const TInputPixel *src = in.data + static_cast<std::ptrdiff_t>(z) * sz;
+      TOutputPixel *out = dst + z * sliceSize;
+
+      if (sx == 1) {
+        for (std::size_t y = 0; y < ny; y++) {
+          const TInputPixel *row = src + static_cast<std::ptrdiff_t>(y) * sy;
+          TOutputPixel *outRow = out + y * nx;
+          for (std::size_t x = 0; x < nx; x++)
+            outRow[x] = static_cast<TOutputPixel>(static_cast<float>(row[x]) / divisor);
+        }
+      }
+      else {
+        for (std::size_t yt = 0; yt < ny; yt += tile) {
+          const std::size_t yEnd = std::min(ny, yt + tile);
+          for (std::size_t xt = 0; xt < nx; xt += tile) {
+            const std::size_t xEnd = std::min(nx, xt + tile);
+            for (std::size_t y = yt; y < yEnd; y++) {
+              const TInputPixel *row = src + static_cast<std::ptrdiff_t>(y) * sy;
+              TOutputPixel *outRow = out + y * nx;
+              for (std::size_t x = xt; x < xEnd; x++)
+                outRow[x] = static_cast<TOutputPixel>(static_cast<float>(row[static_cast<std::ptrdiff_t>(x) * sx]) / divisor);
+            }
+          }
+        }
+      }
+
+      partials[chunk].Add(out, sliceSize, stats);
+    }
+  }, numThreads);
+
+  MergeStatistics(partials, stats);
+}
+
+} //namespace nmtools
+
+#endif
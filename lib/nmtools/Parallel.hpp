@@ -0,0 +1,243 @@
+/*
+   Parallel.hpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Simple multithreading helpers for voxel-wise and slice-wise kernels.
+ */
+
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace nmtools {
+
+//Number of threads used when none is given explicitly.
+//0 = use all available cores.
+static unsigned int g_defaultNumberOfThreads = 0;
+
+//Override for the calling thread only (see ScopedNumberOfThreads).
+//0 = none.
+static thread_local unsigned int t_numberOfThreads = 0;
+
+void SetDefaultNumberOfThreads(unsigned int numThreads){
+  g_defaultNumberOfThreads = numThreads;
+}
+
+unsigned int GetDefaultNumberOfThreads(){
+
+  if (t_numberOfThreads > 0)
+    return t_numberOfThreads;
+
+  if (g_defaultNumberOfThreads > 0)
+    return g_defaultNumberOfThreads;
+
+  unsigned int numThreads = std::thread::hardware_concurrency();
+
+  if (numThreads == 0)
+    numThreads = 1;
+
+  return numThreads;
+}
+
+//Sets the number of threads used by kernels called from this thread,
+//until it goes out of scope. Lets concurrent jobs share out the cores
+//without touching the process-wide default.
+class ScopedNumberOfThreads {
+
+public:
+
+  explicit ScopedNumberOfThreads(unsigned int numThreads)
+    : _previous(t_numberOfThreads)
+  { t_numberOfThreads = numThreads; };
+
+  ~ScopedNumberOfThreads(){ t_numberOfThreads = _previous; };
+
+  ScopedNumberOfThreads(const ScopedNumberOfThreads&) = delete;
+  ScopedNumberOfThreads& operator=(const ScopedNumberOfThreads&) = delete;
+
+protected:
+
+  unsigned int _previous;
+
+};
+
+//Split [begin,end) into at most numThreads contiguous chunks and call
+//fn(first, last, chunk) for each on its own thread, where chunk is the
+//0-based chunk number (useful for per-thread scratch space). Blocks until
+//all chunks are done. The first exception thrown by any chunk is re-thrown
+//in the calling thread.
+template <typename TFunction>
+void ParallelFor(std::size_t begin, std::size_t end, TFunction fn, unsigned int numThreads = 0){
+
+  if (end <= begin)
+    return;
+
+  if (numThreads == 0)
+    numThreads = GetDefaultNumberOfThreads();
+
+  const std::size_t total = end - begin;
+  const std::size_t numChunks = std::min<std::size_t>(numThreads, total);
+
+  if (numChunks <= 1) {
+    fn(begin, end, 0u);
+    return;
+  }
+
+  std::exception_ptr firstError = nullptr;
+  std::mutex errorMutex;
+
+  auto runChunk = [&](std::size_t first, std::size_t last, unsigned int chunk){
+    try {
+      fn(first, last, chunk);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(errorMutex);
+      if (!firstError)
+        firstError = std::current_exception();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  workers.reserve(numChunks - 1);
+
+  const std::size_t chunkSize = total / numChunks;
+  const std::size_t remainder = total % numChunks;
+
+  std::size_t first = begin;
+  for (unsigned int c = 0; c < numChunks; c++) {
+    std::size_t last = first + chunkSize + (c < remainder ? 1 : 0);
+
+    //Run the final chunk on the calling thread.
+    if (c == numChunks - 1)
+      runChunk(first, last, c);
+    else
+      workers.emplace_back(runChunk, first, last, c);
+
+    first = last;
+  }
+
+  for (auto &w : workers)
+    w.join();
+
+  if (firstError)
+    std::rethrow_exception(firstError);
+}
+
+//Fixed-size pool of worker threads consuming a FIFO task queue. Suited
+//to many independent jobs of uneven duration (e.g. file reads).
+class ThreadPool {
+
+public:
+
+  //0 = use GetDefaultNumberOfThreads().
+  explicit ThreadPool(unsigned int numThreads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  //Queue fn for execution. The returned future yields fn's result, or
+  //re-throws the exception it threw.
+  template <typename TFunction>
+  std::future<typename std::result_of<TFunction()>::type> Submit(TFunction fn);
+
+  unsigned int GetNumberOfThreads() const { return static_cast<unsigned int>(_workers.size()); };
+
+protected:
+
+  void WorkerLoop();
+
+  std::vector<std::thread> _workers;
+  std::queue< std::function<void()> > _tasks;
+
+  std::mutex _mutex;
+  std::condition_variable _condition;
+  bool _stopping = false;
+
+};
+
+ThreadPool::ThreadPool(unsigned int numThreads){
+
+  if (numThreads == 0)
+    numThreads = GetDefaultNumberOfThreads();
+
+  for (unsigned int i = 0; i < numThreads; i++)
+    _workers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+//Finish queued tasks, then join the workers.
+ThreadPool::~ThreadPool(){
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+
+  _condition.notify_all();
+
+  for (auto &w : _workers)
+    w.join();
+}
+
+void ThreadPool::WorkerLoop(){
+
+  while (true) {
+    std::function<void()> task;
+
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _condition.wait(lock, [this]{ return _stopping || !_tasks.empty(); });
+
+      if (_stopping && _tasks.empty())
+        return;
+
+      task = std::move(_tasks.front());
+      _tasks.pop();
+    }
+
+    task();
+  }
+}
+
+template <typename TFunction>
+std::future<typename std::result_of<TFunction()>::type> ThreadPool::Submit(TFunction fn){
+
+  typedef typename std::result_of<TFunction()>::type ResultType;
+
+  auto task = std::make_shared< std::packaged_task<ResultType()> >(fn);
+  std::future<ResultType> result = task->get_future();
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _tasks.push([task](){ (*task)(); });
+  }
+
+  _condition.notify_one();
+
+  return result;
+}
+
+} //namespace nmtools
+
+#endif
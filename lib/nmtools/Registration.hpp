@@ -0,0 +1,639 @@
+/*
+   Registration.hpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Rigid registration of mu-maps to (NAC) PET images.
+ */
+
+#ifndef REGISTRATION_HPP
+#define REGISTRATION_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include <itkImage.h>
+
+#include "MuMapKernels.hpp"
+#include "Parallel.hpp"
+#include "Smoothing.hpp"
+
+namespace nmtools {
+
+//Distance (mm) from the centre of rotation at which the registration
+//measures rotations, so they can be stepped like translations.
+const double kRotationRadius = 100.0;
+
+//Rotation (radians, about x, then y, then z) about centre, then
+//translation (mm): y = R (x - centre) + centre + translation. Maps points
+//of the fixed image's space to the moving image's.
+struct RigidTransform {
+  double angles[3] = {0.0, 0.0, 0.0};
+  double translation[3] = {0.0, 0.0, 0.0};
+  double centre[3] = {0.0, 0.0, 0.0};
+
+  //As a 3x4 matrix (rows).
+  void GetMatrix(double m[12]) const;
+};
+
+void RigidTransform::GetMatrix(double m[12]) const {
+
+  const double cx = std::cos(angles[0]), sx = std::sin(angles[0]);
+  const double cy = std::cos(angles[1]), sy = std::sin(angles[1]);
+  const double cz = std::cos(angles[2]), sz = std::sin(angles[2]);
+
+  //Rz Ry Rx
+  const double r[9] = { cz*cy, cz*sy*sx - sz*cx, cz*sy*cx + sz*sx,
+                        sz*cy, sz*sy*sx + cz*cx, sz*sy*cx - cz*sx,
+                        -sy,   cy*sx,            cy*cx };
+
+  for (unsigned int i = 0; i < 3; i++) {
+    m[4*i + 3] = centre[i] + translation[i];
+    for (unsigned int j = 0; j < 3; j++) {
+      m[4*i + j] = r[3*i + j];
+      m[4*i + 3] -= r[3*i + j] * centre[j];
+    }
+  }
+}
+
+//a(b(x)) for 3x4 affine matrices.
+void ComposeAffine(const double a[12], const double b[12], double out[12]){
+
+  for (unsigned int i = 0; i < 3; i++) {
+    for (unsigned int j = 0; j < 4; j++) {
+      double v = j == 3 ? a[4*i + 3] : 0.0;
+      for (unsigned int k = 0; k < 3; k++)
+        v += a[4*i + k] * b[4*k + j];
+      out[4*i + j] = v;
+    }
+  }
+}
+
+//Voxel grid of an image: size and index <-> physical point maps (3x4).
+//Directions are taken to be orthonormal, as ITK's are.
+struct VoxelGeometry {
+  std::size_t size[3] = {0, 0, 0};
+  double toPhysical[12];
+  double toIndex[12];
+
+  VoxelGeometry(){};
+
+  template <class TImage>
+  explicit VoxelGeometry(const TImage *image, unsigned int shrink = 1);
+};
+
+//Every shrink-th voxel of image (from the first).
+template <class TImage>
+VoxelGeometry::VoxelGeometry(const TImage *image, unsigned int shrink){
+
+  const typename TImage::SizeType &imageSize = image->GetLargestPossibleRegion().GetSize();
+
+  for (unsigned int i = 0; i < 3; i++) {
+    size[i] = (imageSize[i] + shrink - 1) / shrink;
+
+    toPhysical[4*i + 3] = image->GetOrigin()[i];
+    toIndex[4*i + 3] = 0.0;
+
+    for (unsigned int j = 0; j < 3; j++) {
+      const double step = image->GetSpacing()[j] * shrink;
+      toPhysical[4*i + j] = image->GetDirection()[i][j] * step;
+      //Inverse: diag(1/step) D^T.
+      toIndex[4*j + i] = image->GetDirection()[i][j] / step;
+    }
+  }
+
+  for (unsigned int i = 0; i < 3; i++)
+    for (unsigned int j = 0; j < 3; j++)
+      toIndex[4*i + 3] -= toIndex[4*i + j] * toPhysical[4*j + 3];
+}
+
+//Normalised gradient field of a smoothed, subsampled volume: the
+//physical gradient g scaled by 1/sqrt(|g|^2 + epsilon^2), where epsilon
+//is the mean gradient magnitude (so noise and flat regions fade out).
+struct GradientVolume {
+  VoxelGeometry geometry;
+  std::vector<float> gradient;   //x, y, z per voxel
+  std::vector<float> magnitude;  //|g| / epsilon
+};
+
+//Gradients of image at one pyramid level: smoothed with a Gaussian of
+//about half the shrink factor (at least one voxel), then sampled every
+//shrink voxels. Slices are processed in parallel.
+template <class TImage>
+void ComputeGradientVolume(const TImage *image, unsigned int shrink, GradientVolume &out){
+
+  const typename TImage::SizeType &imageSize = image->GetLargestPossibleRegion().GetSize();
+
+  std::size_t size[3];
+  double sigma[3];
+  for (unsigned int k = 0; k < 3; k++) {
+    size[k] = imageSize[k];
+    sigma[k] = 0.5 * shrink + 0.5;
+  }
+
+  std::vector<float> smoothed(image->GetBufferPointer(),
+                              image->GetBufferPointer() + size[0] * size[1] * size[2]);
+  SmoothGaussian(smoothed.data(), size, sigma);
+
+  out.geometry = VoxelGeometry(image, shrink);
+
+  const std::size_t nx = out.geometry.size[0];
+  const std::size_t ny = out.geometry.size[1];
+  const std::size_t nz = out.geometry.size[2];
+  const std::size_t numVoxels = nx * ny * nz;
+
+  out.gradient.assign(3 * numVoxels, 0.0f);
+  out.magnitude.assign(numVoxels, 0.0f);
+
+  //Index-space differences to physical gradient: D diag(1/step).
+  double toGradient[9];
+  for (unsigned int i = 0; i < 3; i++)
+    for (unsigned int j = 0; j < 3; j++)
+      toGradient[3*i + j] = image->GetDirection()[i][j] / (image->GetSpacing()[j] * shrink);
+
+  const unsigned int numThreads = GetDefaultNumberOfThreads();
+  std::vector<double> sums(numThreads, 0.0);
+  std::vector<std::size_t> counts(numThreads, 0);
+
+  ParallelFor(0, nz, [&](std::size_t zFirst, std::size_t zLast, unsigned int chunk){
+
+    auto at = [&](std::size_t x, std::size_t y, std::size_t z){
+      return smoothed[((z * shrink) * size[1] + y * shrink) * size[0] + x * shrink];
+    };
+
+    for (std::size_t z = zFirst; z < zLast; z++) {
+      for (std::size_t y = 0; y < ny; y++) {
+        for (std::size_t x = 0; x < nx; x++) {
+          const std::size_t pos[3] = { x, y, z };
+          double d[3];
+
+          //Central differences, one-sided at the edges.
+          for (unsigned int k = 0; k < 3; k++) {
+            std::size_t lo[3] = { x, y, z };
+            std::size_t hi[3] = { x, y, z };
+            const std::size_t n = out.geometry.size[k];
+            lo[k] = pos[k] > 0 ? pos[k] - 1 : pos[k];
+            hi[k] = pos[k] + 1 < n ? pos[k] + 1 : pos[k];
+            d[k] = hi[k] > lo[k] ? (at(hi[0], hi[1], hi[2]) - at(lo[0], lo[1], lo[2])) /
+                                   static_cast<double>(hi[k] - lo[k]) : 0.0;
+          }
+
+          const std::size_t i = (z * ny + y) * nx + x;
+          double m2 = 0.0;
+          for (unsigned int r = 0; r < 3; r++) {
+            const double g = toGradient[3*r] * d[0] + toGradient[3*r + 1] * d[1] + toGradient[3*r + 2] * d[2];
+            out.gradient[3*i + r] = static_cast<float>(g);
+            m2 += g * g;
+          }
+
+          out.magnitude[i] = static_cast<float>(std::sqrt(m2));
+          if (m2 > 0.0) {
+            sums[chunk] += out.magnitude[i];
+            counts[chunk]++;
+          }
+        }
+      }
+    }
+  }, numThreads);
+
+  double sum = 0.0;
+  std::size_t count = 0;
+  for (unsigned int c = 0; c < numThreads; c++) {
+    sum += sums[c];
+    count += counts[c];
+  }
+
+  const float epsilon = count > 0 ? static_cast<float>(sum / count) : 1.0f;
+
+  ParallelFor(0, numVoxels, [&](std::size_t first, std::size_t last, unsigned int){
+    for (std::size_t i = first; i < last; i++) {
+      const float scale = 1.0f / std::sqrt(out.magnitude[i] * out.magnitude[i] + epsilon * epsilon);
+      for (unsigned int r = 0; r < 3; r++)
+        out.gradient[3*i + r] *= scale;
+      out.magnitude[i] /= epsilon;
+    }
+  });
+}
+
+//Rigid registration by normalised gradient fields (Haber & Modersitzki,
+//2006), which suits a mu-map against a non-attenuation corrected PET
+//image: only the directions of their edges need to agree. The metric is
+//the mean of (n_F(x) . R^T n_M(T(x)))^2 over a sparse set of points on
+//the fixed image's edges, evaluated in parallel. Each level of the
+//pyramid (coarse to fine) precomputes both gradient fields once; the
+//transform is refined by regular-step gradient ascent with central
+//differences.
+class RigidRegistration {
+
+public:
+
+  typedef itk::Image<float, 3> ImageType;
+
+  void SetFixedImage(const ImageType *image){ _fixed = image; };
+  void SetMovingImage(const ImageType *image){ _moving = image; };
+
+  //Shrink factors of the pyramid, coarse to fine. Default 4, 2, 1.
+  void SetShrinkFactors(const std::vector<unsigned int> &factors){ _shrinkFactors = factors; };
+
+  //Most fixed-image points used per level. Default 200000.
+  void SetMaximumNumberOfSamples(std::size_t n){ _maxSamples = n; };
+
+  bool Update();
+
+  //From fixed-image space to moving-image space.
+  const RigidTransform& GetTransform() const { return _transform; };
+
+  //Final metric value, in [0, 1] (1 = all sampled edges aligned).
+  double GetMetricValue() const { return _metric; };
+
+protected:
+
+  struct Sample {
+    float point[3];   //physical
+    float normal[3];  //fixed image's normalised gradient
+  };
+
+  void SelectSamples(const GradientVolume &fixed);
+
+  double Evaluate(const RigidTransform &transform, const GradientVolume &moving) const;
+
+  //Gradient ascent on one level, from _transform.
+  void Optimise(const GradientVolume &moving, double voxelSize);
+
+  //Six parameters: rotations (as displacements, in mm, at
+  //kRotationRadius) and translations (mm).
+  void ToParameters(const RigidTransform &transform, double p[6]) const;
+  RigidTransform FromParameters(const double p[6]) const;
+
+  const ImageType *_fixed = nullptr;
+  const ImageType *_moving = nullptr;
+
+  std::vector<unsigned int> _shrinkFactors = {4, 2, 1};
+  std::size_t _maxSamples = 200000;
+
+  std::vector<Sample> _samples;
+  RigidTransform _transform;
+  double _metric = 0.0;
+
+};
+
+void RigidRegistration::ToParameters(const RigidTransform &transform, double p[6]) const {
+
+  for (unsigned int k = 0; k < 3; k++) {
+    p[k] = transform.angles[k] * kRotationRadius;
+    p[k + 3] = transform.translation[k];
+  }
+}
+
+RigidTransform RigidRegistration::FromParameters(const double p[6]) const {
+
+  RigidTransform transform = _transform;
+  for (unsigned int k = 0; k < 3; k++) {
+    transform.angles[k] = p[k] / kRotationRadius;
+    transform.translation[k] = p[k + 3];
+  }
+
+  return transform;
+}
+
+//Points where the fixed image has a clear edge (|g| > epsilon), spread
+//evenly if there are more than _maxSamples.
+void RigidRegistration::SelectSamples(const GradientVolume &fixed){
+
+  std::size_t numEdges = 0;
+  for (float m : fixed.magnitude)
+    numEdges += m > 1.0f;
+
+  const std::size_t stride = std::max<std::size_t>(1, (numEdges + _maxSamples - 1) / _maxSamples);
+  const VoxelGeometry &geometry = fixed.geometry;
+
+  _samples.clear();
+  _samples.reserve(numEdges / stride + 1);
+
+  std::size_t n = 0;
+  for (std::size_t z = 0; z < geometry.size[2]; z++) {
+    for (std::size_t y = 0; y < geometry.size[1]; y++) {
+      for (std::size_t x = 0; x < geometry.size[0]; x++) {
+        const std::size_t i = (z * geometry.size[1] + y) * geometry.size[0] + x;
+        if (!(fixed.magnitude[i] > 1.0f) || n++ % stride != 0)
+          continue;
+
+        Sample sample;
+        for (unsigned int r = 0; r < 3; r++) {
+          const double *m = &geometry.toPhysical[4*r];
+          sample.point[r] = static_cast<float>(m[0] * x + m[1] * y + m[2] * z + m[3]);
+          sample.normal[r] = fixed.gradient[3*i + r];
+        }
+        _samples.push_back(sample);
+      }
+    }
+  }
+}
+
+double RigidRegistration::Evaluate(const RigidTransform &transform, const GradientVolume &moving) const {
+
+  double matrix[12];
+  transform.GetMatrix(matrix);
+
+  //Fixed physical point to moving index.
+  double toMoving[12];
+  ComposeAffine(moving.geometry.toIndex, matrix, toMoving);
+
+  float m[12];
+  for (unsigned int k = 0; k < 12; k++)
+    m[k] = static_cast<float>(toMoving[k]);
+
+  float rotation[9];
+  for (unsigned int i = 0; i < 3; i++)
+    for (unsigned int j = 0; j < 3; j++)
+      rotation[3*i + j] = static_cast<float>(matrix[4*i + j]);
+
+  const std::size_t nx = moving.geometry.size[0];
+  const std::size_t ny = moving.geometry.size[1];
+  const std::size_t nz = moving.geometry.size[2];
+  const float limits[3] = { nx - 1.0f, ny - 1.0f, nz - 1.0f };
+  const float *g = moving.gradient.data();
+
+  const unsigned int numThreads = GetDefaultNumberOfThreads();
+  std::vector<double> sums(numThreads, 0.0);
+
+  ParallelFor(0, _samples.size(), [&](std::size_t first, std::size_t last, unsigned int chunk){
+
+    double sum = 0.0;
+
+    for (std::size_t s = first; s < last; s++) {
+      const Sample &sample = _samples[s];
+      const float *p = sample.point;
+
+      float c[3];
+      bool inside = true;
+      for (unsigned int r = 0; r < 3; r++) {
+        c[r] = m[4*r] * p[0] + m[4*r + 1] * p[1] + m[4*r + 2] * p[2] + m[4*r + 3];
+        inside = inside && c[r] >= 0.0f && c[r] <= limits[r];
+      }
+
+      if (!inside)
+        continue;
+
+      const std::size_t x0 = static_cast<std::size_t>(c[0]);
+      const std::size_t y0 = static_cast<std::size_t>(c[1]);
+      const std::size_t z0 = static_cast<std::size_t>(c[2]);
+      const std::size_t dx = x0 + 1 < nx ? 3 : 0;
+      const std::size_t dy = y0 + 1 < ny ? 3 * nx : 0;
+      const std::size_t dz = z0 + 1 < nz ? 3 * nx * ny : 0;
+      const float fx = c[0] - x0, fy = c[1] - y0, fz = c[2] - z0;
+
+      const float *v = g + 3 * ((z0 * ny + y0) * nx + x0);
+
+      //R n_F . n_M(T(x)), which equals n_F . R^T n_M.
+      float dot = 0.0f;
+      for (unsigned int r = 0; r < 3; r++) {
+        const float a = v[r] + fx * (v[r + dx] - v[r]);
+        const float b = v[r + dy] + fx * (v[r + dy + dx] - v[r + dy]);
+        const float c0 = v[r + dz] + fx * (v[r + dz + dx] - v[r + dz]);
+        const float d = v[r + dz + dy] + fx * (v[r + dz + dy + dx] - v[r + dz + dy]);
+        const float e = a + fy * (b - a);
+        const float f = c0 + fy * (d - c0);
+        const float rn = rotation[3*r] * sample.normal[0] + rotation[3*r + 1] * sample.normal[1] +
+                         rotation[3*r + 2] * sample.normal[2];
+        dot += rn * (e + fz * (f - e));
+      }
+
+      sum += dot * dot;
+    }
+
+    sums[chunk] += sum;
+  }, numThreads);
+
+  double total = 0.0;
+  for (double s : sums)
+    total += s;
+
+  return _samples.empty() ? 0.0 : total / _samples.size();
+}
+
+void RigidRegistration::Optimise(const GradientVolume &moving, double voxelSize){
+
+  const unsigned int maxIterations = 100;
+  const double delta = 0.25 * voxelSize;
+  const double minStep = 0.05 * voxelSize;
+  double step = voxelSize;
+
+  double p[6];
+  ToParameters(_transform, p);
+  _metric = Evaluate(_transform, moving);
+
+  for (unsigned int iteration = 0; iteration < maxIterations && step >= minStep; iteration++) {
+
+    double gradient[6];
+    double norm = 0.0;
+    for (unsigned int k = 0; k < 6; k++) {
+      double q[6];
+      std::copy(p, p + 6, q);
+      q[k] = p[k] + delta;
+      const double up = Evaluate(FromParameters(q), moving);
+      q[k] = p[k] - delta;
+      const double down = Evaluate(FromParameters(q), moving);
+      gradient[k] = (up - down) / (2.0 * delta);
+      norm += gradient[k] * gradient[k];
+    }
+
+    norm = std::sqrt(norm);
+    if (norm == 0.0)
+      break;
+
+    //Take the step if it improves the metric, otherwise halve it.
+    while (step >= minStep) {
+      double q[6];
+      for (unsigned int k = 0; k < 6; k++)
+        q[k] = p[k] + step * gradient[k] / norm;
+
+      const RigidTransform candidate = FromParameters(q);
+      const double value = Evaluate(candidate, moving);
+
+      if (value > _metric) {
+        std::copy(q, q + 6, p);
+        _transform = candidate;
+        _metric = value;
+        break;
+      }
+
+      step *= 0.5;
+    }
+  }
+}
+
+bool RigidRegistration::Update(){
+
+  if (_fixed == nullptr || _moving == nullptr){
+    LOG(ERROR) << "Registration needs fixed and moving images!";
+    return false;
+  }
+
+  //Rotate about the centre of the fixed image.
+  _transform = RigidTransform();
+  const VoxelGeometry fixedGeometry(_fixed);
+  for (unsigned int r = 0; r < 3; r++) {
+    const double *m = &fixedGeometry.toPhysical[4*r];
+    _transform.centre[r] = m[3];
+    for (unsigned int k = 0; k < 3; k++)
+      _transform.centre[r] += m[k] * 0.5 * (fixedGeometry.size[k] - 1.0);
+  }
+
+  for (unsigned int shrink : _shrinkFactors) {
+
+    GradientVolume fixed, moving;
+    ComputeGradientVolume(_fixed, shrink, fixed);
+    ComputeGradientVolume(_moving, shrink, moving);
+
+    SelectSamples(fixed);
+
+    if (_samples.empty()){
+      LOG(ERROR) << "No edges in the fixed image to register to!";
+      return false;
+    }
+
+    double voxelSize = 0.0;
+    for (unsigned int k = 0; k < 3; k++)
+      voxelSize = std::max(voxelSize, _fixed->GetSpacing()[k] * shrink);
+
+    Optimise(moving, voxelSize);
+
+    DLOG(INFO) << "Registration level " << shrink << ": " << _samples.size()
+               << " samples, metric " << _metric;
+  }
+
+  return true;
+}
+
+//Resample input through transform (linear, zero outside) onto the grid
+//of output, whose regions, spacing, origin and direction are set and
+//whose buffer is allocated here: output(x) = input(T(x)). Output voxels
+//where sliceMask (nx * ny of the output, if given) is zero are zero in
+//every slice. Slices run in parallel; if stats is given, it is
+//recomputed on the way.
+bool ResampleRigid(const itk::Image<float, 3> *input, const RigidTransform &transform,
+                   itk::Image<float, 3> *output, const unsigned char *sliceMask = nullptr,
+                   MuMapStatistics *stats = nullptr){
+
+  try {
+    output->Allocate();
+  } catch (itk::ExceptionObject &ex){
+    LOG(ERROR) << "Unable to allocate registered image!";
+    return false;
+  }
+
+  const VoxelGeometry inputGeometry(input);
+  const VoxelGeometry outputGeometry(output);
+
+  double matrix[12], toPhysical[12];
+  transform.GetMatrix(matrix);
+  ComposeAffine(matrix, outputGeometry.toPhysical, toPhysical);
+
+  //Output index to input index.
+  double m[12];
+  ComposeAffine(inputGeometry.toIndex, toPhysical, m);
+
+  const std::size_t nx = outputGeometry.size[0];
+  const std::size_t ny = outputGeometry.size[1];
+  const std::size_t nz = outputGeometry.size[2];
+  const std::size_t sliceSize = nx * ny;
+
+  const std::size_t inSize[3] = { inputGeometry.size[0], inputGeometry.size[1], inputGeometry.size[2] };
+  const std::size_t inSliceSize = inSize[0] * inSize[1];
+  const double limits[3] = { inSize[0] - 1.0, inSize[1] - 1.0, inSize[2] - 1.0 };
+
+  const float *in = input->GetBufferPointer();
+  float *out = output->GetBufferPointer();
+
+  const unsigned int numThreads = GetDefaultNumberOfThreads();
+  std::vector<PartialStatistics> partials(numThreads);
+
+  ParallelFor(0, nz, [&](std::size_t zFirst, std::size_t zLast, unsigned int chunk){
+    for (std::size_t z = zFirst; z < zLast; z++) {
+      for (std::size_t y = 0; y < ny; y++) {
+        float *row = out + z * sliceSize + y * nx;
+
+        for (std::size_t x = 0; x < nx; x++) {
+          double c[3];
+          bool inside = true;
+          for (unsigned int r = 0; r < 3; r++) {
+            c[r] = m[4*r] * x + m[4*r + 1] * y + m[4*r + 2] * z + m[4*r + 3];
+            //Allow for rounding at the edges.
+            if (c[r] > -1e-6 && c[r] < limits[r] + 1e-6)
+              c[r] = std::min(std::max(c[r], 0.0), limits[r]);
+            else
+              inside = false;
+          }
+
+          if (!inside || (sliceMask != nullptr && !sliceMask[y * nx + x])) {
+            row[x] = 0.0f;
+            continue;
+          }
+
+          const std::size_t x0 = static_cast<std::size_t>(c[0]);
+          const std::size_t y0 = static_cast<std::size_t>(c[1]);
+          const std::size_t z0 = static_cast<std::size_t>(c[2]);
+          const std::size_t dx = x0 + 1 < inSize[0] ? 1 : 0;
+          const std::size_t dy = y0 + 1 < inSize[1] ? inSize[0] : 0;
+          const std::size_t dz = z0 + 1 < inSize[2] ? inSliceSize : 0;
+          const float fx = static_cast<float>(c[0] - x0);
+          const float fy = static_cast<float>(c[1] - y0);
+          const float fz = static_cast<float>(c[2] - z0);
+
+          const float *v = in + z0 * inSliceSize + y0 * inSize[0] + x0;
+          const float a = v[0] + fx * (v[dx] - v[0]);
+          const float b = v[dy] + fx * (v[dy + dx] - v[dy]);
+          const float e = v[dz] + fx * (v[dz + dx] - v[dz]);
+          const float f = v[dz + dy] + fx * (v[dz + dy + dx] - v[dz + dy]);
+          const float lo = a + fy * (b - a);
+          const float hi = e + fy * (f - e);
+
+          row[x] = lo + fz * (hi - lo);
+        }
+      }
+
+      if (stats != nullptr)
+        partials[chunk].Add(out + z * sliceSize, sliceSize, *stats);
+    }
+  }, numThreads);
+
+  if (stats != nullptr)
+    MergeStatistics(partials, *stats);
+
+  return true;
+}
+
+//Resample input on its own grid through transform (see above).
+bool ResampleRigid(const itk::Image<float, 3> *input, const RigidTransform &transform,
+                   itk::Image<float, 3>::Pointer &output, MuMapStatistics *stats = nullptr){
+
+  typedef itk::Image<float, 3> ImageType;
+
+  output = ImageType::New();
+  output->SetRegions(input->GetLargestPossibleRegion());
+  output->SetSpacing(input->GetSpacing());
+  output->SetOrigin(input->GetOrigin());
+  output->SetDirection(input->GetDirection());
+
+  return ResampleRigid(input, transform, output.GetPointer(), nullptr, stats);
+}
+
+} //namespace nmtools
+
+#endif
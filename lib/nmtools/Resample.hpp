@@ -0,0 +1,744 @@
+/*
+   Resample.hpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Separable resampling between grids that share a direction matrix.
+ */
+
+#ifndef RESAMPLE_HPP
+#define RESAMPLE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <itkImage.h>
+#include <glog/logging.h>
+
+#include "MuMapKernels.hpp"
+#include "Parallel.hpp"
+
+namespace nmtools {
+
+//Read-only strided view of a 3D voxel buffer.
+template <typename TPixel>
+struct VolumeView {
+  const TPixel *data = nullptr;
+  std::size_t size[3] = {0, 0, 0};
+  std::ptrdiff_t stride[3] = {0, 0, 0};
+};
+
+//Make a view of a contiguous ITK image buffer.
+template <class TImage>
+VolumeView<typename TImage::PixelType> MakeVolumeView(const TImage *image){
+
+  VolumeView<typename TImage::PixelType> view;
+  const typename TImage::SizeType &size = image->GetBufferedRegion().GetSize();
+
+  view.data = image->GetBufferPointer();
+  view.size[0] = size[0];
+  view.size[1] = size[1];
+  view.size[2] = size[2];
+  view.stride[0] = 1;
+  view.stride[1] = size[0];
+  view.stride[2] = size[0] * size[1];
+
+  return view;
+}
+
+//1D sampling table for one axis. Output sample i is the weighted sum of
+//input samples index[i*taps + t] with weights weight[i*taps + t].
+//Samples falling outside the input have inside[i] = 0 and are set to zero.
+struct AxisSampling {
+  std::size_t taps = 0;
+  std::vector<std::ptrdiff_t> index;
+  std::vector<float> weight;
+  std::vector<unsigned char> inside;
+};
+
+//Linear interpolation weights along an axis of nIn samples. Output
+//sample i lies at continuous input index start + i*step. Follows the
+//conventions of itk::LinearInterpolateImageFunction: samples are inside
+//when -0.5 <= index < nIn - 0.5 and edge samples are clamped.
+AxisSampling ComputeLinearSampling(std::size_t nIn, std::size_t nOut, double start, double step){
+
+  AxisSampling table;
+  table.taps = 2;
+  table.index.assign(nOut * 2, 0);
+  table.weight.assign(nOut * 2, 0.0f);
+  table.inside.assign(nOut, 0);
+
+  const double lower = -0.5;
+  const double upper = static_cast<double>(nIn) - 0.5;
+
+  for (std::size_t i = 0; i < nOut; i++) {
+
+    const double c = start + i * step;
+
+    if (!(c >= lower && c < upper))
+      continue;
+
+    std::ptrdiff_t i0 = static_cast<std::ptrdiff_t>(std::floor(c));
+    if (i0 < 0)
+      i0 = 0;
+
+    const double d = c - i0;
+
+    table.inside[i] = 1;
+    table.index[2*i] = i0;
+
+    if (d <= 0.0 || i0 + 1 > static_cast<std::ptrdiff_t>(nIn) - 1) {
+      table.index[2*i + 1] = i0;
+      table.weight[2*i] = 1.0f;
+    }
+    else {
+      table.index[2*i + 1] = i0 + 1;
+      table.weight[2*i] = static_cast<float>(1.0 - d);
+      table.weight[2*i + 1] = static_cast<float>(d);
+    }
+  }
+
+  return table;
+}
+
+//Kernels available for reslicing.
+enum class Interpolation { Nearest, Linear, BSpline, Sinc };
+
+//Kernel from its command-line name: nearest, linear, bspline or sinc.
+//Nothing is logged, as options are parsed before logging starts; the
+//caller reports an unknown name.
+bool ParseInterpolation(const std::string &name, Interpolation &interp){
+
+  if (name == "nearest")
+    interp = Interpolation::Nearest;
+  else if (name == "linear")
+    interp = Interpolation::Linear;
+  else if (name == "bspline")
+    interp = Interpolation::BSpline;
+  else if (name == "sinc")
+    interp = Interpolation::Sinc;
+  else
+    return false;
+
+  return true;
+}
+
+std::string GetInterpolationName(Interpolation interp){
+
+  switch (interp) {
+    case Interpolation::Nearest: return "nearest";
+    case Interpolation::Linear: return "linear";
+    case Interpolation::BSpline: return "bspline";
+    case Interpolation::Sinc: return "sinc";
+  }
+
+  return "unknown";
+}
+
+//Empty table with room for taps weights per output sample.
+AxisSampling AllocateSampling(std::size_t nOut, std::size_t taps){
+
+  AxisSampling table;
+  table.taps = taps;
+  table.index.assign(nOut * taps, 0);
+  table.weight.assign(nOut * taps, 0.0f);
+  table.inside.assign(nOut, 0);
+
+  return table;
+}
+
+//Nearest neighbour along an axis, as itk::NearestNeighborInterpolateImageFunction
+//(halves round up).
+AxisSampling ComputeNearestSampling(std::size_t nIn, std::size_t nOut, double start, double step){
+
+  AxisSampling table = AllocateSampling(nOut, 1);
+
+  const double lower = -0.5;
+  const double upper = static_cast<double>(nIn) - 0.5;
+  const std::ptrdiff_t last = static_cast<std::ptrdiff_t>(nIn) - 1;
+
+  for (std::size_t i = 0; i < nOut; i++) {
+
+    const double c = start + i * step;
+
+    if (!(c >= lower && c < upper))
+      continue;
+
+    std::ptrdiff_t i0 = static_cast<std::ptrdiff_t>(std::floor(c + 0.5));
+    i0 = std::max<std::ptrdiff_t>(0, std::min(last, i0));
+
+    table.inside[i] = 1;
+    table.index[i] = i0;
+    table.weight[i] = 1.0f;
+  }
+
+  return table;
+}
+
+//Index k folded back into [0, n) by mirroring about the end samples, as
+//itk::BSplineInterpolateImageFunction does.
+inline std::ptrdiff_t MirrorIndex(std::ptrdiff_t k, std::size_t n){
+
+  if (n == 1)
+    return 0;
+
+  const std::ptrdiff_t period = 2 * static_cast<std::ptrdiff_t>(n) - 2;
+
+  k %= period;
+  if (k < 0)
+    k += period;
+  if (k >= static_cast<std::ptrdiff_t>(n))
+    k = period - k;
+
+  return k;
+}
+
+//Cubic B-spline weights along an axis. The table applies to B-spline
+//coefficients (see BSplinePrefilter()), not to the samples themselves.
+AxisSampling ComputeBSplineSampling(std::size_t nIn, std::size_t nOut, double start, double step){
+
+  AxisSampling table = AllocateSampling(nOut, 4);
+
+  const double lower = -0.5;
+  const double upper = static_cast<double>(nIn) - 0.5;
+
+  for (std::size_t i = 0; i < nOut; i++) {
+
+    const double c = start + i * step;
+
+    if (!(c >= lower && c < upper))
+      continue;
+
+    const std::ptrdiff_t i0 = static_cast<std::ptrdiff_t>(std::floor(c));
+    const double t = c - i0;
+    const double t2 = t * t;
+    const double t3 = t2 * t;
+
+    const double w[4] = { (1.0 - t) * (1.0 - t) * (1.0 - t) / 6.0,
+                          (4.0 - 6.0 * t2 + 3.0 * t3) / 6.0,
+                          (1.0 + 3.0 * t + 3.0 * t2 - 3.0 * t3) / 6.0,
+                          t3 / 6.0 };
+
+    table.inside[i] = 1;
+    for (std::size_t k = 0; k < 4; k++) {
+      table.index[4*i + k] = MirrorIndex(i0 - 1 + static_cast<std::ptrdiff_t>(k), nIn);
+      table.weight[4*i + k] = static_cast<float>(w[k]);
+    }
+  }
+
+  return table;
+}
+
+//Lanczos-windowed sinc (radius 3) along an axis. Samples beyond the
+//edges repeat the edge value, and weights are normalised to sum to one
+//so uniform regions keep their value exactly.
+AxisSampling ComputeSincSampling(std::size_t nIn, std::size_t nOut, double start, double step){
+
+  const std::ptrdiff_t radius = 3;
+  AxisSampling table = AllocateSampling(nOut, 2 * radius);
+
+  const double pi = 3.14159265358979323846;
+  const double lower = -0.5;
+  const double upper = static_cast<double>(nIn) - 0.5;
+  const std::ptrdiff_t last = static_cast<std::ptrdiff_t>(nIn) - 1;
+
+  for (std::size_t i = 0; i < nOut; i++) {
+
+    const double c = start + i * step;
+
+    if (!(c >= lower && c < upper))
+      continue;
+
+    const std::ptrdiff_t i0 = static_cast<std::ptrdiff_t>(std::floor(c));
+    double w[2 * radius];
+    double sum = 0.0;
+
+    for (std::ptrdiff_t k = 0; k < 2 * radius; k++) {
+      const double x = c - (i0 - radius + 1 + k);
+      if (std::fabs(x) < 1e-9)
+        w[k] = 1.0;
+      else if (std::fabs(x) >= radius)
+        w[k] = 0.0;
+      else
+        w[k] = radius * std::sin(pi * x) * std::sin(pi * x / radius) / (pi * pi * x * x);
+      sum += w[k];
+    }
+
+    table.inside[i] = 1;
+    for (std::ptrdiff_t k = 0; k < 2 * radius; k++) {
+      table.index[2*radius*i + k] = std::max<std::ptrdiff_t>(0, std::min(last, i0 - radius + 1 + k));
+      table.weight[2*radius*i + k] = static_cast<float>(w[k] / sum);
+    }
+  }
+
+  return table;
+}
+
+//Sampling table for the given kernel.
+AxisSampling ComputeSampling(Interpolation interp, std::size_t nIn, std::size_t nOut,
+                             double start, double step){
+
+  switch (interp) {
+    case Interpolation::Nearest: return ComputeNearestSampling(nIn, nOut, start, step);
+    case Interpolation::BSpline: return ComputeBSplineSampling(nIn, nOut, start, step);
+    case Interpolation::Sinc: return ComputeSincSampling(nIn, nOut, start, step);
+    case Interpolation::Linear: break;
+  }
+
+  return ComputeLinearSampling(nIn, nOut, start, step);
+}
+
+//Cubic B-spline prefilter (Unser's recursive filter, mirror boundaries)
+//applied along one axis of width interleaved lines of n samples:
+//sample k of line w is data[k*stride + w]. Lines are filtered side by
+//side, so the inner loops run over contiguous memory when width > 1.
+void BSplineFilterLines(float *data, std::size_t n, std::ptrdiff_t stride, std::size_t width){
+
+  if (n < 2)
+    return;
+
+  const double pole = std::sqrt(3.0) - 2.0;
+  const float z = static_cast<float>(pole);
+  const float gain = 6.0f;  //(1 - z)(1 - 1/z)
+
+  for (std::size_t k = 0; k < n; k++) {
+    float *line = data + static_cast<std::ptrdiff_t>(k) * stride;
+    for (std::size_t w = 0; w < width; w++)
+      line[w] *= gain;
+  }
+
+  //Causal initialisation: truncated mirror sum (exact when short).
+  std::vector<float> sum(data, data + width);
+
+  const std::size_t horizon = std::min<std::size_t>(n,
+    static_cast<std::size_t>(std::ceil(std::log(1e-6) / std::log(std::fabs(pole)))));
+
+  if (horizon < n) {
+    float zk = z;
+    for (std::size_t k = 1; k < horizon; k++, zk *= z) {
+      const float *line = data + static_cast<std::ptrdiff_t>(k) * stride;
+      for (std::size_t w = 0; w < width; w++)
+        sum[w] += zk * line[w];
+    }
+  }
+  else {
+    const double zn = std::pow(pole, static_cast<double>(n - 1));
+    double zk = pole;
+    double zkBack = zn * zn / pole;
+    const float *lastLine = data + static_cast<std::ptrdiff_t>(n - 1) * stride;
+
+    for (std::size_t w = 0; w < width; w++)
+      sum[w] += static_cast<float>(zn) * lastLine[w];
+
+    for (std::size_t k = 1; k + 1 < n; k++, zk *= pole, zkBack /= pole) {
+      const float *line = data + static_cast<std::ptrdiff_t>(k) * stride;
+      for (std::size_t w = 0; w < width; w++)
+        sum[w] += static_cast<float>(zk + zkBack) * line[w];
+    }
+
+    const float scale = static_cast<float>(1.0 / (1.0 - zn * zn));
+    for (std::size_t w = 0; w < width; w++)
+      sum[w] *= scale;
+  }
+
+  std::copy(sum.begin(), sum.end(), data);
+
+  //Causal pass.
+  for (std::size_t k = 1; k < n; k++) {
+    float *line = data + static_cast<std::ptrdiff_t>(k) * stride;
+    const float *prev = line - stride;
+    for (std::size_t w = 0; w < width; w++)
+      line[w] += z * prev[w];
+  }
+
+  //Anti-causal initialisation and pass.
+  float *lastLine = data + static_cast<std::ptrdiff_t>(n - 1) * stride;
+  const float *beforeLast = lastLine - stride;
+  const float init = z / (z * z - 1.0f);
+  for (std::size_t w = 0; w < width; w++)
+    lastLine[w] = init * (lastLine[w] + z * beforeLast[w]);
+
+  for (std::size_t k = n - 1; k-- > 0; ) {
+    float *line = data + static_cast<std::ptrdiff_t>(k) * stride;
+    const float *next = line + stride;
+    for (std::size_t w = 0; w < width; w++)
+      line[w] = z * (next[w] - line[w]);
+  }
+}
+
+//Cubic B-spline coefficients of the volume in view, as a contiguous
+//float volume (x fastest) of the same size. Each axis is filtered in
+//parallel; the y and z passes filter whole rows at a time.
+template <typename TPixel>
+void BSplinePrefilter(const VolumeView<TPixel> &in, std::vector<float> &coeffs){
+
+  const std::size_t nx = in.size[0];
+  const std::size_t ny = in.size[1];
+  const std::size_t nz = in.size[2];
+  const std::size_t sliceSize = nx * ny;
+
+  coeffs.resize(sliceSize * nz);
+
+  //Copy in (and filter along x) slice by slice.
+  ParallelFor(0, nz, [&](std::size_t zFirst, std::size_t zLast, unsigned int){
+    for (std::size_t z = zFirst; z < zLast; z++) {
+      float *slice = &coeffs[z * sliceSize];
+      for (std::size_t y = 0; y < ny; y++) {
+        const TPixel *src = in.data + static_cast<std::ptrdiff_t>(z) * in.stride[2] +
+                            static_cast<std::ptrdiff_t>(y) * in.stride[1];
+        float *row = slice + y * nx;
+        for (std::size_t x = 0; x < nx; x++)
+          row[x] = static_cast<float>(src[static_cast<std::ptrdiff_t>(x) * in.stride[0]]);
+        BSplineFilterLines(row, nx, 1, 1);
+      }
+      BSplineFilterLines(slice, ny, nx, nx);
+    }
+  });
+
+  ParallelFor(0, ny, [&](std::size_t yFirst, std::size_t yLast, unsigned int){
+    for (std::size_t y = yFirst; y < yLast; y++)
+      BSplineFilterLines(&coeffs[y * nx], nz, sliceSize, nx);
+  });
+}
+
+//Core separable resampling. Fills the output buffer (x fastest) of size
+//outSize from the input view using one table per axis. Output slices are
+//processed in parallel; each slice is built with three 1D passes:
+// z: blend input planes into a float plane (nx_in * ny_in),
+// y: blend plane rows into nx_in * ny_out,
+// x: gather along rows into the output slice.
+//Output values are divided by divisor as they are written and, if stats
+//is given, min/max (and histogram) are gathered while each slice is hot.
+//If sliceMask (nx_out * ny_out) is given, voxels where it is zero are
+//set to zero in every slice.
+template <typename TInputPixel, typename TOutputPixel>
+void ResampleSeparable(const VolumeView<TInputPixel> &in, const AxisSampling table[3],
+                       TOutputPixel *out, const std::size_t outSize[3],
+                       float divisor = 1.0f, MuMapStatistics *stats = nullptr,
+                       const unsigned char *sliceMask = nullptr){
+
+  const std::size_t nxIn = in.size[0];
+  const std::size_t nyIn = in.size[1];
+  const std::size_t nxOut = outSize[0];
+  const std::size_t nyOut = outSize[1];
+  const std::size_t nzOut = outSize[2];
+  const std::size_t outSliceSize = nxOut * nyOut;
+
+  const AxisSampling &tx = table[0];
+  const AxisSampling &ty = table[1];
+  const AxisSampling &tz = table[2];
+
+  //Only the input rows referenced by the y table need a z blend.
+  std::vector<unsigned char> rowUsed(nyIn, 0);
+  for (std::size_t y = 0; y < nyOut; y++) {
+    if (!ty.inside[y])
+      continue;
+    for (std::size_t t = 0; t < ty.taps; t++)
+      if (ty.weight[y*ty.taps + t] != 0.0f)
+        rowUsed[ty.index[y*ty.taps + t]] = 1;
+  }
+
+  const unsigned int numThreads = GetDefaultNumberOfThreads();
+  std::vector<PartialStatistics> partials(numThreads);
+
+  ParallelFor(0, nzOut, [&](std::size_t zFirst, std::size_t zLast, unsigned int chunk){
+
+    std::vector<float> plane(nxIn * nyIn);
+    std::vector<float> rows(nxIn * nyOut);
+
+    for (std::size_t z = zFirst; z < zLast; z++) {
+
+      TOutputPixel *outSlice = out + z * outSliceSize;
+
+      if (!tz.inside[z]) {
+        std::fill(outSlice, outSlice + outSliceSize, TOutputPixel(0));
+        if (stats != nullptr)
+          partials[chunk].Add(outSlice, outSliceSize, *stats);
+        continue;
+      }
+
+      //z pass
+      for (std::size_t y = 0; y < nyIn; y++) {
+        if (!rowUsed[y])
+          continue;
+
+        float *dst = &plane[y * nxIn];
+        std::fill(dst, dst + nxIn, 0.0f);
+
+        for (std::size_t t = 0; t < tz.taps; t++) {
+          const float w = tz.weight[z*tz.taps + t];
+          if (w == 0.0f)
+            continue;
+
+          const TInputPixel *src = in.data + static_cast<std::ptrdiff_t>(y) * in.stride[1] +
+                                  tz.index[z*tz.taps + t] * in.stride[2];
+          const std::ptrdiff_t sx = in.stride[0];
+
+          if (sx == 1) {
+            for (std::size_t x = 0; x < nxIn; x++)
+              dst[x] += w * static_cast<float>(src[x]);
+          }
+          else {
+            for (std::size_t x = 0; x < nxIn; x++)
+              dst[x] += w * static_cast<float>(src[static_cast<std::ptrdiff_t>(x) * sx]);
+          }
+        }
+      }
+
+      //y pass
+      for (std::size_t y = 0; y < nyOut; y++) {
+        float *dst = &rows[y * nxIn];
+        std::fill(dst, dst + nxIn, 0.0f);
+
+        if (!ty.inside[y])
+          continue;
+
+        for (std::size_t t = 0; t < ty.taps; t++) {
+          const float w = ty.weight[y*ty.taps + t];
+          if (w == 0.0f)
+            continue;
+
+          const float *src = &plane[ty.index[y*ty.taps + t] * nxIn];
+          for (std::size_t x = 0; x < nxIn; x++)
+            dst[x] += w * src[x];
+        }
+      }
+
+      //x pass
+      for (std::size_t y = 0; y < nyOut; y++) {
+        const float *src = &rows[y * nxIn];
+        TOutputPixel *dst = outSlice + y * nxOut;
+
+        for (std::size_t x = 0; x < nxOut; x++) {
+          float v = 0.0f;
+          if (tx.inside[x]) {
+            for (std::size_t t = 0; t < tx.taps; t++)
+              v += tx.weight[x*tx.taps + t] * src[tx.index[x*tx.taps + t]];
+          }
+          dst[x] = static_cast<TOutputPixel>(v / divisor);
+        }
+
+        if (sliceMask != nullptr) {
+          const unsigned char *mask = sliceMask + y * nxOut;
+          for (std::size_t x = 0; x < nxOut; x++)
+            if (!mask[x])
+              dst[x] = TOutputPixel(0);
+        }
+      }
+
+      if (stats != nullptr)
+        partials[chunk].Add(outSlice, outSliceSize, *stats);
+    }
+  }, numThreads);
+
+  if (stats != nullptr)
+    MergeStatistics(partials, *stats);
+}
+
+//In-plane mask (x fastest) of a grid with the given origin, spacing,
+//direction and size: 1 inside a circle of diameter (mm) about the
+//scanner axis, the physical line x = y = 0, else 0. The grid's slices
+//must be transaxial.
+template <class TPoint, class TSpacing, class TDirection>
+std::vector<unsigned char> GetTransaxialFOVMask(const TPoint &origin, const TSpacing &spacing,
+                                                const TDirection &direction, const std::size_t size[3],
+                                                double diameter){
+
+  const double r2 = 0.25 * diameter * diameter;
+  std::vector<unsigned char> mask(size[0] * size[1]);
+
+  for (std::size_t y = 0; y < size[1]; y++) {
+    const double ty = y * spacing[1];
+    for (std::size_t x = 0; x < size[0]; x++) {
+      const double tx = x * spacing[0];
+      const double px = origin[0] + direction[0][0] * tx + direction[0][1] * ty;
+      const double py = origin[1] + direction[1][0] * tx + direction[1][1] * ty;
+      mask[y * size[0] + x] = (px * px + py * py <= r2) ? 1 : 0;
+    }
+  }
+
+  return mask;
+}
+
+//Resamples an image onto a new grid with the same direction cosines
+//(e.g. a change of voxel size, padding or cropping) without going
+//through a generic per-voxel transform and interpolator. Padding,
+//cropping and scaling can all be done in the same pass. Any of the
+//kernels in Interpolation can be used.
+template <class TInputImage, class TOutputImage>
+class AxisAlignedResampler {
+
+public:
+
+  typedef typename TOutputImage::SpacingType SpacingType;
+  typedef typename TOutputImage::PointType PointType;
+  typedef typename TOutputImage::SizeType SizeType;
+  typedef typename TOutputImage::RegionType RegionType;
+
+  void SetInput(const TInputImage *image){ _input = image; };
+
+  //Read voxels through view (e.g. a permuted/flipped view of another
+  //buffer) instead of the input's own buffer. The input then only
+  //supplies the geometry, and need not be allocated.
+  void SetInputView(const VolumeView<typename TInputImage::PixelType> &view){
+    _view = view;
+    _useView = true;
+  };
+
+  void SetOutputSpacing(const SpacingType &spacing){ _outputSpacing = spacing; };
+  void SetOutputOrigin(const PointType &origin){ _outputOrigin = origin; };
+  void SetSize(const SizeType &size){ _outputSize = size; };
+
+  //Output voxels outside this region (in output index space) are set to
+  //zero, even where they overlap the input. Defaults to the whole output.
+  void SetSupportRegion(const RegionType &region){
+    _supportRegion = region;
+    _useSupportRegion = true;
+  };
+
+  //Output values are divided by this (e.g. 10000 to get mu-values).
+  void SetDivisor(float divisor){ _divisor = divisor; };
+
+  //Interpolation kernel. Defaults to linear.
+  void SetInterpolation(Interpolation interp){ _interpolation = interp; };
+
+  //Zero output voxels outside a transaxial circle of this diameter (mm)
+  //about the scanner axis, the physical line x = y = 0; output slices
+  //must then be transaxial. 0 (default) = no limit.
+  void SetTransaxialFOV(double diameter){ _fovDiameter = diameter; };
+
+  //Execute. The output takes the direction cosines of the input. If
+  //stats is given, min/max of the output are gathered in the same pass.
+  bool Update(MuMapStatistics *stats = nullptr);
+
+  typename TOutputImage::Pointer GetOutput(){ return _output; };
+
+protected:
+
+  const TInputImage *_input = nullptr;
+
+  VolumeView<typename TInputImage::PixelType> _view;
+  bool _useView = false;
+
+  SpacingType _outputSpacing;
+  PointType _outputOrigin;
+  SizeType _outputSize;
+
+  RegionType _supportRegion;
+  bool _useSupportRegion = false;
+
+  float _divisor = 1.0f;
+
+  Interpolation _interpolation = Interpolation::Linear;
+
+  double _fovDiameter = 0.0;
+
+  typename TOutputImage::Pointer _output;
+
+};
+
+template <class TInputImage, class TOutputImage>
+bool AxisAlignedResampler<TInputImage, TOutputImage>::Update(MuMapStatistics *stats){
+
+  if (_input == nullptr){
+    LOG(ERROR) << "No input image to resample!";
+    return false;
+  }
+
+  //Position of the first output voxel in input (continuous) index space.
+  //Output and input share the direction matrix, so each axis maps
+  //independently: index_k(i) = start_k + i * step_k.
+  itk::ContinuousIndex<double, 3> start;
+  _input->TransformPhysicalPointToContinuousIndex(_outputOrigin, start);
+
+  const typename TInputImage::SpacingType &inputSpacing = _input->GetSpacing();
+  const typename TInputImage::IndexType &inputStart = _input->GetBufferedRegion().GetIndex();
+
+  AxisSampling tables[3];
+  std::size_t outSize[3];
+
+  for (unsigned int k = 0; k < 3; k++) {
+    outSize[k] = _outputSize[k];
+    tables[k] = ComputeSampling(_interpolation, _input->GetBufferedRegion().GetSize()[k], outSize[k],
+                                start[k] - inputStart[k], _outputSpacing[k] / inputSpacing[k]);
+
+    if (_useSupportRegion) {
+      const long lower = _supportRegion.GetIndex()[k];
+      const long upper = lower + static_cast<long>(_supportRegion.GetSize()[k]);
+      for (std::size_t i = 0; i < outSize[k]; i++)
+        if (static_cast<long>(i) < lower || static_cast<long>(i) >= upper)
+          tables[k].inside[i] = 0;
+    }
+  }
+
+  //The FOV circle lies in the output slices.
+  const typename TInputImage::DirectionType &direction = _input->GetDirection();
+  if (_fovDiameter > 0.0 && (std::fabs(direction[0][2]) > 1e-6 || std::fabs(direction[1][2]) > 1e-6)) {
+    LOG(ERROR) << "A transaxial FOV needs transaxial output slices!";
+    return false;
+  }
+
+  _output = TOutputImage::New();
+
+  typename TOutputImage::RegionType region;
+  region.SetSize(_outputSize);
+
+  _output->SetRegions(region);
+  _output->SetSpacing(_outputSpacing);
+  _output->SetOrigin(_outputOrigin);
+  _output->SetDirection(_input->GetDirection());
+
+  try {
+    _output->Allocate();
+  } catch (itk::ExceptionObject &ex){
+    LOG(ERROR) << "Unable to allocate resampled image!";
+    return false;
+  }
+
+  const VolumeView<typename TInputImage::PixelType> view = _useView ? _view : MakeVolumeView(_input);
+
+  std::vector<unsigned char> fovMask;
+  if (_fovDiameter > 0.0)
+    fovMask = GetTransaxialFOVMask(_outputOrigin, _outputSpacing, direction, outSize, _fovDiameter);
+
+  const unsigned char *mask = fovMask.empty() ? nullptr : fovMask.data();
+
+  if (_interpolation != Interpolation::BSpline) {
+    ResampleSeparable(view, tables, _output->GetBufferPointer(), outSize, _divisor, stats, mask);
+    return true;
+  }
+
+  //B-spline weights apply to coefficients, computed here as floats.
+  std::vector<float> coeffs;
+  BSplinePrefilter(view, coeffs);
+
+  VolumeView<float> coeffView;
+  coeffView.data = coeffs.data();
+  for (unsigned int k = 0; k < 3; k++)
+    coeffView.size[k] = view.size[k];
+  coeffView.stride[0] = 1;
+  coeffView.stride[1] = view.size[0];
+  coeffView.stride[2] = view.size[0] * view.size[1];
+
+  ResampleSeparable(coeffView, tables, _output->GetBufferPointer(), outSize, _divisor, stats, mask);
+
+  return true;
+}
+
+} //namespace nmtools
+
+#endif
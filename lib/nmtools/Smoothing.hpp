@@ -0,0 +1,308 @@
+/*
+   Smoothing.hpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Recursive (IIR) Gaussian smoothing of volumes.
+ */
+
+#ifndef SMOOTHING_HPP
+#define SMOOTHING_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+#include "MuMapKernels.hpp"
+#include "Parallel.hpp"
+
+namespace nmtools {
+
+//FWHM of a Gaussian in terms of its standard deviation.
+const double kFWHMPerSigma = 2.354820045;
+
+//Third-order recursive approximation of a Gaussian (forward and
+//backward passes; van Vliet, Young & Verbeek, 1998) with the boundary
+//handling of Triggs & Sdika (2006), as if the signal continued with its
+//edge values. Cost per sample does not depend on sigma.
+class RecursiveGaussian {
+
+public:
+
+  //sigma in samples; must be >= 0.5.
+  explicit RecursiveGaussian(double sigma);
+
+  //Filter width interleaved lines of n samples in place: sample k of
+  //line w is data[k*stride + w]. Lines are filtered side by side, so
+  //the inner loops run over contiguous memory when width > 1. scratch
+  //is working space, kept by the caller so it is allocated only once.
+  void FilterLines(float *data, std::size_t n, std::ptrdiff_t stride, std::size_t width,
+                   std::vector<float> &scratch) const;
+
+protected:
+
+  //Coefficients for the reference poles scaled by 1/q.
+  void SetCoefficients(double q);
+
+  //Variance (in samples^2) of the forward-backward impulse response.
+  double GetVariance() const;
+
+  void ComputeEndMatrix();
+
+  double _a[3];  //feedback coefficients
+  double _b;     //input gain
+  double _m[9];  //Triggs-Sdika end-of-line matrix
+
+};
+
+//The poles are scaled (by bisection on q) until the response has
+//variance sigma^2.
+RecursiveGaussian::RecursiveGaussian(double sigma){
+
+  double lower = 0.1;
+  double upper = 2.0 * sigma + 2.0;
+
+  for (unsigned int i = 0; i < 60; i++) {
+    SetCoefficients(0.5 * (lower + upper));
+    if (GetVariance() < sigma * sigma)
+      lower = 0.5 * (lower + upper);
+    else
+      upper = 0.5 * (lower + upper);
+  }
+
+  SetCoefficients(0.5 * (lower + upper));
+  ComputeEndMatrix();
+}
+
+//From the moments of the causal response b / (1 - sum a_i z^-i).
+double RecursiveGaussian::GetVariance() const {
+
+  const double s1 = _a[0] + 2.0 * _a[1] + 3.0 * _a[2];
+  const double s2 = 2.0 * _a[1] + 6.0 * _a[2];
+
+  return 2.0 * (s2 / _b + s1 / _b + s1 * s1 / (_b * _b));
+}
+
+void RecursiveGaussian::SetCoefficients(double q){
+
+  //Poles for sigma = 2 (L-infinity fit), raised to the power 1/q.
+  typedef std::complex<double> Complex;
+  const Complex d1 = std::pow(Complex(1.40098, 1.00236), 1.0 / q);
+  const double d3 = std::pow(1.85132, 1.0 / q);
+
+  //(1 - x/d1)(1 - x/conj(d1))(1 - x/d3) = 1 - a1 x - a2 x^2 - a3 x^3
+  const double re = std::real(1.0 / d1);
+  const double mag2 = std::norm(1.0 / d1);
+
+  _a[0] = 2.0 * re + 1.0 / d3;
+  _a[1] = -(mag2 + 2.0 * re / d3);
+  _a[2] = mag2 / d3;
+  _b = 1.0 - (_a[0] + _a[1] + _a[2]);
+}
+
+//End-of-line matrix (Triggs & Sdika): maps the deviations of the last
+//three causal outputs from their steady state to those of the first
+//three backward outputs. Found by running both passes on each unit
+//deviation until the response has died away.
+void RecursiveGaussian::ComputeEndMatrix(){
+
+  for (unsigned int j = 0; j < 3; j++) {
+    std::vector<double> w(3, 0.0);
+    w[2 - j] = 1.0;
+
+    for (std::size_t k = 3; k < 1000000; k++) {
+      w.push_back(_a[0] * w[k-1] + _a[1] * w[k-2] + _a[2] * w[k-3]);
+      if (std::fabs(w[k]) + std::fabs(w[k-1]) + std::fabs(w[k-2]) < 1e-14)
+        break;
+    }
+
+    std::vector<double> y(w.size() + 3, 0.0);
+
+    for (std::size_t k = w.size(); k-- > 2; )
+      y[k] = _b * w[k] + _a[0] * y[k+1] + _a[1] * y[k+2] + _a[2] * y[k+3];
+
+    for (unsigned int i = 0; i < 3; i++)
+      _m[3*i + j] = y[2 + i];
+  }
+}
+
+void RecursiveGaussian::FilterLines(float *data, std::size_t n, std::ptrdiff_t stride,
+                                    std::size_t width, std::vector<float> &scratch) const {
+
+  if (n < 4)
+    return;
+
+  const float a0 = static_cast<float>(_a[0]);
+  const float a1 = static_cast<float>(_a[1]);
+  const float a2 = static_cast<float>(_a[2]);
+  const float b = static_cast<float>(_b);
+
+  auto line = [&](std::size_t k){ return data + static_cast<std::ptrdiff_t>(k) * stride; };
+
+  scratch.resize(3 * width);
+  float *first = scratch.data();
+  float *next1 = first + width;
+  float *next2 = next1 + width;
+
+  //Causal pass. Before the start, the output has settled on the first
+  //value (the filter has unit gain).
+  std::copy(line(0), line(0) + width, first);
+  {
+    float *w0 = line(0);
+    for (std::size_t w = 0; w < width; w++)
+      w0[w] = b * w0[w] + (a0 + a1 + a2) * first[w];
+
+    float *w1 = line(1);
+    for (std::size_t w = 0; w < width; w++)
+      w1[w] = b * w1[w] + a0 * w0[w] + (a1 + a2) * first[w];
+
+    float *w2 = line(2);
+    for (std::size_t w = 0; w < width; w++)
+      w2[w] = b * w2[w] + a0 * w1[w] + a1 * w0[w] + a2 * first[w];
+  }
+
+  for (std::size_t k = 3; k < n; k++) {
+    float *cur = line(k);
+    const float *p1 = line(k - 1);
+    const float *p2 = line(k - 2);
+    const float *p3 = line(k - 3);
+    for (std::size_t w = 0; w < width; w++)
+      cur[w] = b * cur[w] + a0 * p1[w] + a1 * p2[w] + a2 * p3[w];
+  }
+
+  //Anti-causal pass, started from the Triggs-Sdika end values. The input
+  //is taken to continue with its last value, which is recovered from
+  //the causal output and its predecessors.
+  {
+    float *last = line(n - 1);
+    const float *p1 = line(n - 2);
+    const float *p2 = line(n - 3);
+
+    for (std::size_t w = 0; w < width; w++) {
+      //Last input sample, from the causal recursion.
+      const double u = (last[w] - a0 * p1[w] - a1 * p2[w] - a2 * line(n - 4)[w]) / b;
+      const double d0 = last[w] - u;
+      const double d1 = p1[w] - u;
+      const double d2 = p2[w] - u;
+
+      const double y0 = _m[0] * d0 + _m[1] * d1 + _m[2] * d2 + u;
+      const double y1 = _m[3] * d0 + _m[4] * d1 + _m[5] * d2 + u;
+      const double y2 = _m[6] * d0 + _m[7] * d1 + _m[8] * d2 + u;
+
+      last[w] = static_cast<float>(y0);
+      next1[w] = static_cast<float>(y1);
+      next2[w] = static_cast<float>(y2);
+    }
+
+    float *cur = line(n - 2);
+    for (std::size_t w = 0; w < width; w++)
+      cur[w] = b * cur[w] + a0 * last[w] + a1 * next1[w] + a2 * next2[w];
+
+    cur = line(n - 3);
+    const float *n1 = line(n - 2);
+    for (std::size_t w = 0; w < width; w++)
+      cur[w] = b * cur[w] + a0 * n1[w] + a1 * last[w] + a2 * next1[w];
+  }
+
+  for (std::size_t k = n - 3; k-- > 0; ) {
+    float *cur = line(k);
+    const float *n1 = line(k + 1);
+    const float *n2 = line(k + 2);
+    const float *n3 = line(k + 3);
+    for (std::size_t w = 0; w < width; w++)
+      cur[w] = b * cur[w] + a0 * n1[w] + a1 * n2[w] + a2 * n3[w];
+  }
+}
+
+//Rows filtered side by side along x: they are transposed into a small
+//buffer so the recursion runs across them, as for y and z.
+const std::size_t kGaussianRowBlock = 16;
+
+//Smooth a contiguous volume (x fastest) in place with a Gaussian of the
+//given standard deviation (in voxels) along each axis. Axes with a
+//sigma below 0.5 voxels are left alone. x and y are filtered slice by
+//slice in parallel, then z across rows in parallel; if stats is given,
+//min/max (and histogram) are gathered during the z pass.
+void SmoothGaussian(float *data, const std::size_t size[3], const double sigma[3],
+                    MuMapStatistics *stats = nullptr){
+
+  const std::size_t nx = size[0];
+  const std::size_t ny = size[1];
+  const std::size_t nz = size[2];
+  const std::size_t sliceSize = nx * ny;
+
+  std::vector<RecursiveGaussian> filters;
+  bool useAxis[3];
+  for (unsigned int k = 0; k < 3; k++) {
+    useAxis[k] = sigma[k] >= 0.5;
+    filters.push_back(RecursiveGaussian(useAxis[k] ? sigma[k] : 0.5));
+  }
+
+  if (useAxis[0] || useAxis[1]) {
+    ParallelFor(0, nz, [&](std::size_t zFirst, std::size_t zLast, unsigned int){
+
+      std::vector<float> rows(useAxis[0] ? nx * kGaussianRowBlock : 0);
+      std::vector<float> scratch;
+
+      for (std::size_t z = zFirst; z < zLast; z++) {
+        float *slice = data + z * sliceSize;
+
+        if (useAxis[0])
+          for (std::size_t y0 = 0; y0 < ny; y0 += kGaussianRowBlock) {
+            const std::size_t count = std::min(kGaussianRowBlock, ny - y0);
+            float *block = slice + y0 * nx;
+
+            for (std::size_t r = 0; r < count; r++)
+              for (std::size_t x = 0; x < nx; x++)
+                rows[x * count + r] = block[r * nx + x];
+
+            filters[0].FilterLines(rows.data(), nx, count, count, scratch);
+
+            for (std::size_t r = 0; r < count; r++)
+              for (std::size_t x = 0; x < nx; x++)
+                block[r * nx + x] = rows[x * count + r];
+          }
+
+        if (useAxis[1])
+          filters[1].FilterLines(slice, ny, nx, nx, scratch);
+      }
+    });
+  }
+
+  const unsigned int numThreads = GetDefaultNumberOfThreads();
+  std::vector<PartialStatistics> partials(numThreads);
+
+  ParallelFor(0, ny, [&](std::size_t yFirst, std::size_t yLast, unsigned int chunk){
+
+    std::vector<float> scratch;
+
+    for (std::size_t y = yFirst; y < yLast; y++) {
+      float *row = data + y * nx;
+      if (useAxis[2])
+        filters[2].FilterLines(row, nz, sliceSize, nx, scratch);
+      if (stats != nullptr)
+        for (std::size_t z = 0; z < nz; z++)
+          partials[chunk].Add(row + z * sliceSize, nx, *stats);
+    }
+  }, numThreads);
+
+  if (stats != nullptr)
+    MergeStatistics(partials, *stats);
+}
+
+} //namespace nmtools
+
+#endif
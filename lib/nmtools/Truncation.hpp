@@ -0,0 +1,329 @@
+/*
+   Truncation.hpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Completion of mu-maps truncated by the MR field of view.
+ */
+
+#ifndef TRUNCATION_HPP
+#define TRUNCATION_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <glog/logging.h>
+
+#include <itkImage.h>
+#include <itkImageFileReader.h>
+#include <itkSpatialOrientationAdapter.h>
+
+#include "MuMapKernels.hpp"
+#include "Orientation.hpp"
+#include "Parallel.hpp"
+#include "Resample.hpp"
+
+namespace nmtools {
+
+//Binary slice kernels. Masks are nx by ny, x fastest, 0 or 1.
+
+//Dilation by an ellipse with radii rx, ry (voxels): out is 1 where any
+//voxel of in within the ellipse is. Rows are tested with prefix counts,
+//so the cost is (2 ry + 1) lookups per voxel whatever rx is.
+void DilateSlice(const uint8_t *in, uint8_t *out, std::size_t nx, std::size_t ny,
+                 unsigned int rx, unsigned int ry, std::vector<uint32_t> &counts){
+
+  counts.resize(ny * (nx + 1));
+
+  for (std::size_t y = 0; y < ny; y++) {
+    uint32_t *row = &counts[y * (nx + 1)];
+    row[0] = 0;
+    for (std::size_t x = 0; x < nx; x++)
+      row[x + 1] = row[x] + in[y * nx + x];
+  }
+
+  std::fill(out, out + nx * ny, 0);
+
+  const long ly = static_cast<long>(ny);
+  const long lx = static_cast<long>(nx);
+
+  for (long dy = -static_cast<long>(ry); dy <= static_cast<long>(ry); dy++) {
+    const double fraction = ry > 0 ? static_cast<double>(dy) / ry : 0.0;
+    const long w = static_cast<long>(std::floor(rx * std::sqrt(std::max(0.0, 1.0 - fraction * fraction)) + 1e-9));
+
+    for (long y = std::max(0L, -dy); y < std::min(ly, ly - dy); y++) {
+      const uint32_t *row = &counts[(y + dy) * (nx + 1)];
+      uint8_t *outRow = out + y * nx;
+      for (long x = 0; x < lx; x++) {
+        const long x0 = std::max(0L, x - w);
+        const long x1 = std::min(lx, x + w + 1);
+        outRow[x] |= row[x1] > row[x0];
+      }
+    }
+  }
+}
+
+//Erosion by the same ellipse. Voxels beyond the slice count as set, so
+//regions are not eroded from the edge of the image.
+void ErodeSlice(const uint8_t *in, uint8_t *out, std::size_t nx, std::size_t ny,
+                unsigned int rx, unsigned int ry, std::vector<uint8_t> &scratch,
+                std::vector<uint32_t> &counts){
+
+  scratch.resize(nx * ny);
+  for (std::size_t i = 0; i < nx * ny; i++)
+    scratch[i] = !in[i];
+
+  DilateSlice(scratch.data(), out, nx, ny, rx, ry, counts);
+
+  for (std::size_t i = 0; i < nx * ny; i++)
+    out[i] = !out[i];
+}
+
+//Set every 0 that cannot be reached (4-connected) from the edge of the
+//slice, i.e. fill holes.
+void FillHolesSlice(uint8_t *mask, std::size_t nx, std::size_t ny, std::vector<std::size_t> &stack){
+
+  const uint8_t outside = 2;
+  stack.clear();
+
+  auto seed = [&](std::size_t i){
+    if (mask[i] == 0) {
+      mask[i] = outside;
+      stack.push_back(i);
+    }
+  };
+
+  for (std::size_t x = 0; x < nx; x++) {
+    seed(x);
+    seed((ny - 1) * nx + x);
+  }
+  for (std::size_t y = 0; y < ny; y++) {
+    seed(y * nx);
+    seed(y * nx + nx - 1);
+  }
+
+  while (!stack.empty()) {
+    const std::size_t i = stack.back();
+    stack.pop_back();
+    const std::size_t x = i % nx;
+    const std::size_t y = i / nx;
+    if (x > 0) seed(i - 1);
+    if (x + 1 < nx) seed(i + 1);
+    if (y > 0) seed(i - nx);
+    if (y + 1 < ny) seed(i + nx);
+  }
+
+  for (std::size_t i = 0; i < nx * ny; i++)
+    mask[i] = mask[i] != outside;
+}
+
+//Fills the parts of the body that the MR field of view cut off (usually
+//the arms) with soft tissue. The body outline comes from a non-attenuation
+//corrected (NAC) PET image or a body-outline template of the same subject
+//(any format ITK reads, in the scanner frame), resampled onto the mu-map.
+//Slice by slice, in parallel: the outline and the MR body are thresholded
+//and their holes filled; the outline not covered by the MR body is opened
+//(eroded then dilated) to drop the thin rim left by misregistration and
+//differences in resolution; what remains is filled.
+class TruncationCompletion {
+
+public:
+
+  typedef itk::Image<float, 3> ImageType;
+
+  explicit TruncationCompletion(const boost::filesystem::path &outlinePath) : _outlinePath(outlinePath){};
+
+  //Outline voxels are above this fraction of the outline image's maximum.
+  //Default 0.1 (NAC PET); any value in (0, 1) suits binary templates.
+  void SetThreshold(double fraction){ _threshold = fraction; };
+
+  //Mu-value (cm-1) of filled voxels. Default 0.1 (soft tissue).
+  void SetFillValue(float mu){ _fillValue = mu; };
+
+  //Regions narrower than this (mm) are not filled. Default 10.
+  void SetMinimumWidth(double width){ _minimumWidth = width; };
+
+  //Complete muMap in place. If stats is given, it is recomputed.
+  bool Update(ImageType *muMap, MuMapStatistics *stats = nullptr);
+
+  std::size_t GetNumberOfFilledVoxels() const { return _numFilled; };
+
+protected:
+
+  //The outline image resampled (linearly) onto grid. Fails unless its
+  //axes, once mapped, are those of grid.
+  bool ResampleOutline(const ImageType *grid, ImageType::Pointer &output) const;
+
+  boost::filesystem::path _outlinePath;
+  double _threshold = 0.1;
+  float _fillValue = 0.1f;
+  double _minimumWidth = 10.0;
+
+  std::size_t _numFilled = 0;
+
+};
+
+bool TruncationCompletion::ResampleOutline(const ImageType *grid, ImageType::Pointer &output) const {
+
+  typedef itk::ImageFileReader<ImageType> ReaderType;
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(_outlinePath.string());
+
+  try {
+    reader->Update();
+  } catch (itk::ExceptionObject &ex){
+    LOG(ERROR) << "Unable to read body outline " << _outlinePath << ": " << ex.GetDescription();
+    return false;
+  }
+
+  const ImageType::Pointer outline = reader->GetOutput();
+
+  itk::SpatialOrientationAdapter adapter;
+  const AxisMapping mapping = ComputeAxisMapping(outline->GetDirection(),
+                                                 adapter.FromDirectionCosines(grid->GetDirection()));
+
+  const ImageType::Pointer geometry = GetMappedGeometry<ImageType>(outline.GetPointer(), mapping);
+
+  //Resampling is along the grid's axes: with an oblique mu-map (or
+  //outline) the body would be filled in the wrong place.
+  if (!IsSameDirection(geometry->GetDirection(), grid->GetDirection())) {
+    LOG(ERROR) << "Body outline " << _outlinePath << " is not aligned with the axes of the mu-map"
+               << " (oblique acquisition?); resample it to the mu-map's orientation first";
+    return false;
+  }
+
+  AxisAlignedResampler<ImageType, ImageType> resampler;
+  resampler.SetInput( geometry );
+  resampler.SetInputView( MakeMappedView(outline.GetPointer(), mapping) );
+  resampler.SetOutputOrigin( grid->GetOrigin() );
+  resampler.SetOutputSpacing( grid->GetSpacing() );
+  resampler.SetSize( grid->GetLargestPossibleRegion().GetSize() );
+  resampler.SetInterpolation( Interpolation::Linear );
+
+  if (!resampler.Update()){
+    LOG(ERROR) << "Unable to resample body outline " << _outlinePath;
+    return false;
+  }
+
+  output = resampler.GetOutput();
+
+  return true;
+}
+
+bool TruncationCompletion::Update(ImageType *muMap, MuMapStatistics *stats){
+
+  _numFilled = 0;
+
+  ImageType::Pointer outline;
+  if (!ResampleOutline(muMap, outline))
+    return false;
+
+  const ImageType::SizeType &size = muMap->GetLargestPossibleRegion().GetSize();
+  const ImageType::SpacingType &spacing = muMap->GetSpacing();
+
+  const std::size_t nx = size[0];
+  const std::size_t ny = size[1];
+  const std::size_t nz = size[2];
+  const std::size_t sliceSize = nx * ny;
+
+  float *mu = muMap->GetBufferPointer();
+  const float *outlineData = outline->GetBufferPointer();
+
+  const unsigned int numThreads = GetDefaultNumberOfThreads();
+
+  //Threshold from the outline's maximum.
+  std::vector<float> maxima(numThreads, 0.0f);
+  ParallelFor(0, nz, [&](std::size_t zFirst, std::size_t zLast, unsigned int chunk){
+    for (std::size_t i = zFirst * sliceSize; i < zLast * sliceSize; i++)
+      maxima[chunk] = std::max(maxima[chunk], outlineData[i]);
+  }, numThreads);
+
+  const float outlineThreshold = static_cast<float>(_threshold) *
+                                 *std::max_element(maxima.begin(), maxima.end());
+
+  if (!(outlineThreshold > 0.0f)) {
+    LOG(ERROR) << "Body outline " << _outlinePath << " is empty over the mu-map!";
+    return false;
+  }
+
+  //Anything above air (e.g. lung) is body in the MR mu-map.
+  const float bodyThreshold = 0.01f;
+
+  //Opening radius, half the minimum width, in voxels along x and y.
+  const unsigned int rx = static_cast<unsigned int>(std::floor(0.5 * _minimumWidth / spacing[0]));
+  const unsigned int ry = static_cast<unsigned int>(std::floor(0.5 * _minimumWidth / spacing[1]));
+
+  std::vector<PartialStatistics> partials(numThreads);
+  std::vector<std::size_t> filled(numThreads, 0);
+
+  ParallelFor(0, nz, [&](std::size_t zFirst, std::size_t zLast, unsigned int chunk){
+
+    std::vector<uint8_t> missing(sliceSize);
+    std::vector<uint8_t> body(sliceSize);
+    std::vector<uint8_t> eroded(sliceSize);
+    std::vector<uint8_t> scratch;
+    std::vector<uint32_t> counts;
+    std::vector<std::size_t> stack;
+
+    for (std::size_t z = zFirst; z < zLast; z++) {
+      float *slice = mu + z * sliceSize;
+      const float *outlineSlice = outlineData + z * sliceSize;
+
+      for (std::size_t i = 0; i < sliceSize; i++) {
+        missing[i] = outlineSlice[i] > outlineThreshold;
+        body[i] = slice[i] > bodyThreshold;
+      }
+
+      FillHolesSlice(missing.data(), nx, ny, stack);
+      FillHolesSlice(body.data(), nx, ny, stack);
+
+      //Outline beyond the MR body.
+      bool any = false;
+      for (std::size_t i = 0; i < sliceSize; i++) {
+        missing[i] = missing[i] && !body[i];
+        any = any || missing[i];
+      }
+
+      if (any) {
+        ErodeSlice(missing.data(), eroded.data(), nx, ny, rx, ry, scratch, counts);
+        DilateSlice(eroded.data(), missing.data(), nx, ny, rx, ry, counts);
+
+        for (std::size_t i = 0; i < sliceSize; i++) {
+          if (missing[i]) {
+            slice[i] = _fillValue;
+            filled[chunk]++;
+          }
+        }
+      }
+
+      if (stats != nullptr)
+        partials[chunk].Add(slice, sliceSize, *stats);
+    }
+  }, numThreads);
+
+  if (stats != nullptr)
+    MergeStatistics(partials, *stats);
+
+  for (std::size_t n : filled)
+    _numFilled += n;
+
+  return true;
+}
+
+} //namespace nmtools
+
+#endif
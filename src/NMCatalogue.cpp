@@ -0,0 +1,166 @@
+/*
+   NMCatalogue.cpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   This program indexes raw data into an SQLite catalogue and queries it.
+ */
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#include <glog/logging.h>
+
+#include "nmtools/Catalogue.hpp"
+#include "EnvironmentInfo.h"
+
+int main(int argc, char **argv)
+{
+
+  const char* APP_NAME = "nm_catalogue";
+
+  std::string databasePath;
+  std::vector<std::string> indexDirectories;
+  unsigned int numThreads = 0;
+  std::string sql;
+
+  nmtools::CatalogueQuery query;
+
+  //Set-up command line options
+  namespace po = boost::program_options;
+  namespace fs = boost::filesystem;
+  namespace nm = nmtools;
+
+  po::options_description desc("Options");
+  desc.add_options()
+    ("help,h", "Print help information")
+    ("version","Print version number")
+    ("database,d", po::value<std::string>(&databasePath)->required(), "Catalogue database")
+    ("index", po::value<std::vector<std::string> >(&indexDirectories)->composing(),
+      "Directory to (re-)index (may be repeated)")
+    ("jobs,j", po::value<unsigned int>(&numThreads), "Threads (default = one per core)")
+    ("type,t", po::value<std::string>(&query.type), "Only files of this type, e.g. MMR_LIST")
+    ("scanner,s", po::value<std::string>(&query.scanner), "Only files from this scanner (serial, station or model)")
+    ("from", po::value<std::string>(&query.from), "Only studies on or after this date (YYYY-MM-DD)")
+    ("to", po::value<std::string>(&query.to), "Only studies on or before this date (YYYY-MM-DD)")
+    ("without", po::value<std::string>(&query.without),
+      "Only files with no file of this type from the same scanner on the same day")
+    ("sql", po::value<std::string>(&sql), "Run an SQL query on the catalogue")
+    ("log,l", "Write log file");
+
+  //Evaluate command line options
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc),
+      vm); // can throw
+
+    /** --help option
+    */
+    if (vm.count("help")) {
+      std::cout << APP_NAME << std::endl
+        << desc << std::endl;
+      return EXIT_SUCCESS;
+    }
+
+    if (vm.count("version") ) {
+      std::cout << APP_NAME << " : v" << VERSION_NO << std::endl;
+      return EXIT_SUCCESS;
+    }
+
+    po::notify(vm); // throws on error
+
+  } catch (po::error& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+    std::cerr << desc << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  //Configure logging
+  fs::path log_path = fs::absolute(fs::current_path());
+  log_path /= APP_NAME;
+  log_path += "-";
+
+  //Pretty coloured logging (if supported)
+  FLAGS_colorlogtostderr = 1;
+
+  if (vm.count("log")){
+    FLAGS_alsologtostderr = 1;
+  }
+  else {
+    FLAGS_logtostderr = 1;
+  }
+
+  google::InitGoogleLogging(argv[0]);
+  google::SetLogDestination(google::INFO, log_path.string().c_str());
+
+  std::time_t startTime = std::time( 0 ) ;
+
+  //Application starts here
+  LOG(INFO) << "Started: " << std::asctime(std::localtime(&startTime));
+  LOG(INFO) << "Running '" << APP_NAME << "' version: " << VERSION_NO;
+
+  if (numThreads > 0)
+    nm::SetDefaultNumberOfThreads(numThreads);
+
+  const bool bIndexing = !indexDirectories.empty();
+
+  //Queries never change the catalogue.
+  nm::RawDataCatalogue catalogue;
+  if (!catalogue.Open(databasePath, !bIndexing)) {
+    return EXIT_FAILURE;
+  }
+
+  if (bIndexing) {
+    nm::ThreadPool pool;
+    catalogue.SetThreadPool(&pool);
+
+    for (const auto &dir : indexDirectories) {
+      LOG(INFO) << "Indexing " << dir;
+      if (!catalogue.Index(dir)) {
+        LOG(ERROR) << "Indexing " << dir << " failed!";
+        return EXIT_FAILURE;
+      }
+      LOG(INFO) << "Read " << catalogue.GetNumberOfFilesRead() << " file(s), removed "
+                << catalogue.GetNumberOfFilesRemoved();
+    }
+  }
+
+  if (!sql.empty()) {
+    if (!catalogue.Execute(sql, std::cout)) {
+      return EXIT_FAILURE;
+    }
+  }
+  else if (!bIndexing || vm.count("type") || vm.count("scanner") || vm.count("from")
+           || vm.count("to") || vm.count("without")) {
+
+    std::vector<nm::CatalogueRow> rows;
+    if (!catalogue.Find(query, rows)) {
+      return EXIT_FAILURE;
+    }
+
+    std::cout << "path\ttype\tscanner\tstudy_date\tstudy_time\theader_file\tdata_file" << std::endl;
+    for (const auto &row : rows) {
+      std::cout << row.path << "\t" << row.type << "\t" << row.scanner << "\t"
+                << row.studyDate << "\t" << row.studyTime << "\t"
+                << row.headerFile << "\t" << row.dataFile << std::endl;
+    }
+  }
+
+  //Print total execution time
+  std::time_t stopTime = std::time( 0 ) ;
+  unsigned int totalTime = stopTime - startTime;
+  LOG(INFO) << "Time taken: " << totalTime << " seconds";
+  LOG(INFO) << "Ended: " << std::asctime(std::localtime(&stopTime));
+
+  return EXIT_SUCCESS;
+}
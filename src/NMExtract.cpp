@@ -52,6 +52,7 @@ int main(int argc, char **argv)
     ("output,o", po::value<std::string>(&outputDirectory), "Output directory")
     ("prefix,p", po::value<std::string>(&prefixName), "Prefix for filename")
     ("noupdate", "Do not modify Interfile headers")
+    ("nosidecar", "Do not write a JSON metadata sidecar")
     ("log,l", "Write log file");
 
   //Evaluate command line options
@@ -174,6 +175,17 @@ int main(int argc, char **argv)
     //LOG(INFO) << "New header path = " << outFilePath;
   }
 
+  //JSON sidecar next to the header, e.g. <name>.l.json for <name>.l.hdr.
+  //Checked before anything is written, so a stale one leaves no outputs.
+  fs::path sidecarPath = outDstDir;
+  sidecarPath /= reader->GetStdFileName(outFilePath, nm::ContentType::EHEADER);
+  sidecarPath.replace_extension(".json");
+
+  if (!vm.count("nosidecar") && fs::exists(sidecarPath)) {
+    LOG(ERROR) << "Sidecar " << sidecarPath << " already exists! Refusing to over-write!";
+    return EXIT_FAILURE;
+  }
+
   //Make new filename path for raw data
   fs::path newDataFileName = reader->GetStdFileName(outFilePath, nm::ContentType::ERAWDATA);
 
@@ -190,6 +202,11 @@ int main(int argc, char **argv)
 
   newDataFileName = dstPath;
 
+  //Header is updated in memory and written once.
+  if (! vm.count("noupdate")) {
+    reader->SetDataFileName(newDataFileName);
+  }
+
   fs::path newHeaderFileName = reader->GetStdFileName(outFilePath,nm::ContentType::EHEADER);
   dstPath = outDstDir;
   dstPath /= newHeaderFileName;
@@ -203,18 +220,31 @@ int main(int argc, char **argv)
     return EXIT_FAILURE;
   }
 
-  newHeaderFileName = dstPath;
+  if (! vm.count("nosidecar")) {
 
-  if (! vm.count("noupdate")) {
-    if ( reader->ModifyHeader(newHeaderFileName, newDataFileName) ){
-      LOG(INFO) << "Header updated successfully.";
+    nlohmann::json metadata;
+    if (!reader->GetMetadata(metadata)) {
+      LOG(ERROR) << "Unable to collect metadata!";
+      return EXIT_FAILURE;
     }
-    else {
-      LOG(ERROR) << "Header update failed!";
+
+    const fs::path rawDataFileName = reader->GetStdFileName(outFilePath, nm::ContentType::ERAWDATA);
+
+    metadata["HeaderFile"] = dstPath.filename().string();
+    metadata["DataFile"] = rawDataFileName.empty() ? dstPath.filename().string()
+                                                   : rawDataFileName.filename().string();
+
+    std::ofstream sidecar(sidecarPath.string().c_str());
+    sidecar << metadata.dump(2) << std::endl;
+    sidecar.close();
+
+    if (!sidecar) {
+      LOG(ERROR) << "Unable to write metadata to " << sidecarPath;
       return EXIT_FAILURE;
     }
-  }
 
+    LOG(INFO) << "Metadata written to: " << sidecarPath;
+  }
 
   //Print total execution time
   std::time_t stopTime = std::time( 0 ) ;
@@ -26,6 +26,8 @@
 #include <memory>
 
 #include "nmtools/MRAC-Signa.hpp"
+#include "nmtools/ACF.hpp"
+#include "nmtools/Batch.hpp"
 #include "EnvironmentInfo.h"
 
 int main(int argc, char **argv)
@@ -36,6 +38,16 @@ int main(int argc, char **argv)
   std::string inputDirPath;
   std::string outputFilePath = "";
   std::string coordOrientation = "RAI";
+  std::string cacheDirPath = "";
+  std::string batchListPath = "";
+  std::string batchGlob = "";
+  unsigned int numJobs = 0;
+  int gzipLevel = -1;
+  double smoothingFWHM = 0.0;
+  std::string acfPath = "";
+  std::string registrationPath = "";
+  std::string truncationPath = "";
+  double truncationThreshold = 0.1;
 
   //Set-up command line options
   namespace po = boost::program_options;
@@ -47,9 +59,20 @@ int main(int argc, char **argv)
     ("help,h", "Print help information")
     ("version","Print version number")
     //("verbose,v", "Be verbose")
-    ("input,i", po::value<std::string>(&inputDirPath)->required(), "Input directory")
-    ("output,o", po::value<std::string>(&outputFilePath)->required(), "Output file")
+    ("input,i", po::value<std::string>(&inputDirPath), "Input directory")
+    ("output,o", po::value<std::string>(&outputFilePath), "Output file")
     ("orient", po::value<std::string>(&coordOrientation), "Output orientation: e.g. RAI or LPS (default = RAI)")
+    ("cache", po::value<std::string>(&cacheDirPath), "Directory for caching DICOM directory scans")
+    ("gzip-level", po::value<int>(&gzipLevel), "Compression level (0-9) for .nii.gz output (default = 6)")
+    ("all-series", "Convert every series in the input directory (output name is used as a template)")
+    ("batch", po::value<std::string>(&batchListPath), "Convert each '<input dir> <output file>' line of this file")
+    ("batch-glob", po::value<std::string>(&batchGlob), "Convert directories matching this pattern; '{}' in the output name is replaced by each directory name")
+    ("jobs,j", po::value<unsigned int>(&numJobs), "Conversions run at once in batch modes (default = one per core)")
+    ("smooth", po::value<double>(&smoothingFWHM), "Gaussian smoothing of the mu-map, FWHM in mm (default = 0, none)")
+    ("register", po::value<std::string>(&registrationPath), "NAC PET image to rigidly align the mu-map to")
+    ("truncation", po::value<std::string>(&truncationPath), "NAC PET image or body outline used to fill regions truncated by the MR FOV")
+    ("truncation-threshold", po::value<double>(&truncationThreshold), "Body outline threshold, as a fraction of the --truncation image maximum (default = 0.1)")
+    ("acf", po::value<std::string>(&acfPath), "Also write Signa attenuation correction factors to this Interfile sinogram (.hs)")
     ("log,l", "Write log file");
 
   //Evaluate command line options
@@ -73,6 +96,32 @@ int main(int argc, char **argv)
 
     po::notify(vm); // throws on error
 
+    if (gzipLevel < -1 || gzipLevel > 9)
+      throw po::validation_error(po::validation_error::invalid_option_value, "gzip-level");
+
+    if (!(smoothingFWHM >= 0.0))
+      throw po::validation_error(po::validation_error::invalid_option_value, "smooth");
+
+    if (vm.count("acf") && (vm.count("batch") || vm.count("batch-glob") || vm.count("all-series")))
+      throw po::error("--acf needs a single input");
+
+    if (!(truncationThreshold > 0.0 && truncationThreshold < 1.0))
+      throw po::validation_error(po::validation_error::invalid_option_value, "truncation-threshold");
+
+    if (vm.count("truncation") && (vm.count("batch") || vm.count("batch-glob") || vm.count("all-series")))
+      throw po::error("--truncation needs a single input");
+
+    if (vm.count("register") && (vm.count("batch") || vm.count("batch-glob") || vm.count("all-series")))
+      throw po::error("--register needs a single input");
+
+    //Batch lists carry their own inputs and outputs.
+    if (!vm.count("batch")) {
+      if (!vm.count("batch-glob") && !vm.count("input"))
+        throw po::required_option("input");
+      if (!vm.count("output"))
+        throw po::required_option("output");
+    }
+
   } catch (po::error& e) {
     std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
     std::cerr << desc << std::endl;
@@ -103,6 +152,34 @@ int main(int argc, char **argv)
   LOG(INFO) << "Started: " << std::asctime(std::localtime(&startTime));
   LOG(INFO) << "Running '" << APP_NAME << "' version: " << VERSION_NO;
 
+  nm::BatchOptions batchOptions;
+  batchOptions.orientationCode = coordOrientation;
+  batchOptions.cacheDir = cacheDirPath;
+  batchOptions.numConcurrent = numJobs;
+  batchOptions.compressionLevel = gzipLevel;
+  batchOptions.smoothingFWHM = smoothingFWHM;
+
+  if (vm.count("batch") || vm.count("batch-glob")){
+    std::vector<nm::BatchJob> jobs;
+
+    bool bStatus = vm.count("batch") ? nm::ReadBatchList(batchListPath, jobs)
+                                     : nm::GlobBatchJobs(batchGlob, outputFilePath, jobs);
+
+    if (bStatus && nm::RunBatch<nm::SignaMRAC2MU>(jobs, batchOptions)){
+      LOG(INFO) << "Batch complete";
+    } else {
+      LOG(ERROR) << "Batch conversion failed!";
+      return EXIT_FAILURE;
+    }
+
+    std::time_t stopTime = std::time( 0 ) ;
+    unsigned int totalTime = stopTime - startTime;
+    LOG(INFO) << "Time taken: " << totalTime << " seconds";
+    LOG(INFO) << "Ended: " << std::asctime(std::localtime(&stopTime));
+
+    return EXIT_SUCCESS;
+  }
+
   fs::path srcPath = inputDirPath;
 
   //Check if input file even exists!
@@ -117,6 +194,22 @@ int main(int argc, char **argv)
     return EXIT_FAILURE;
   }
 
+  if (vm.count("all-series")){
+    if (nm::ConvertAllSeries<nm::SignaMRAC2MU>(srcPath, outputFilePath, batchOptions)){
+      LOG(INFO) << "All series converted";
+    } else {
+      LOG(ERROR) << "Failed to convert all series!";
+      return EXIT_FAILURE;
+    }
+
+    std::time_t stopTime = std::time( 0 ) ;
+    unsigned int totalTime = stopTime - startTime;
+    LOG(INFO) << "Time taken: " << totalTime << " seconds";
+    LOG(INFO) << "Ended: " << std::asctime(std::localtime(&stopTime));
+
+    return EXIT_SUCCESS;
+  }
+
   std::unique_ptr<nm::SignaMRAC2MU> mrac;
 
   try {
@@ -126,6 +219,29 @@ int main(int argc, char **argv)
     return EXIT_FAILURE;
   }
 
+  if (vm.count("cache")){
+    mrac->SetCacheDirectory(cacheDirPath);
+  }
+
+  mrac->SetCompressionLevel(gzipLevel);
+  mrac->SetSmoothing(smoothingFWHM);
+
+  if (vm.count("register")){
+    if (!fs::is_regular_file(registrationPath)){
+      LOG(ERROR) << "NAC PET image " << registrationPath << " does not exist!";
+      return EXIT_FAILURE;
+    }
+    mrac->SetRegistrationTarget(registrationPath);
+  }
+
+  if (vm.count("truncation")){
+    if (!fs::is_regular_file(truncationPath)){
+      LOG(ERROR) << "Body outline " << truncationPath << " does not exist!";
+      return EXIT_FAILURE;
+    }
+    mrac->SetTruncationCompletion(truncationPath, truncationThreshold);
+  }
+
 
   if (mrac->Update()){
     LOG(INFO) << "Scaling complete";
@@ -141,6 +257,20 @@ int main(int argc, char **argv)
     return EXIT_FAILURE;
   }
 
+  if (vm.count("acf")){
+    nm::ScannerGeometry scanner;
+    nm::GetScannerGeometry("Signa", scanner);
+
+    nm::ACFProjector projector(scanner);
+
+    if (projector.Update(mrac->GetOutput().GetPointer()) && projector.Write(acfPath)){
+      LOG(INFO) << "ACF sinogram complete";
+    } else {
+      LOG(ERROR) << "Failed to write ACF sinogram!";
+      return EXIT_FAILURE;
+    }
+  }
+
   //Print total execution time
   std::time_t stopTime = std::time( 0 ) ;
   unsigned int totalTime = stopTime - startTime;
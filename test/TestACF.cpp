@@ -0,0 +1,167 @@
+/*
+   TestACF.cpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   ACFs of a uniform cylinder (ACF.hpp) against the analytic chord length.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "nmtools/ACF.hpp"
+#include "Testing.hpp"
+
+namespace nm = nmtools;
+
+typedef itk::Image<float, 3> ImageType;
+
+//A small scanner, so the whole sinogram is quick to project.
+nm::ScannerGeometry GetTestScanner(){
+
+  nm::ScannerGeometry scanner;
+  scanner.name = "test";
+  scanner.numRings = 8;
+  scanner.numDetectorsPerRing = 64;
+  scanner.numViews = 32;
+  scanner.numBins = 48;
+  scanner.innerRadius = 150.0;
+  scanner.averageDOI = 0.0;
+  scanner.ringSpacing = 4.0;
+  scanner.binSize = 4.0;
+  scanner.span = 1;
+  scanner.maxRingDifference = 3;
+
+  return scanner;
+}
+
+const double kRadius = 60.0;  //mm
+const double kMu = 0.1;       //cm-1
+
+//Cylinder of radius kRadius about the scanner axis (x = y = 0), longer
+//than the scanner, on 1 mm voxels in-plane. If flipY, the y axis runs
+//backwards (as in RAS).
+ImageType::Pointer MakeCylinder(bool flipY){
+
+  const std::size_t n = 160;
+  const std::size_t nz = 40;
+
+  ImageType::SizeType size;
+  size[0] = n;
+  size[1] = n;
+  size[2] = nz;
+
+  ImageType::SpacingType spacing;
+  spacing[0] = 1.0;
+  spacing[1] = 1.0;
+  spacing[2] = 2.0;
+
+  ImageType::DirectionType direction;
+  for (unsigned int r = 0; r < 3; r++)
+    for (unsigned int c = 0; c < 3; c++)
+      direction[r][c] = r == c ? 1.0 : 0.0;
+  if (flipY)
+    direction[1][1] = -1.0;
+
+  ImageType::PointType origin;
+  origin[0] = -0.5 * (n - 1) * spacing[0];
+  origin[1] = (flipY ? 0.5 : -0.5) * (n - 1) * spacing[1];
+  origin[2] = -0.5 * (nz - 1) * spacing[2];
+
+  ImageType::RegionType region;
+  region.SetSize(size);
+
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions(region);
+  image->SetSpacing(spacing);
+  image->SetOrigin(origin);
+  image->SetDirection(direction);
+  image->Allocate();
+
+  float *p = image->GetBufferPointer();
+  for (std::size_t z = 0; z < nz; z++)
+    for (std::size_t y = 0; y < n; y++)
+      for (std::size_t x = 0; x < n; x++) {
+        const double px = origin[0] + x * spacing[0];
+        const double py = origin[1] + y * direction[1][1] * spacing[1];
+        *p++ = px * px + py * py < kRadius * kRadius ? static_cast<float>(kMu) : 0.0f;
+      }
+
+  return image;
+}
+
+//Every line of response: ln(ACF) = mu * chord * secant of the tilt,
+//where the chord at tangential position s is 2 sqrt(R^2 - s^2). Rays
+//missing the cylinder have an ACF of exactly one. The voxelised edge
+//allows about a millimetre of path.
+void TestCylinder(bool flipY){
+
+  const nm::ScannerGeometry scanner = GetTestScanner();
+  nm::ACFProjector projector(scanner);
+
+  ImageType::Pointer cylinder = MakeCylinder(flipY);
+  NM_CHECK(projector.Update(cylinder.GetPointer()));
+
+  const std::vector<nm::SinogramSegment> &segments = projector.GetSegments();
+  const std::vector<float> &acf = projector.GetOutput();
+
+  //Span 1: one segment per ring difference, numRings - |d| positions.
+  NM_CHECK(segments.size() == 7);
+
+  std::size_t total = 0;
+  for (const nm::SinogramSegment &segment : segments) {
+    NM_CHECK(segment.minRingDifference == segment.maxRingDifference);
+    NM_CHECK(segment.z.size() == scanner.numRings - std::abs(segment.minRingDifference));
+    total += segment.z.size() * scanner.numViews * scanner.numBins;
+  }
+  NM_CHECK(acf.size() == total);
+
+  if (acf.size() != total)
+    return;
+
+  const double radius = scanner.innerRadius + scanner.averageDOI;
+  std::size_t offset = 0;
+
+  for (const nm::SinogramSegment &segment : segments) {
+    for (std::size_t a = 0; a < segment.z.size(); a++) {
+      for (unsigned int v = 0; v < scanner.numViews; v++) {
+        for (unsigned int b = 0; b < scanner.numBins; b++, offset++) {
+
+          const double position = static_cast<double>(b) - scanner.numBins / 2;
+          const double s = radius * std::sin(position * scanner.binSize / radius);
+          const double halfLength = std::sqrt(radius * radius - s * s);
+          const double tilt = segment.ringDifference[a] * scanner.ringSpacing / (2.0 * halfLength);
+          const double secant = std::sqrt(1.0 + tilt * tilt);
+
+          if (std::fabs(s) >= kRadius + 1.0) {
+            NM_CHECK(acf[offset] == 1.0f);
+          }
+          else if (std::fabs(s) <= 0.8 * kRadius) {
+            const double chord = 2.0 * std::sqrt(kRadius * kRadius - s * s);
+            NM_CHECK_NEAR(std::log(acf[offset]), 0.1 * kMu * chord * secant, 0.1 * kMu * 1.5);
+          }
+        }
+      }
+    }
+  }
+}
+
+int main(int, char **){
+
+  TestCylinder(false);
+  TestCylinder(true);
+
+  return nmtools::testing::Report();
+}
@@ -0,0 +1,335 @@
+/*
+   TestCatalogue.cpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Classification, indexing and queries of the raw data catalogue
+   (Catalogue.hpp), on a small tree of DICOM files written at run time.
+ */
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gdcmReader.h>
+#include <gdcmSequenceOfItems.h>
+#include <gdcmWriter.h>
+#include <boost/filesystem.hpp>
+
+#include "nmtools/Catalogue.hpp"
+#include "Testing.hpp"
+
+namespace nm = nmtools;
+namespace fs = boost::filesystem;
+
+struct Element {
+  uint16_t group;
+  uint16_t element;
+  gdcm::VR::VRType vr;
+  std::string value;
+};
+
+//Element with a text (or opaque) value, padded to even length.
+void SetValue(gdcm::DataSet &ds, uint16_t group, uint16_t element,
+              gdcm::VR::VRType vr, std::string value){
+
+  if (value.size() % 2)
+    value += vr == gdcm::VR::UI || vr == gdcm::VR::OB ? '\0' : ' ';
+
+  gdcm::DataElement de(gdcm::Tag(group, element));
+  de.SetVR(vr);
+  de.SetByteValue(value.c_str(), static_cast<uint32_t>(value.size()));
+  ds.Insert(de);
+}
+
+//Sequence of one item, holding itemData.
+gdcm::DataElement MakeSequence(uint16_t group, uint16_t element, const gdcm::DataSet &itemData){
+
+  gdcm::Item item;
+  item.SetVLToUndefined();
+  item.SetNestedDataSet(itemData);
+
+  gdcm::SmartPointer<gdcm::SequenceOfItems> sq = new gdcm::SequenceOfItems;
+  sq->SetLengthToUndefined();
+  sq->AddItem(item);
+
+  gdcm::DataElement de(gdcm::Tag(group, element));
+  de.SetVR(gdcm::VR::SQ);
+  de.SetValue(*sq);
+  de.SetVLToUndefined();
+
+  return de;
+}
+
+//Raw Data Storage instance with the study and scanner fields all types
+//share, and the type's own elements (and sequences). Empty values are
+//left out.
+bool WriteRawData(const fs::path &path, const std::string &manufacturer, const std::string &model,
+                  const std::string &serial, const std::string &studyDate, const std::string &sopUID,
+                  const std::vector<Element> &elements,
+                  const std::vector<gdcm::DataElement> &sequences = {}){
+
+  gdcm::Writer writer;
+  writer.SetFileName(path.string().c_str());
+
+  gdcm::File &file = writer.GetFile();
+  file.GetHeader().SetDataSetTransferSyntax(gdcm::TransferSyntax::ExplicitVRLittleEndian);
+  gdcm::DataSet &ds = file.GetDataSet();
+
+  SetValue(ds, 0x0008, 0x0016, gdcm::VR::UI, "1.2.840.10008.5.1.4.1.1.66");
+  SetValue(ds, 0x0008, 0x0018, gdcm::VR::UI, sopUID);
+  if (!studyDate.empty())
+    SetValue(ds, 0x0008, 0x0020, gdcm::VR::DA, studyDate);
+  SetValue(ds, 0x0008, 0x0030, gdcm::VR::TM, "101112");
+  SetValue(ds, 0x0008, 0x0060, gdcm::VR::CS, "PT");
+  SetValue(ds, 0x0008, 0x0070, gdcm::VR::LO, manufacturer);
+  SetValue(ds, 0x0008, 0x1090, gdcm::VR::LO, model);
+  if (!serial.empty())
+    SetValue(ds, 0x0018, 0x1000, gdcm::VR::LO, serial);
+  SetValue(ds, 0x0020, 0x000D, gdcm::VR::UI, "1.2.3.100");
+  SetValue(ds, 0x0020, 0x000E, gdcm::VR::UI, "1.2.3.101");
+
+  for (const Element &e : elements)
+    SetValue(ds, e.group, e.element, e.vr, e.value);
+
+  for (const gdcm::DataElement &de : sequences)
+    ds.Insert(de);
+
+  return writer.Write();
+}
+
+//mMR list mode or norm (imageType PET_LISTMODE or PET_NORM), with its
+//Interfile header and a little raw data, which the catalogue never reads.
+bool WriteMMR(const fs::path &path, const std::string &imageType, const std::string &studyDate,
+              const std::string &sopUID){
+
+  const std::string header =
+    "!INTERFILE:=\r\n"
+    "!originating system:=2008\r\n"
+    "isotope name:=F-18\r\n"
+    "isotope gamma halflife (sec):=6586.2\r\n"
+    "image duration (sec):=600\r\n"
+    "%total listmode word counts:=1000\r\n"
+    "!END OF INTERFILE:=\r\n";
+
+  return WriteRawData(path, "SIEMENS", "Biograph_mMR", "51010", studyDate, sopUID,
+                      { { 0x0008, 0x0008, gdcm::VR::CS, "ORIGINAL\\PRIMARY\\" + imageType },
+                        { 0x0029, 0x0010, gdcm::VR::LO, "SIEMENS CSA NON-IMAGE" },
+                        { 0x0029, 0x1010, gdcm::VR::OB, header },
+                        { 0x7fe1, 0x0010, gdcm::VR::LO, "SIEMENS CSA NON-IMAGE" },
+                        { 0x7fe1, 0x1010, gdcm::VR::OB, std::string(64, '\x7f') } });
+}
+
+//GE 3D norm, with its radiopharmaceutical, frame duration and table
+//position.
+bool WriteGENorm(const fs::path &path, const std::string &studyDate, const std::string &sopUID){
+
+  gdcm::DataSet code;
+  SetValue(code, 0x0008, 0x0104, gdcm::VR::LO, "^18^Fluorine");
+
+  gdcm::DataSet radiopharmaceutical;
+  SetValue(radiopharmaceutical, 0x0018, 0x1075, gdcm::VR::DS, "6586.2");
+  radiopharmaceutical.Insert(MakeSequence(0x0054, 0x0300, code));
+
+  const double tablePosition = -512.5;
+  std::string tablePositionBytes(sizeof(tablePosition), '\0');
+  std::memcpy(&tablePositionBytes[0], &tablePosition, sizeof(tablePosition));
+
+  return WriteRawData(path, "GE MEDICAL SYSTEMS", "Discovery MI", "GE100", studyDate, sopUID,
+                      { { 0x0017, 0x0010, gdcm::VR::LO, "GEMS_PETD_01" },
+                        { 0x0017, 0x1006, gdcm::VR::IS, "2" },
+                        { 0x0018, 0x1242, gdcm::VR::IS, "300000" },
+                        { 0x0018, 0x9327, gdcm::VR::FD, tablePositionBytes },
+                        { 0x0021, 0x0010, gdcm::VR::LO, "GEMS_PETD_01" },
+                        { 0x0021, 0x1001, gdcm::VR::IS, "4" } },
+                      { MakeSequence(0x0054, 0x0016, radiopharmaceutical) });
+}
+
+void WriteText(const fs::path &path, const std::string &text){
+  std::ofstream out(path.string().c_str());
+  out << text;
+}
+
+//Types of every fixture, by file and by factory.
+void TestFileTypes(const fs::path &data){
+
+  nm::SiemensPETFactory siemens;
+  nm::GEPETFactory ge;
+
+  gdcm::Reader mmrReader;
+  mmrReader.SetFileName((data / "a" / "norm.dcm").string().c_str());
+  NM_CHECK(mmrReader.Read());
+  NM_CHECK(siemens.GetFileType(mmrReader.GetFile()) == nm::SiemensPETFactory::FileType::EMMRNORM);
+  NM_CHECK(ge.GetFileType(mmrReader.GetFile()) == nm::GEPETFactory::FileType::EUNKNOWN);
+
+  gdcm::Reader geReader;
+  geReader.SetFileName((data / "ge" / "norm.dcm").string().c_str());
+  NM_CHECK(geReader.Read());
+  NM_CHECK(ge.GetFileType(geReader.GetFile()) == nm::GEPETFactory::FileType::EGEPETNORM3D);
+  NM_CHECK(siemens.GetFileType(geReader.GetFile()) == nm::SiemensPETFactory::FileType::EUNKNOWN);
+
+  const std::pair<const char*, const char*> expected[] = {
+    { "a/list.dcm", "MMR_LIST" }, { "a/norm.dcm", "MMR_NORM" }, { "a/list.json", "SIDECAR" },
+    { "b/list.dcm", "MMR_LIST" }, { "b/nodate.dcm", "MMR_LIST" }, { "ge/norm.dcm", "GE_NORM3D" },
+    { "notes.txt", "NOT_DICOM" } };
+
+  for (const auto &e : expected) {
+    nm::CatalogueEntry entry;
+    entry.path = (data / e.first).string();
+    NM_CHECK(nm::ReadCatalogueEntry(entry));
+    NM_CHECK(entry.type == e.second);
+  }
+
+  //BIDS and Interfile metadata, from the headers alone.
+  nm::CatalogueEntry entry;
+  entry.path = (data / "a" / "list.dcm").string();
+  NM_CHECK(nm::ReadCatalogueEntry(entry));
+
+  const nlohmann::json &m = entry.metadata;
+  NM_CHECK(m.value("TracerRadionuclide", "") == "F18");
+  NM_CHECK(m.value("StudyDate", "") == "2017-01-02");
+  NM_CHECK(m.value("StudyTime", "") == "10:11:12");
+  NM_CHECK(m.value("DeviceSerialNumber", "") == "51010");
+  NM_CHECK(m.value("SOPInstanceUID", "") == "1.2.3.1");
+  NM_CHECK(m.count("InterfileListmodeWordCount") && m["InterfileListmodeWordCount"] == 1000);
+  NM_CHECK(m.count("FrameDuration") && m["FrameDuration"].is_array() && m["FrameDuration"][0] == 600.0);
+
+  //GE: from the standard tags, the isotope from its coded form.
+  nm::CatalogueEntry geEntry;
+  geEntry.path = (data / "ge" / "norm.dcm").string();
+  NM_CHECK(nm::ReadCatalogueEntry(geEntry));
+
+  const nlohmann::json &g = geEntry.metadata;
+  NM_CHECK(g.value("TracerRadionuclide", "") == "F18");
+  NM_CHECK(g.count("RadionuclideHalfLife") && g["RadionuclideHalfLife"] == 6586.2);
+  NM_CHECK(g.count("FrameDuration") && g["FrameDuration"].is_array() && g["FrameDuration"][0] == 300.0);
+  NM_CHECK(g.count("TablePosition") && g["TablePosition"] == -512.5);
+  NM_CHECK(g.value("StudyDate", "") == "2017-01-02");
+
+  NM_CHECK(nm::FormatCodedRadionuclide("^11^Carbon") == "C11");
+  NM_CHECK(nm::FormatCodedRadionuclide("^68^Gallium") == "Ga68");
+  NM_CHECK(nm::FormatCodedRadionuclide("F-18") == "F18");
+}
+
+std::vector<nm::CatalogueRow> Find(nm::RawDataCatalogue &catalogue, const std::string &type,
+                                   const std::string &scanner, const std::string &from,
+                                   const std::string &to, const std::string &without){
+
+  nm::CatalogueQuery query;
+  query.type = type;
+  query.scanner = scanner;
+  query.from = from;
+  query.to = to;
+  query.without = without;
+
+  std::vector<nm::CatalogueRow> rows;
+  NM_CHECK(catalogue.Find(query, rows));
+
+  return rows;
+}
+
+//Index, query, then index again after changes to the tree.
+void TestCatalogue(const fs::path &data, const fs::path &dbPath){
+
+  nm::RawDataCatalogue catalogue;
+  NM_CHECK(catalogue.Open(dbPath));
+
+  NM_CHECK(catalogue.Index(data));
+  NM_CHECK(catalogue.GetNumberOfFilesRead() == 7);
+  NM_CHECK(catalogue.GetNumberOfFilesRemoved() == 0);
+
+  //Raw data only, by date, time and path.
+  std::vector<nm::CatalogueRow> rows = Find(catalogue, "", "", "", "", "");
+  NM_CHECK(rows.size() == 5);
+
+  NM_CHECK(Find(catalogue, "MMR_LIST", "", "", "", "").size() == 3);
+  NM_CHECK(Find(catalogue, "", "51010", "", "", "").size() == 4);
+  NM_CHECK(Find(catalogue, "", "Discovery MI", "", "", "").size() == 1);
+  NM_CHECK(Find(catalogue, "", "", "", "2017-01-02", "").size() == 3);
+
+  rows = Find(catalogue, "", "", "2017-01-03", "", "");
+  NM_CHECK(rows.size() == 1 && rows[0].path == (data / "b" / "list.dcm").string());
+
+  //List mode with no norm from the same scanner that day: not a/list.dcm
+  //(a/norm.dcm), nor b/nodate.dcm, which has no date to match.
+  rows = Find(catalogue, "MMR_LIST", "", "", "", "MMR_NORM");
+  NM_CHECK(rows.size() == 1 && rows[0].path == (data / "b" / "list.dcm").string());
+
+  //Outputs from the sidecar of the same instance.
+  rows = Find(catalogue, "MMR_LIST", "", "", "2017-01-02", "");
+  NM_CHECK(rows.size() == 1);
+  if (rows.size() == 1) {
+    NM_CHECK(rows[0].scanner == "51010");
+    NM_CHECK(rows[0].studyDate == "2017-01-02");
+    NM_CHECK(rows[0].studyTime == "10:11:12");
+    NM_CHECK(rows[0].headerFile == (data / "a" / "list.hdr").string());
+    NM_CHECK(rows[0].dataFile == (data / "a" / "list.l").string());
+  }
+
+  std::ostringstream out;
+  NM_CHECK(catalogue.Execute("SELECT DISTINCT isotope, word_count FROM files WHERE type = 'MMR_LIST';", out));
+  NM_CHECK(out.str() == "isotope\tword_count\nF18\t1000\n");
+
+  //Nothing new.
+  NM_CHECK(catalogue.Index(data));
+  NM_CHECK(catalogue.GetNumberOfFilesRead() == 0);
+  NM_CHECK(catalogue.GetNumberOfFilesRemoved() == 0);
+
+  //One file gone, one more norm.
+  fs::remove(data / "b" / "list.dcm");
+  NM_CHECK(WriteMMR(data / "b" / "norm.dcm", "PET_NORM", "20170105", "1.2.3.6"));
+
+  NM_CHECK(catalogue.Index(data));
+  NM_CHECK(catalogue.GetNumberOfFilesRead() == 1);
+  NM_CHECK(catalogue.GetNumberOfFilesRemoved() == 1);
+
+  NM_CHECK(Find(catalogue, "MMR_LIST", "", "", "", "MMR_NORM").empty());
+  NM_CHECK(Find(catalogue, "MMR_NORM", "", "", "", "").size() == 2);
+
+  //Files outside the tree indexed are left alone.
+  NM_CHECK(catalogue.Index(data / "ge"));
+  NM_CHECK(catalogue.GetNumberOfFilesRemoved() == 0);
+  NM_CHECK(Find(catalogue, "", "", "", "", "").size() == 5);
+}
+
+int main(int, char **){
+
+  const fs::path dir = fs::temp_directory_path() / fs::unique_path("nm_catalogue_%%%%-%%%%");
+  fs::create_directories(dir / "data" / "a");
+  fs::create_directories(dir / "data" / "b");
+  fs::create_directories(dir / "data" / "ge");
+
+  //Paths as the catalogue records them.
+  const fs::path data = fs::canonical(dir / "data");
+
+  NM_CHECK(WriteMMR(data / "a" / "list.dcm", "PET_LISTMODE", "20170102", "1.2.3.1"));
+  NM_CHECK(WriteMMR(data / "a" / "norm.dcm", "PET_NORM", "20170102", "1.2.3.2"));
+  NM_CHECK(WriteMMR(data / "b" / "list.dcm", "PET_LISTMODE", "20170105", "1.2.3.3"));
+  NM_CHECK(WriteMMR(data / "b" / "nodate.dcm", "PET_LISTMODE", "", "1.2.3.4"));
+  NM_CHECK(WriteGENorm(data / "ge" / "norm.dcm", "20170102", "1.2.3.5"));
+
+  WriteText(data / "a" / "list.json",
+            "{ \"SourceFile\": \"list.dcm\", \"SOPInstanceUID\": \"1.2.3.1\","
+            "  \"HeaderFile\": \"list.hdr\", \"DataFile\": \"list.l\" }");
+  WriteText(data / "notes.txt", "Not raw data.");
+
+  TestFileTypes(data);
+  TestCatalogue(data, dir / "catalogue.db");
+
+  fs::remove_all(dir);
+
+  return nmtools::testing::Report();
+}
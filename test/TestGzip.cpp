@@ -0,0 +1,211 @@
+/*
+   TestGzip.cpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   ParallelGzipWriter (Gzip.hpp) and WriteCompressedNifti (Nifti.hpp),
+   inflated again with zlib.
+ */
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <itkImage.h>
+#include <zlib.h>
+
+#include "nmtools/Gzip.hpp"
+#include "nmtools/Nifti.hpp"
+#include "Testing.hpp"
+
+namespace fs = boost::filesystem;
+namespace nm = nmtools;
+
+std::vector<char> ReadFile(const fs::path &src){
+
+  std::ifstream in(src.string().c_str(), std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+//Inflate a whole gzip file into out. False unless it is one complete,
+//valid gzip stream (zlib checks the CRC and size in the trailer).
+bool Inflate(const std::vector<char> &gz, std::vector<char> &out){
+
+  z_stream strm;
+  std::memset(&strm, 0, sizeof(strm));
+
+  if (inflateInit2(&strm, 16 + 15) != Z_OK)
+    return false;
+
+  out.clear();
+  strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(gz.data()));
+  strm.avail_in = static_cast<uInt>(gz.size());
+
+  int ret;
+  char buffer[65536];
+  do {
+    strm.next_out = reinterpret_cast<Bytef*>(buffer);
+    strm.avail_out = sizeof(buffer);
+    ret = inflate(&strm, Z_NO_FLUSH);
+    out.insert(out.end(), buffer, buffer + (sizeof(buffer) - strm.avail_out));
+  } while (ret == Z_OK);
+
+  const bool isComplete = ret == Z_STREAM_END && strm.avail_in == 0;
+  inflateEnd(&strm);
+
+  return isComplete;
+}
+
+//Little-endian 32-bit value at p.
+uLong ReadUInt32(const char *p){
+
+  uLong v = 0;
+  for (unsigned int i = 0; i < 4; i++)
+    v |= static_cast<uLong>(static_cast<unsigned char>(p[i])) << (8 * i);
+
+  return v;
+}
+
+//Part repeating, part noise, so both the dictionary and the sync
+//flushes matter.
+std::vector<char> TestData(std::size_t n){
+
+  std::vector<char> data(n);
+  uint32_t state = 12345;
+  for (std::size_t k = 0; k < n; k++) {
+    state = state * 1664525u + 1013904223u;
+    data[k] = (k / 4096) % 2 ? static_cast<char>(state >> 24) : static_cast<char>("nmtools"[k % 7]);
+  }
+
+  return data;
+}
+
+//Written in pieces of the given sizes (cycled), so both the pending
+//tail and whole groups straight from the caller are used.
+bool WriteGzip(const fs::path &dst, const std::vector<char> &data, int level,
+               unsigned int numThreads, const std::vector<std::size_t> &pieces){
+
+  nm::ParallelGzipWriter writer(level, numThreads, 32768);
+
+  bool bStatus = writer.Open(dst);
+  std::size_t offset = 0;
+  for (std::size_t i = 0; bStatus && offset < data.size(); i++) {
+    const std::size_t n = std::min(pieces[i % pieces.size()], data.size() - offset);
+    bStatus = writer.Write(data.data() + offset, n);
+    offset += n;
+  }
+
+  return writer.Close() && bStatus;
+}
+
+//Every level and thread count inflates to the input, with its CRC and
+//size in the trailer, whether written at once or in pieces.
+void TestRoundTrip(const fs::path &dir){
+
+  const int levels[] = { 0, 1, Z_DEFAULT_COMPRESSION, 9 };
+  const unsigned int threads[] = { 1, 2, 3, 8 };
+  const std::size_t sizes[] = { 0, 1, 1000, 100000, 700001 };
+  const std::vector< std::vector<std::size_t> > pieces = {
+    { 700001 }, { 352, 1 << 20 }, { 1, 5000, 32768, 200000 } };
+
+  const fs::path dst = dir / "data.gz";
+
+  for (int level : levels)
+    for (unsigned int numThreads : threads)
+      for (std::size_t size : sizes)
+        for (const auto &piece : pieces) {
+          const std::vector<char> data = TestData(size);
+
+          NM_CHECK(WriteGzip(dst, data, level, numThreads, piece));
+
+          const std::vector<char> gz = ReadFile(dst);
+          std::vector<char> out;
+          NM_CHECK(gz.size() >= 18);
+          NM_CHECK(Inflate(gz, out));
+          NM_CHECK(out == data);
+
+          if (gz.size() >= 18) {
+            const uLong crc = crc32(crc32(0L, Z_NULL, 0),
+                                    reinterpret_cast<const Bytef*>(data.data()),
+                                    static_cast<uInt>(data.size()));
+            NM_CHECK(ReadUInt32(gz.data() + gz.size() - 8) == crc);
+            NM_CHECK(ReadUInt32(gz.data() + gz.size() - 4) == (size & 0xffffffffu));
+          }
+        }
+}
+
+//A .nii.gz inflates to the header, an empty extension and the image
+//buffer as it is in memory.
+void TestNifti(const fs::path &dir){
+
+  typedef itk::Image<float, 3> ImageType;
+
+  ImageType::SizeType size;
+  size[0] = 64;
+  size[1] = 50;
+  size[2] = 33;
+
+  ImageType::RegionType region;
+  region.SetSize(size);
+
+  ImageType::SpacingType spacing;
+  spacing[0] = 2.0;
+  spacing[1] = 2.5;
+  spacing[2] = 3.0;
+
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions(region);
+  image->SetSpacing(spacing);
+  image->Allocate();
+
+  float *p = image->GetBufferPointer();
+  const std::size_t numPixels = region.GetNumberOfPixels();
+  for (std::size_t k = 0; k < numPixels; k++)
+    p[k] = static_cast<float>(k % 97) * 0.001f;
+
+  const fs::path dst = dir / "image.nii.gz";
+
+  for (unsigned int numThreads : { 1u, 4u }) {
+    NM_CHECK(nm::WriteCompressedNifti(image.GetPointer(), dst, Z_DEFAULT_COMPRESSION, numThreads));
+
+    std::vector<char> out;
+    NM_CHECK(Inflate(ReadFile(dst), out));
+    NM_CHECK(out.size() == 352 + numPixels * sizeof(float));
+
+    if (out.size() == 352 + numPixels * sizeof(float)) {
+      nm::NiftiHeader hdr;
+      std::memcpy(&hdr, out.data(), sizeof(hdr));
+      NM_CHECK(hdr.sizeof_hdr == 348);
+      NM_CHECK(hdr.dim[1] == 64 && hdr.dim[2] == 50 && hdr.dim[3] == 33);
+      NM_CHECK(hdr.datatype == 16);
+      NM_CHECK(std::memcmp(hdr.magic, "n+1", 4) == 0);
+      NM_CHECK(std::memcmp(out.data() + 352, p, numPixels * sizeof(float)) == 0);
+    }
+  }
+}
+
+int main(int, char **){
+
+  const fs::path dir = fs::temp_directory_path() / fs::unique_path("nm_gzip_%%%%-%%%%");
+  fs::create_directories(dir);
+
+  TestRoundTrip(dir);
+  TestNifti(dir);
+
+  fs::remove_all(dir);
+
+  return nmtools::testing::Report();
+}
@@ -0,0 +1,291 @@
+/*
+   TestInterfile.cpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Interfile parsing (InterfileParser.hpp) and building
+   (InterfileHeader.hpp), and the mu-map and ACF headers built with them.
+ */
+
+#include <string>
+
+#include "nmtools/ACF.hpp"
+#include "nmtools/InterfileHeader.hpp"
+#include "nmtools/InterfileParser.hpp"
+#include "nmtools/MRAC.hpp"
+#include "Testing.hpp"
+
+namespace nm = nmtools;
+
+//Part of an mMR norm header, with its \r\r\n line endings.
+const std::string kNormHeader =
+  "!INTERFILE:=\r\r\n"
+  "%comment:=SMS-MI header\r\r\n"
+  "!originating system:=2008\r\r\n"
+  "%SMS-MI header name space:=sinogram subheader\r\r\n"
+  "\r\r\n"
+  "!GENERAL DATA:=\r\r\n"
+  "!name of data file:=norm.n\r\r\n"
+  "%data set [1]:={0,,norm.n}\r\r\n"
+  "%total listmode word counts:=  123456789 words \r\r\n"
+  "Name  Of   Data File:=duplicate\r\r\n"
+  "!END OF INTERFILE:=\r\r\n";
+
+//Lines, entries and lookups, whatever the case, '!' and spacing of keys.
+void TestParser(){
+
+  const nm::InterfileParser parser(kNormHeader);
+
+  NM_CHECK(parser.GetLines().size() == 11);
+  NM_CHECK(parser.GetEntries().size() == 10);
+
+  //Line ends exclude every \r.
+  for (const auto &line : parser.GetLines())
+    NM_CHECK(line.second == line.first || kNormHeader[line.second - 1] != '\r');
+
+  std::string value;
+  NM_CHECK(parser.GetValue("name of data file", value) && value == "norm.n");
+  NM_CHECK(parser.GetValue("!NAME OF DATA FILE", value) && value == "norm.n");
+  NM_CHECK(parser.GetValue("  name of  data file ", value) && value == "norm.n");
+  NM_CHECK(parser.GetValue("%data set [1]", value) && value == "{0,,norm.n}");
+  NM_CHECK(parser.GetValue("general data", value) && value.empty());
+  NM_CHECK(!parser.GetValue("data set [2]", value));
+  NM_CHECK(parser.Find("number of rings") == nullptr);
+
+  uint64_t count = 0;
+  NM_CHECK(parser.GetUnsigned("%total listmode word counts", count) && count == 123456789);
+  NM_CHECK(!parser.GetUnsigned("%comment", count));
+
+  //Views point into the buffer; valueBegin is just after ':='.
+  const nm::InterfileEntry *entry = parser.Find("%comment");
+  NM_CHECK(entry != nullptr);
+  if (entry != nullptr) {
+    NM_CHECK(entry->key.data() == kNormHeader.data() + entry->lineBegin);
+    NM_CHECK(kNormHeader.compare(entry->valueBegin - 2, 2, ":=") == 0);
+    NM_CHECK(kNormHeader.substr(entry->lineBegin, entry->lineEnd - entry->lineBegin) ==
+             "%comment:=SMS-MI header");
+  }
+
+  //No final line ending.
+  const std::string lastText = "a:=1\nb := 2";
+  const nm::InterfileParser last(lastText);
+  NM_CHECK(last.GetLines().size() == 2);
+  NM_CHECK(last.GetValue("b", value) && value == "2");
+}
+
+//A header read into a builder comes back line for line, with the line
+//endings asked for; keys are replaced where they stand and new ones
+//appended.
+void TestBuilderRoundTrip(){
+
+  std::string crlf = kNormHeader;
+  for (std::size_t k = crlf.find("\r\r\n"); k != std::string::npos; k = crlf.find("\r\r\n", k))
+    crlf.erase(k, 1);
+
+  nm::InterfileHeaderBuilder header(kNormHeader);
+  NM_CHECK(header.ToString("\r\n") == crlf);
+  NM_CHECK(nm::InterfileHeaderBuilder(crlf).ToString("\r\n") == crlf);
+
+  NM_CHECK(header.Has("NAME OF DATA FILE"));
+  NM_CHECK(!header.Has("number of rings"));
+
+  header.Set("name of data file", "norm_00.n");
+  header.Set("%data set [1]", "{0,,norm_00.n}");
+  header.Set("number of rings", 64);
+
+  std::string value;
+  NM_CHECK(header.GetValue("!name of data file", value) && value == "norm_00.n");
+
+  std::string expected = crlf;
+  expected.replace(expected.find("norm.n"), 6, "norm_00.n");
+  expected.replace(expected.find("norm.n"), 6, "norm_00.n");
+  expected += "number of rings:=64\r\n";
+  NM_CHECK(header.ToString("\r\n") == expected);
+
+  //The result parses to the same entries.
+  const std::string text = header.ToString();
+  const nm::InterfileParser parser(text);
+  NM_CHECK(parser.GetEntries().size() == 11);
+  NM_CHECK(parser.GetValue("name of data file", value) && value == "norm_00.n");
+  NM_CHECK(parser.GetValue("number of rings", value) && value == "64");
+}
+
+//Typed values and separators.
+void TestBuilderFields(){
+
+  nm::InterfileHeaderBuilder header;
+  header.AddSection("!INTERFILE");
+  header.Set("matrix size[1]", 344u);
+  header.Set("offset", -3);
+  header.Set("scaling factor (mm/pixel) [1]", 2.08626f);
+  header.Set("length (cm)", 0.1 * 4.0625);
+  header.SetSeparator(" := ");
+  header.AddSection("!GENERAL DATA");
+  header.Set("!type of data", "PET");
+  header.AddLine("");
+
+  NM_CHECK(header.ToString() ==
+           "!INTERFILE:=\n"
+           "matrix size[1]:=344\n"
+           "offset:=-3\n"
+           "scaling factor (mm/pixel) [1]:=2.08626008\n"
+           "length (cm):=0.40625\n"
+           "!GENERAL DATA :=\n"
+           "!type of data := PET\n"
+           "\n");
+
+  //Floats round-trip.
+  std::string value;
+  NM_CHECK(header.GetValue("scaling factor (mm/pixel) [1]", value) && std::stof(value) == 2.08626f);
+}
+
+//The mu-map header, line for line as nm_mrac2mu has always written it.
+class TestMRAC2MU : public nm::MRAC2MU {
+public:
+  TestMRAC2MU() : MRAC2MU(boost::filesystem::current_path()) {};
+
+  std::string GetHeader(){
+    CreateInterfileHeader();
+    _header.Set("name of data file", "mu.v");
+    _header.Set("%study date (yyyy:mm:dd)", "2017:01:02");
+    _header.Set("%study time (hh:mm:ss GMT+00:00)", "10:11:12");
+    _header.Set("matrix size[1]", 344);
+    _header.Set("matrix size[2]", 344);
+    _header.Set("matrix size[3]", 127);
+    _header.Set("scaling factor (mm/pixel) [1]", 2.08626f);
+    _header.Set("scaling factor (mm/pixel) [2]", 2.08626f);
+    _header.Set("scaling factor (mm/pixel) [3]", 2.03125f);
+    _header.Set("maximum pixel count", 0.15f);
+    _header.Set("minimum pixel count", 0.0f);
+    return _header.ToString();
+  };
+};
+
+void TestMuMapHeader(){
+
+  TestMRAC2MU mrac;
+
+  NM_CHECK(mrac.GetHeader() ==
+           "!INTERFILE:=\n"
+           "%comment:=created with nm_mrac2mu for mMR data\n"
+           "!originating system:=2008\n"
+           "\n"
+           "!GENERAL DATA:=\n"
+           "!name of data file:=mu.v\n"
+           "!GENERAL IMAGE DATA:=\n"
+           "!type of data := PET\n"
+           "\n"
+           "%study date (yyyy:mm:dd):=2017:01:02\n"
+           "%study time (hh:mm:ss GMT+00:00):=10:11:12\n"
+           "imagedata byte order:=LITTLEENDIAN\n"
+           "%patient orientation:=HFS\n"
+           "!PET data type:=image\n"
+           "number format:=float\n"
+           "!number of bytes per pixel:=4\n"
+           "number of dimensions:=3\n"
+           "matrix axis label[1]:=x\n"
+           "matrix axis label[2]:=y\n"
+           "matrix axis label[3]:=z\n"
+           "matrix size[1]:=344\n"
+           "matrix size[2]:=344\n"
+           "matrix size[3]:=127\n"
+           "scaling factor (mm/pixel) [1]:=2.08626008\n"
+           "scaling factor (mm/pixel) [2]:=2.08626008\n"
+           "scaling factor (mm/pixel) [3]:=2.03125\n"
+           "start horizontal bed position (mm):=0\n"
+           "end horizontal bed position (mm):=0\n"
+           "start vertical bed position (mm):=0.0\n"
+           "\n"
+           "!IMAGE DATA DESCRIPTION:=\n"
+           "!total number of data sets:=1\n"
+           "number of time frames:=1\n"
+           "!image duration (sec)[1]:=0\n"
+           "!image relative start time (sec)[1]:=0\n"
+           "\n"
+           "%SUPPLEMENTARY ATTRIBUTES:=\n"
+           "quantification units:=1/cm\n"
+           "slice orientation:=Transverse\n"
+           "%image zoom:=1\n"
+           "%x-offset (mm):=0.0\n"
+           "%y-offset (mm):=0.0\n"
+           "%image slope:=1\n"
+           "%image intercept:=0.0\n"
+           "maximum pixel count:=0.150000006\n"
+           "minimum pixel count:=0\n"
+           "!END OF INTERFILE :=\n");
+}
+
+//The mMR ACF header, in STIR's layout.
+void TestACFHeader(){
+
+  nm::ScannerGeometry scanner;
+  NM_CHECK(nm::GetScannerGeometry("mMR", scanner));
+
+  const nm::ACFProjector projector(scanner);
+  nm::InterfileHeaderBuilder header = projector.GetInterfileHeader();
+  header.Set("name of data file", "acf.s");
+
+  NM_CHECK(header.ToString() ==
+           "!INTERFILE  :=\n"
+           "!imaging modality := PT\n"
+           "name of data file := acf.s\n"
+           "originating system := Siemens mMR\n"
+           "!version of keys := STIR3.0\n"
+           "!GENERAL DATA :=\n"
+           "!GENERAL IMAGE DATA :=\n"
+           "!type of data := PET\n"
+           "imagedata byte order := LITTLEENDIAN\n"
+           "!PET STUDY (General) :=\n"
+           "!PET data type := Emission\n"
+           "applied corrections := {None}\n"
+           "!number format := float\n"
+           "!number of bytes per pixel := 4\n"
+           "number of dimensions := 4\n"
+           "matrix axis label [4] := segment\n"
+           "!matrix size [4] := 11\n"
+           "matrix axis label [3] := axial coordinate\n"
+           "!matrix size [3] := { 27,49,71,93,115,127,115,93,71,49,27}\n"
+           "matrix axis label [2] := view\n"
+           "!matrix size [2] := 252\n"
+           "matrix axis label [1] := tangential coordinate\n"
+           "!matrix size [1] := 344\n"
+           "minimum ring difference per segment := { -60,-49,-38,-27,-16,-5,6,17,28,39,50}\n"
+           "maximum ring difference per segment := { -50,-39,-28,-17,-6,5,16,27,38,49,60}\n"
+           "Scanner parameters:= \n"
+           "Scanner type := Siemens mMR\n"
+           "Number of rings := 64\n"
+           "Number of detectors per ring := 504\n"
+           "Inner ring diameter (cm) := 65.6\n"
+           "Average depth of interaction (cm) := 0.7\n"
+           "Distance between rings (cm) := 0.40625\n"
+           "Default bin size (cm) := 0.208626\n"
+           "View offset (degrees) := 0\n"
+           "Maximum number of non-arc-corrected bins := 344\n"
+           "Default number of arc-corrected bins := 344\n"
+           "end scanner parameters:=\n"
+           "effective central bin size (cm) := 0.208626\n"
+           "number of time frames := 1\n"
+           "!END OF INTERFILE :=\n");
+}
+
+int main(int, char **){
+
+  TestParser();
+  TestBuilderRoundTrip();
+  TestBuilderFields();
+  TestMuMapHeader();
+  TestACFHeader();
+
+  return nmtools::testing::Report();
+}
@@ -0,0 +1,351 @@
+/*
+   TestResample.cpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Identity and shift cases for the reslicing kernels in Resample.hpp,
+   and the transaxial FOV.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "nmtools/Orientation.hpp"
+#include "nmtools/Resample.hpp"
+#include "Testing.hpp"
+
+namespace nm = nmtools;
+
+typedef itk::Image<float, 3> ImageType;
+
+//Image of the given size, spacing (2, 3, 4) mm and origin (-10, 5, 0),
+//filled with f(x, y, z) of the voxel index.
+template <typename TFunction>
+ImageType::Pointer MakeImage(const std::size_t size[3], TFunction f){
+
+  ImageType::SizeType imageSize;
+  ImageType::SpacingType spacing;
+  ImageType::PointType origin;
+
+  const double spacings[3] = { 2.0, 3.0, 4.0 };
+  const double origins[3] = { -10.0, 5.0, 0.0 };
+
+  for (unsigned int k = 0; k < 3; k++) {
+    imageSize[k] = size[k];
+    spacing[k] = spacings[k];
+    origin[k] = origins[k];
+  }
+
+  ImageType::RegionType region;
+  region.SetSize(imageSize);
+
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions(region);
+  image->SetSpacing(spacing);
+  image->SetOrigin(origin);
+  image->Allocate();
+
+  float *p = image->GetBufferPointer();
+  for (std::size_t z = 0; z < size[2]; z++)
+    for (std::size_t y = 0; y < size[1]; y++)
+      for (std::size_t x = 0; x < size[0]; x++)
+        *p++ = f(x, y, z);
+
+  return image;
+}
+
+float Texture(std::size_t x, std::size_t y, std::size_t z){
+  return static_cast<float>(std::sin(0.7 * x + 1.3 * y) + 0.25 * z);
+}
+
+float Ramp(std::size_t x, std::size_t y, std::size_t z){
+  return static_cast<float>(3.0 * x + 2.0 * y - 1.0 * z);
+}
+
+//Resample input onto its own grid moved by shift voxels along each axis,
+//with size voxels.
+ImageType::Pointer Reslice(const ImageType *input, nm::Interpolation interp,
+                           const double shift[3], const std::size_t size[3]){
+
+  nm::AxisAlignedResampler<ImageType, ImageType> resampler;
+
+  ImageType::PointType origin = input->GetOrigin();
+  ImageType::SizeType outputSize;
+  for (unsigned int k = 0; k < 3; k++) {
+    origin[k] += shift[k] * input->GetSpacing()[k];
+    outputSize[k] = size[k];
+  }
+
+  resampler.SetInput(input);
+  resampler.SetInterpolation(interp);
+  resampler.SetOutputSpacing(input->GetSpacing());
+  resampler.SetOutputOrigin(origin);
+  resampler.SetSize(outputSize);
+
+  if (!resampler.Update())
+    return ImageType::Pointer();
+
+  return resampler.GetOutput();
+}
+
+const nm::Interpolation kKernels[] = { nm::Interpolation::Nearest, nm::Interpolation::Linear,
+                                       nm::Interpolation::BSpline, nm::Interpolation::Sinc };
+
+//Every kernel reproduces the samples on the input grid. The x axis is
+//long enough for the B-spline prefilter's truncated initialisation, y
+//is short enough for its exact one.
+void TestIdentity(){
+
+  const std::size_t size[3] = { 20, 5, 7 };
+  const double shift[3] = { 0.0, 0.0, 0.0 };
+  ImageType::Pointer input = MakeImage(size, Texture);
+
+  for (nm::Interpolation interp : kKernels) {
+    ImageType::Pointer output = Reslice(input, interp, shift, size);
+    NM_CHECK(output.GetPointer() != nullptr);
+    if (output.GetPointer() == nullptr)
+      continue;
+
+    const double tol = interp == nm::Interpolation::BSpline ? 1e-4 : 1e-6;
+    const float *in = input->GetBufferPointer();
+    const float *out = output->GetBufferPointer();
+    for (std::size_t i = 0; i < size[0] * size[1] * size[2]; i++)
+      NM_CHECK_NEAR(out[i], in[i], tol);
+  }
+}
+
+//A whole-voxel shift along x moves the samples; output beyond the input
+//is zero.
+void TestIntegerShift(){
+
+  const std::size_t size[3] = { 20, 5, 7 };
+  const double shift[3] = { 2.0, 0.0, 0.0 };
+  ImageType::Pointer input = MakeImage(size, Texture);
+
+  for (nm::Interpolation interp : kKernels) {
+    ImageType::Pointer output = Reslice(input, interp, shift, size);
+    NM_CHECK(output.GetPointer() != nullptr);
+    if (output.GetPointer() == nullptr)
+      continue;
+
+    const double tol = interp == nm::Interpolation::BSpline ? 1e-4 : 1e-6;
+    const float *out = output->GetBufferPointer();
+    for (std::size_t z = 0; z < size[2]; z++)
+      for (std::size_t y = 0; y < size[1]; y++)
+        for (std::size_t x = 0; x < size[0]; x++) {
+          const float expected = x + 2 < size[0] ? Texture(x + 2, y, z) : 0.0f;
+          NM_CHECK_NEAR(out[(z * size[1] + y) * size[0] + x], expected, tol);
+        }
+  }
+}
+
+//Half a voxel along every axis onto a linear ramp: linear interpolation
+//is exact everywhere, and the cubic B-spline and the normalised Lanczos
+//kernel (symmetric about the sample) are exact away from the edges.
+void TestHalfVoxelShift(){
+
+  const std::size_t size[3] = { 24, 16, 16 };
+  const std::size_t outSize[3] = { 23, 15, 15 };
+  const double shift[3] = { 0.5, 0.5, 0.5 };
+  ImageType::Pointer input = MakeImage(size, Ramp);
+
+  const nm::Interpolation kernels[] = { nm::Interpolation::Linear, nm::Interpolation::BSpline,
+                                        nm::Interpolation::Sinc };
+
+  for (nm::Interpolation interp : kernels) {
+    ImageType::Pointer output = Reslice(input, interp, shift, outSize);
+    NM_CHECK(output.GetPointer() != nullptr);
+    if (output.GetPointer() == nullptr)
+      continue;
+
+    const std::size_t margin = interp == nm::Interpolation::Linear ? 0 : 6;
+    const float *out = output->GetBufferPointer();
+    for (std::size_t z = margin; z + margin < outSize[2]; z++)
+      for (std::size_t y = margin; y + margin < outSize[1]; y++)
+        for (std::size_t x = margin; x + margin < outSize[0]; x++) {
+          const double expected = 3.0 * (x + 0.5) + 2.0 * (y + 0.5) - (z + 0.5);
+          NM_CHECK_NEAR(out[(z * outSize[1] + y) * outSize[0] + x], expected, 1e-3);
+        }
+  }
+}
+
+//The B-spline coefficients of a line interpolate it: (c[k-1] + 4 c[k] +
+//c[k+1]) / 6 = f[k], with mirrored ends. Checked for a short line (exact
+//initialisation) and a long one (truncated), and for a constant.
+void TestBSplinePrefilter(){
+
+  const std::size_t lengths[] = { 2, 6, 40 };
+
+  for (std::size_t n : lengths) {
+    const std::size_t size[3] = { n, 1, 1 };
+    ImageType::Pointer input = MakeImage(size, Texture);
+
+    std::vector<float> coeffs;
+    nm::BSplinePrefilter(nm::MakeVolumeView(input.GetPointer()), coeffs);
+    NM_CHECK(coeffs.size() == n);
+
+    for (std::size_t k = 0; k < n; k++) {
+      const std::ptrdiff_t i = static_cast<std::ptrdiff_t>(k);
+      const double value = (coeffs[nm::MirrorIndex(i - 1, n)] + 4.0 * coeffs[k] +
+                            coeffs[nm::MirrorIndex(i + 1, n)]) / 6.0;
+      NM_CHECK_NEAR(value, Texture(k, 0, 0), 1e-5);
+    }
+  }
+
+  const std::size_t size[3] = { 30, 1, 1 };
+  ImageType::Pointer constant = MakeImage(size, [](std::size_t, std::size_t, std::size_t){ return 7.0f; });
+
+  std::vector<float> coeffs;
+  nm::BSplinePrefilter(nm::MakeVolumeView(constant.GetPointer()), coeffs);
+  for (float c : coeffs)
+    NM_CHECK_NEAR(c, 7.0, 1e-5);
+}
+
+//Lanczos weights sum to one, pick out the sample at whole-voxel
+//positions, and are symmetric half way between samples.
+void TestLanczosWeights(){
+
+  const std::size_t n = 16;
+  nm::AxisSampling table = nm::ComputeSincSampling(n, 31, 0.0, 0.5);
+  NM_CHECK(table.taps == 6);
+
+  for (std::size_t i = 0; i < 31; i++) {
+    NM_CHECK(table.inside[i]);
+
+    double sum = 0.0;
+    for (std::size_t t = 0; t < table.taps; t++)
+      sum += table.weight[i * table.taps + t];
+    NM_CHECK_NEAR(sum, 1.0, 1e-6);
+
+    if (i % 2 == 0) {
+      for (std::size_t t = 0; t < table.taps; t++) {
+        const bool centre = table.index[i * table.taps + t] == static_cast<std::ptrdiff_t>(i / 2);
+        if (!centre)
+          NM_CHECK_NEAR(table.weight[i * table.taps + t], 0.0, 1e-6);
+      }
+    }
+    else if (i >= 5 && i + 5 < 31) {
+      for (std::size_t t = 0; t < table.taps / 2; t++)
+        NM_CHECK_NEAR(table.weight[i * table.taps + t],
+                      table.weight[i * table.taps + table.taps - 1 - t], 1e-6);
+    }
+  }
+
+  //Outside [-0.5, n - 0.5) nothing is sampled.
+  nm::AxisSampling outside = nm::ComputeSincSampling(n, 2, -0.6, n + 0.1);
+  NM_CHECK(!outside.inside[0]);
+  NM_CHECK(!outside.inside[1]);
+}
+
+//The transaxial FOV is a circle about the scanner axis (physical x = y
+//= 0), not about the middle of the grid.
+void TestTransaxialFOV(){
+
+  const std::size_t size[3] = { 10, 10, 2 };
+  ImageType::Pointer input = MakeImage(size, [](std::size_t, std::size_t, std::size_t){ return 1.0f; });
+
+  ImageType::SizeType outputSize;
+  for (unsigned int k = 0; k < 3; k++)
+    outputSize[k] = size[k];
+
+  nm::AxisAlignedResampler<ImageType, ImageType> resampler;
+  resampler.SetInput(input);
+  resampler.SetOutputSpacing(input->GetSpacing());
+  resampler.SetOutputOrigin(input->GetOrigin());
+  resampler.SetSize(outputSize);
+  resampler.SetTransaxialFOV(20.0);
+  NM_CHECK(resampler.Update());
+
+  ImageType::Pointer output = resampler.GetOutput();
+  const float *out = output->GetBufferPointer();
+
+  for (std::size_t z = 0; z < size[2]; z++)
+    for (std::size_t y = 0; y < size[1]; y++)
+      for (std::size_t x = 0; x < size[0]; x++) {
+        const double px = -10.0 + 2.0 * x;
+        const double py = 5.0 + 3.0 * y;
+        const double expected = px * px + py * py <= 100.0 ? 1.0 : 0.0;
+        NM_CHECK_NEAR(out[(z * size[1] + y) * size[0] + x], expected, 1e-6);
+      }
+
+  //On the axis, and in the middle of the grid (18.5 mm from the axis).
+  NM_CHECK_NEAR(out[5], 1.0, 1e-6);
+  NM_CHECK_NEAR(out[4 * size[0] + 4], 0.0, 1e-6);
+}
+
+//ScaleAndComputeStatistics() on views of a buffer with its axes
+//permuted and flipped, including those whose z is the buffer's x (done
+//in blocks of slices, the last one partial), against direct indexing.
+void TestMappedScale(){
+
+  const std::size_t size[3] = { 37, 9, 6 };
+  std::vector<int16_t> buffer(size[0] * size[1] * size[2]);
+  for (std::size_t i = 0; i < buffer.size(); i++)
+    buffer[i] = static_cast<int16_t>((i * 7919) % 2000) - 500;
+
+  const std::ptrdiff_t strides[3] = { 1, static_cast<std::ptrdiff_t>(size[0]),
+                                      static_cast<std::ptrdiff_t>(size[0] * size[1]) };
+  const unsigned int axes[][3] = { { 0, 1, 2 }, { 1, 2, 0 }, { 2, 1, 0 }, { 1, 0, 2 } };
+  const float divisor = 10.0f;
+
+  for (const auto &axis : axes)
+    for (unsigned int flip = 0; flip < 2; flip++) {
+      nm::VolumeView<int16_t> view;
+      view.data = buffer.data();
+      for (unsigned int j = 0; j < 3; j++) {
+        view.size[j] = size[axis[j]];
+        view.stride[j] = strides[axis[j]];
+      }
+      //Flip the output z.
+      if (flip) {
+        view.data += static_cast<std::ptrdiff_t>(view.size[2] - 1) * view.stride[2];
+        view.stride[2] = -view.stride[2];
+      }
+
+      std::vector<float> out(buffer.size());
+      nm::MuMapStatistics stats;
+      nm::ScaleAndComputeStatistics(view, out.data(), divisor, stats);
+
+      float minimum = out[0], maximum = out[0];
+      for (std::size_t z = 0; z < view.size[2]; z++)
+        for (std::size_t y = 0; y < view.size[1]; y++)
+          for (std::size_t x = 0; x < view.size[0]; x++) {
+            const int16_t v = view.data[static_cast<std::ptrdiff_t>(x) * view.stride[0] +
+                                        static_cast<std::ptrdiff_t>(y) * view.stride[1] +
+                                        static_cast<std::ptrdiff_t>(z) * view.stride[2]];
+            const float o = out[(z * view.size[1] + y) * view.size[0] + x];
+            NM_CHECK_NEAR(o, v / divisor, 1e-6);
+            minimum = std::min(minimum, o);
+            maximum = std::max(maximum, o);
+          }
+
+      NM_CHECK_NEAR(stats.minimum, minimum, 1e-6);
+      NM_CHECK_NEAR(stats.maximum, maximum, 1e-6);
+    }
+}
+
+int main(int, char **){
+
+  TestIdentity();
+  TestIntegerShift();
+  TestHalfVoxelShift();
+  TestBSplinePrefilter();
+  TestLanczosWeights();
+  TestTransaxialFOV();
+  TestMappedScale();
+
+  return nmtools::testing::Report();
+}
@@ -0,0 +1,206 @@
+/*
+   TestSmoothing.cpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   The recursive Gaussian in Smoothing.hpp against direct convolution.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "nmtools/Smoothing.hpp"
+#include "Testing.hpp"
+
+namespace nm = nmtools;
+
+//Convolution of f with a sampled, normalised Gaussian, the signal
+//continuing with its edge values.
+std::vector<double> Convolve(const std::vector<float> &f, double sigma){
+
+  const std::ptrdiff_t n = static_cast<std::ptrdiff_t>(f.size());
+  const std::ptrdiff_t radius = static_cast<std::ptrdiff_t>(std::ceil(8.0 * sigma));
+
+  std::vector<double> kernel(2 * radius + 1);
+  double sum = 0.0;
+  for (std::ptrdiff_t j = -radius; j <= radius; j++) {
+    kernel[j + radius] = std::exp(-0.5 * j * j / (sigma * sigma));
+    sum += kernel[j + radius];
+  }
+
+  std::vector<double> g(f.size(), 0.0);
+  for (std::ptrdiff_t k = 0; k < n; k++)
+    for (std::ptrdiff_t j = -radius; j <= radius; j++) {
+      const std::ptrdiff_t i = std::max<std::ptrdiff_t>(0, std::min(n - 1, k + j));
+      g[k] += kernel[j + radius] / sum * f[i];
+    }
+
+  return g;
+}
+
+//Largest absolute difference between a and b.
+double MaxDifference(const std::vector<float> &a, const std::vector<double> &b){
+
+  double d = 0.0;
+  for (std::size_t k = 0; k < a.size(); k++)
+    d = std::max(d, std::fabs(a[k] - b[k]));
+
+  return d;
+}
+
+float Texture(std::size_t k){
+  return static_cast<float>(std::sin(0.37 * k) + 0.5 * std::cos(1.1 * k) + 0.02 * k);
+}
+
+//The impulse response has unit gain and variance sigma^2, and is close
+//to the sampled Gaussian: within a few percent of its peak, less so
+//for small sigma, where the recursive approximation is known to be
+//poorer.
+void TestImpulseResponse(){
+
+  std::vector<float> scratch;
+
+  const double sigmas[] = { 0.5, 1.0, 2.5, 6.0 };
+  const double tolerances[] = { 0.1, 0.04, 0.02, 0.015 };
+
+  for (unsigned int i = 0; i < 4; i++) {
+    const double sigma = sigmas[i];
+    std::vector<float> line(201, 0.0f);
+    line[100] = 1.0f;
+    const std::vector<double> expected = Convolve(line, sigma);
+
+    nm::RecursiveGaussian(sigma).FilterLines(line.data(), line.size(), 1, 1, scratch);
+
+    double sum = 0.0, mean = 0.0, variance = 0.0;
+    for (std::size_t k = 0; k < line.size(); k++) {
+      sum += line[k];
+      mean += k * line[k];
+    }
+    mean /= sum;
+    for (std::size_t k = 0; k < line.size(); k++)
+      variance += (k - mean) * (k - mean) * line[k] / sum;
+
+    NM_CHECK_NEAR(sum, 1.0, 1e-4);
+    NM_CHECK_NEAR(mean, 100.0, 1e-3);
+    NM_CHECK_NEAR(variance, sigma * sigma, 0.01 * sigma * sigma + 1e-3);
+    NM_CHECK(MaxDifference(line, expected) < tolerances[i] * expected[100]);
+  }
+}
+
+//A signal with steps, several sigmas: within 0.025 (its range is about
+//6) of the direct convolution, ends included.
+void TestSignalResponse(){
+
+  std::vector<float> scratch;
+
+  const double sigmas[] = { 1.0, 2.0, 4.0 };
+
+  for (double sigma : sigmas) {
+    std::vector<float> line(64);
+    for (std::size_t k = 0; k < line.size(); k++)
+      line[k] = Texture(k) + (k >= 20 && k < 40 ? 2.0f : 0.0f);
+
+    const std::vector<double> expected = Convolve(line, sigma);
+    nm::RecursiveGaussian(sigma).FilterLines(line.data(), line.size(), 1, 1, scratch);
+
+    NM_CHECK(MaxDifference(line, expected) < 0.025);
+  }
+}
+
+//A constant comes through unchanged, up to the ends.
+void TestConstant(){
+
+  std::vector<float> scratch;
+
+  std::vector<float> line(50, 3.0f);
+  nm::RecursiveGaussian(3.0).FilterLines(line.data(), line.size(), 1, 1, scratch);
+
+  for (float v : line)
+    NM_CHECK_NEAR(v, 3.0, 1e-4);
+}
+
+//Interleaved lines (width > 1) are filtered as if one at a time, and
+//SmoothGaussian() is separable: a volume that varies along one axis
+//only is smoothed along that axis only (x on blocks of rows, the last
+//one partial). Statistics are gathered.
+void TestVolume(){
+
+  std::vector<float> scratch;
+
+  const std::size_t n = 40;
+  const std::size_t width = 5;
+  const double sigma = 2.0;
+  nm::RecursiveGaussian filter(sigma);
+
+  std::vector<float> lines(n * width);
+  for (std::size_t k = 0; k < n; k++)
+    for (std::size_t w = 0; w < width; w++)
+      lines[k * width + w] = Texture(k + 7 * w);
+  filter.FilterLines(lines.data(), n, width, width, scratch);
+
+  for (std::size_t w = 0; w < width; w++) {
+    std::vector<float> line(n);
+    for (std::size_t k = 0; k < n; k++)
+      line[k] = Texture(k + 7 * w);
+    filter.FilterLines(line.data(), n, 1, 1, scratch);
+    for (std::size_t k = 0; k < n; k++)
+      NM_CHECK_NEAR(lines[k * width + w], line[k], 1e-6);
+  }
+
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    const std::size_t size[3] = { 12, 37, 9 };
+    const double sigmas[3] = { 1.5, 1.5, 1.5 };
+
+    std::vector<float> volume(size[0] * size[1] * size[2]);
+    for (std::size_t z = 0; z < size[2]; z++)
+      for (std::size_t y = 0; y < size[1]; y++)
+        for (std::size_t x = 0; x < size[0]; x++) {
+          const std::size_t index[3] = { x, y, z };
+          volume[(z * size[1] + y) * size[0] + x] = Texture(index[axis]);
+        }
+
+    nm::MuMapStatistics stats;
+    nm::SmoothGaussian(volume.data(), size, sigmas, &stats);
+
+    std::vector<float> line(size[axis]);
+    for (std::size_t k = 0; k < size[axis]; k++)
+      line[k] = Texture(k);
+    nm::RecursiveGaussian(sigmas[axis]).FilterLines(line.data(), line.size(), 1, 1, scratch);
+
+    float minimum = volume[0], maximum = volume[0];
+    for (std::size_t z = 0; z < size[2]; z++)
+      for (std::size_t y = 0; y < size[1]; y++)
+        for (std::size_t x = 0; x < size[0]; x++) {
+          const std::size_t index[3] = { x, y, z };
+          const float v = volume[(z * size[1] + y) * size[0] + x];
+          NM_CHECK_NEAR(v, line[index[axis]], 1e-4);
+          minimum = std::min(minimum, v);
+          maximum = std::max(maximum, v);
+        }
+
+    NM_CHECK_NEAR(stats.minimum, minimum, 1e-6);
+    NM_CHECK_NEAR(stats.maximum, maximum, 1e-6);
+  }
+}
+
+int main(int, char **){
+
+  TestImpulseResponse();
+  TestSignalResponse();
+  TestConstant();
+  TestVolume();
+
+  return nmtools::testing::Report();
+}
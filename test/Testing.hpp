@@ -0,0 +1,69 @@
+/*
+   Testing.hpp
+
+   Copyright 2026 Institute of Nuclear Medicine, University College London.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Minimal checks for the unit tests (run by ctest).
+ */
+
+#ifndef TESTING_HPP
+#define TESTING_HPP
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+namespace nmtools {
+namespace testing {
+
+//Number of failed checks so far.
+inline unsigned int &FailureCount(){
+  static unsigned int count = 0;
+  return count;
+}
+
+inline void Fail(const char *file, int line, const char *what){
+  std::cerr << file << ":" << line << ": check failed: " << what << std::endl;
+  FailureCount()++;
+}
+
+//Exit status for main(): EXIT_FAILURE if any check failed.
+inline int Report(){
+  if (FailureCount() > 0) {
+    std::cerr << FailureCount() << " check(s) failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+} //namespace testing
+} //namespace nmtools
+
+#define NM_CHECK(cond) \
+  do { \
+    if (!(cond)) \
+      nmtools::testing::Fail(__FILE__, __LINE__, #cond); \
+  } while (0)
+
+#define NM_CHECK_NEAR(a, b, tol) \
+  do { \
+    const double nmCheckA = (a); \
+    const double nmCheckB = (b); \
+    if (!(std::fabs(nmCheckA - nmCheckB) <= (tol))) { \
+      std::cerr << "  " << nmCheckA << " vs " << nmCheckB << std::endl; \
+      nmtools::testing::Fail(__FILE__, __LINE__, "|" #a " - " #b "| <= " #tol); \
+    } \
+  } while (0)
+
+#endif